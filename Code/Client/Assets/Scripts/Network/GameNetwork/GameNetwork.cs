@@ -9,6 +9,8 @@ public class GameNetwork : INetAgentHandler
     public GameNetwork()
     {
         m_netAgent.SetHandler(this);
+        // the server times its round trips with these
+        Add((int)NetProto.ProtoId.PidPing, (int protocolId) => { Send(NetProto.ProtoId.PidPong); });
     }
     public bool Connect(string _host, int _port)
     {
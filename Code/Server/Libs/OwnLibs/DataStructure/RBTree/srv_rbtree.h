@@ -8,8 +8,8 @@ extern "C" {
 typedef unsigned int uint;
 typedef unsigned char u_char;
 
-typedef uint srv_rbtree_key_t;
-typedef int srv_rbtree_key_int_t;
+typedef unsigned long long srv_rbtree_key_t; // the timer keys are epoch ms, they do not fit 32 bits
+typedef long long srv_rbtree_key_int_t;
 
 typedef struct srv_rbtree_node_s srv_rbtree_node_t;
 struct srv_rbtree_node_s 
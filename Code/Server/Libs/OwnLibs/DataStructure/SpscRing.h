@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include <utility>
+
+// bounded queue between exactly one pushing thread and one popping thread, neither side ever waits on a lock.
+// capacity is rounded up to a power of 2. each side keeps a cached copy of the other side's index,
+// so the shared cache line is only read again when the ring looks full or empty
+template <typename T>
+class SpscRing
+{
+public:
+	SpscRing(uint32_t capacity)
+	{
+		uint32_t real_capacity = 1;
+		while (real_capacity < capacity)
+			real_capacity <<= 1;
+		m_slots.resize(real_capacity);
+		m_mask = real_capacity - 1;
+	}
+
+	// producer only
+	bool TryPush(const T &item)
+	{
+		uint32_t tail = m_tail.load(std::memory_order_relaxed);
+		if (!this->HasRoom(tail))
+			return false;
+		m_slots[tail & m_mask] = item;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// producer only
+	bool TryPush(T &&item)
+	{
+		uint32_t tail = m_tail.load(std::memory_order_relaxed);
+		if (!this->HasRoom(tail))
+			return false;
+		m_slots[tail & m_mask] = std::move(item);
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer only, the popped slot is left moved from
+	bool TryPop(T &item)
+	{
+		uint32_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_consumer_cached_tail)
+		{
+			m_consumer_cached_tail = m_tail.load(std::memory_order_acquire);
+			if (head == m_consumer_cached_tail)
+				return false;
+		}
+		item = std::move(m_slots[head & m_mask]);
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// exact for the two sides, a snapshot for any other thread
+	uint32_t Size()
+	{
+		uint32_t head = m_head.load(std::memory_order_acquire);
+		uint32_t tail = m_tail.load(std::memory_order_acquire);
+		return tail - head;
+	}
+	uint32_t Capacity() { return m_mask + 1; }
+
+private:
+	bool HasRoom(uint32_t tail)
+	{
+		if (tail - m_producer_cached_head <= m_mask)
+			return true;
+		m_producer_cached_head = m_head.load(std::memory_order_acquire);
+		return tail - m_producer_cached_head <= m_mask;
+	}
+
+	// the indexes only grow and wrap at 2^32, the slot is index & m_mask.
+	// padded apart, so pushing and popping do not keep stealing one cache line from each other
+	static const int CACHE_LINE_SIZE = 64;
+	std::vector<T> m_slots;
+	uint32_t m_mask = 0;
+	char m_pad0[CACHE_LINE_SIZE];
+	std::atomic<uint32_t> m_head{ 0 };
+	uint32_t m_consumer_cached_tail = 0;
+	char m_pad1[CACHE_LINE_SIZE];
+	std::atomic<uint32_t> m_tail{ 0 };
+	uint32_t m_producer_cached_head = 0;
+	char m_pad2[CACHE_LINE_SIZE];
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ShareCode/Common/Utils/MemoryUtil.h"
+#include "MemoryPool/FrameArena.h"
+#include <memory>
+
+// for containers which die within the tick they are created in, memory comes from the frame arena of the calling thread
+template <typename T>
+class FrameAllocator : public std::allocator<T>
+{
+public:
+	typedef size_t   size_type;
+	typedef typename std::allocator<T>::pointer              pointer;
+	typedef typename std::allocator<T>::value_type           value_type;
+	typedef typename std::allocator<T>::const_pointer        const_pointer;
+	typedef typename std::allocator<T>::reference            reference;
+	typedef typename std::allocator<T>::const_reference      const_reference;
+
+	pointer allocate(size_type _Count, const void* _Hint = NULL)
+	{
+		void *ptr = NULL;
+		ptr = MemoryUtil::GetFrameArena()->Malloc(sizeof(value_type) * _Count);
+		return (pointer)ptr;
+	}
+
+	void deallocate(pointer _Ptr, size_type _Count)
+	{
+		MemoryUtil::GetFrameArena()->Free(_Ptr, sizeof(value_type) * _Count);
+	}
+
+	template<class _Other>
+	struct rebind
+	{
+		typedef FrameAllocator<_Other> other;
+	};
+
+	FrameAllocator() throw() {}
+	FrameAllocator(const FrameAllocator& __a) throw() : std::allocator<T>(__a) {}
+	template<typename _Tp1> FrameAllocator(const FrameAllocator<_Tp1>&) throw() {}
+	~FrameAllocator() throw() {}
+};
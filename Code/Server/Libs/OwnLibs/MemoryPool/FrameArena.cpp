@@ -0,0 +1,91 @@
+#include "MemoryPool/FrameArena.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <new>
+
+FrameArena::FrameArena(uint32_t block_size) : m_block_size(block_size)
+{
+	assert(block_size > 0);
+}
+
+FrameArena::~FrameArena()
+{
+	this->Reset();
+	while (nullptr != m_free_blocks)
+	{
+		Block *block = m_free_blocks;
+		m_free_blocks = block->next;
+		free(block);
+	}
+}
+
+void * FrameArena::Malloc(size_t size)
+{
+	size = (size + ALIGN_SIZE - 1) / ALIGN_SIZE * ALIGN_SIZE;
+	if (size > (size_t)(m_end - m_top))
+	{
+		if (!this->NextBlock(size))
+			return nullptr;
+	}
+	void *ret_ptr = m_top;
+	m_top += size;
+	m_used_bytes += size;
+	if (m_used_bytes > m_peak_used_bytes)
+		m_peak_used_bytes = m_used_bytes;
+	return ret_ptr;
+}
+
+void FrameArena::Free(void *ptr, size_t size)
+{
+	// only the latest allocation can be taken back, which is the common case of a growing vector
+	size = (size + ALIGN_SIZE - 1) / ALIGN_SIZE * ALIGN_SIZE;
+	if (nullptr != ptr && (char *)ptr + size == m_top)
+	{
+		m_top = (char *)ptr;
+		m_used_bytes -= size;
+	}
+}
+
+void FrameArena::Reset()
+{
+	while (nullptr != m_blocks)
+	{
+		Block *block = m_blocks;
+		m_blocks = block->next;
+		block->next = m_free_blocks;
+		m_free_blocks = block;
+	}
+	m_top = nullptr;
+	m_end = nullptr;
+	m_used_bytes = 0;
+}
+
+bool FrameArena::NextBlock(size_t size)
+{
+	Block *block = nullptr;
+	for (Block **it = &m_free_blocks; nullptr != *it; it = &(*it)->next)
+	{
+		if ((*it)->size >= size)
+		{
+			block = *it;
+			*it = block->next;
+			break;
+		}
+	}
+	if (nullptr == block)
+	{
+		size_t block_size = size > m_block_size ? size : m_block_size;
+		size_t head_size = (sizeof(Block) + ALIGN_SIZE - 1) / ALIGN_SIZE * ALIGN_SIZE;
+		char *mem = (char *)malloc(head_size + block_size);
+		if (nullptr == mem)
+			return false;
+		block = new(mem) Block();
+		block->size = block_size;
+		block->begin = mem + head_size;
+	}
+	block->next = m_blocks;
+	m_blocks = block;
+	m_top = block->begin;
+	m_end = block->begin + block->size;
+	return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// bump pointer arena for memory living no longer than one tick: Free only gives back the latest allocation,
+// everything else is reclaimed at once by Reset. blocks are kept across Reset, so a steady tick allocates nothing
+class FrameArena
+{
+public:
+	FrameArena(uint32_t block_size);
+	~FrameArena();
+
+	void * Malloc(size_t size);
+	void Free(void *ptr, size_t size);
+	void Reset();
+	size_t UsedBytes() { return m_used_bytes; }
+	size_t PeakUsedBytes() { return m_peak_used_bytes; }
+
+	static const uint32_t ALIGN_SIZE = 16;
+
+private:
+	struct Block
+	{
+		Block *next = nullptr;
+		size_t size = 0;
+		char *begin = nullptr;
+	};
+
+	uint32_t m_block_size = 0;
+	Block *m_blocks = nullptr; // blocks in use, head is the current one
+	Block *m_free_blocks = nullptr; // blocks rewound by Reset
+	char *m_top = nullptr;
+	char *m_end = nullptr;
+	size_t m_used_bytes = 0;
+	size_t m_peak_used_bytes = 0;
+
+	bool NextBlock(size_t size);
+};
@@ -1,5 +1,11 @@
 #include "MemoryPool/MemoryPool.h"
+#include "MemoryPool/SpanChunkAllocator.h"
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef WIN32
+#include <malloc.h>
+#endif
 
 struct BlockLink
 {
@@ -10,10 +16,13 @@ struct BlockSet
 {
 	static const uint32_t ID_DESCRIPT_LEN = sizeof(uint32_t);
 
+	SpanHead span_head;
 	uint32_t id = 0;
 	uint32_t block_size = 0;
 	uint32_t total_num = 0;
 	uint32_t used_num = 0;
+	BlockSet *prev_free_set = nullptr;
+	BlockSet *next_free_set = nullptr;
 	BlockLink free_block;
 	char blocks_begin[0];
 };
@@ -31,32 +40,29 @@ MemoryPool::MemoryPool(uint32_t block_size, uint32_t memory_page_size, uint32_t
 	m_block_sets.push_back(nullptr);
 }
 
+MemoryPool::MemoryPool(uint32_t block_size, uint32_t memory_page_size, uint32_t expect_working_block_set_num, uint32_t min_block_num_per_block_set, uint32_t span_size, uint32_t span_tag,
+	SpanChunkAllocator *span_allocator)
+	: m_block_size(block_size), m_memory_page_size(memory_page_size), m_expect_working_block_set_num(expect_working_block_set_num), m_min_block_num_per_block_set(min_block_num_per_block_set),
+	m_span_size(span_size), m_span_tag(span_tag), m_span_allocator(span_allocator)
+{
+	assert(0 == (span_size & (span_size - 1)));
+	m_block_sets.clear();
+	m_block_sets.push_back(nullptr);
+}
+
 MemoryPool::~MemoryPool()
 {
 	for (auto block_set: m_block_sets)
 	{
 		if (nullptr != block_set)
-			delete block_set;
+			this->FreeBlockSet(block_set);
 	}
 	m_block_sets.clear();
 }
 
 void * MemoryPool::Malloc()
 {
-	BlockSet *block_set = m_block_sets[m_free_block_set_min_id];
-	if (nullptr == block_set || nullptr == block_set->free_block.next)
-	{
-		block_set = nullptr;
-		for (uint32_t i = 1; i <= m_valid_bolck_set_max_id; ++ i)
-		{
-			BlockSet *tmp_block_set = m_block_sets[i];
-			if (nullptr != tmp_block_set && nullptr != tmp_block_set->free_block.next)
-			{
-				block_set = tmp_block_set;
-				break;
-			}
-		}
-	}
+	BlockSet *block_set = m_free_block_sets;
 	if (nullptr == block_set)
 	{
 		uint32_t block_id = this->GenBlockId();
@@ -65,22 +71,42 @@ void * MemoryPool::Malloc()
 			assert(nullptr == m_block_sets[block_id]);
 
 		uint32_t malloc_size = 0;
-		uint32_t real_block_size = BlockSet::ID_DESCRIPT_LEN + m_block_size;
+		uint32_t real_block_size = 0;
+		uint32_t blocks_offset = sizeof(BlockSet);
+		if (m_span_size > 0)
+		{
+			real_block_size = m_block_size;
+			if (real_block_size >= SPAN_BLOCK_ALIGN)
+				real_block_size = (real_block_size + SPAN_BLOCK_ALIGN - 1) / SPAN_BLOCK_ALIGN * SPAN_BLOCK_ALIGN;
+			blocks_offset = (sizeof(BlockSet) + SPAN_BLOCK_ALIGN - 1) / SPAN_BLOCK_ALIGN * SPAN_BLOCK_ALIGN;
+			malloc_size = m_span_size;
+			assert(malloc_size >= blocks_offset + real_block_size * 2);
+			if (nullptr != m_span_allocator)
+				block_set = (BlockSet *)m_span_allocator->AllocSpan();
+			else
+				block_set = (BlockSet *)AlignedMalloc(m_span_size, malloc_size);
+		}
+		else
 		{
+			real_block_size = BlockSet::ID_DESCRIPT_LEN + m_block_size;
 			uint32_t tmp_malloc_size = sizeof(BlockSet) + real_block_size * m_min_block_num_per_block_set;
 			uint32_t page_num = tmp_malloc_size / m_memory_page_size;
 			page_num += tmp_malloc_size % m_memory_page_size > 0 ? 1 : 0;
 			malloc_size = page_num * m_memory_page_size;
+			block_set = (BlockSet *)malloc(malloc_size);
 		}
 
-		block_set = (BlockSet *)malloc(malloc_size);
 		{
 			++m_working_block_set_num;
+			m_stat.working_block_set_num = m_working_block_set_num;
+			++m_stat.block_set_alloc_num;
 			memset(block_set, 0, sizeof(BlockSet));
+			block_set->span_head.tag = m_span_tag;
+			block_set->span_head.size = malloc_size;
 			block_set->id = block_id;
 			block_set->block_size = real_block_size;
-			block_set->total_num = (malloc_size - sizeof(BlockSet)) / block_set->block_size;
-			block_set->free_block.next = &block_set->blocks_begin;
+			block_set->total_num = (malloc_size - blocks_offset) / block_set->block_size;
+			block_set->free_block.next = (char *)block_set + blocks_offset;
 			{
 				char *p = (char *)block_set->free_block.next;
 				char *q = (char *)block_set + malloc_size;
@@ -99,46 +125,72 @@ void * MemoryPool::Malloc()
 					}
 				}
 			}
+			m_stat.total_block_num += block_set->total_num;
+			m_stat.block_set_bytes += malloc_size;
 			if (m_block_sets.size() == block_id)
 				m_block_sets.push_back(block_set);
 			else
 				m_block_sets[block_id] = block_set;
 			if (block_id > m_valid_bolck_set_max_id)
 				m_valid_bolck_set_max_id = block_id;
+			this->LinkFreeBlockSet(block_set);
 		}
 	}
 	assert(nullptr != block_set);
 	assert(nullptr != block_set->free_block.next);
 
-	m_free_block_set_min_id = block_set->id;
 	char *mem_ptr = (char *)block_set->free_block.next;
 	block_set->free_block.next = ((BlockLink *)block_set->free_block.next)->next;
 	++block_set->used_num;
+	if (++m_stat.used_block_num > m_stat.peak_used_block_num)
+		m_stat.peak_used_block_num = m_stat.used_block_num;
+	if (nullptr == block_set->free_block.next)
+		this->UnlinkFreeBlockSet(block_set);
+	if (m_span_size > 0)
+		return mem_ptr;
 	*(uint32_t *)mem_ptr = block_set->id;
 	return mem_ptr + BlockSet::ID_DESCRIPT_LEN;
 }
 
 void MemoryPool::Free(void *ptr)
 {
-	void *real_ptr = (char *)ptr - BlockSet::ID_DESCRIPT_LEN;
-	uint32_t block_id = *(uint32_t *)real_ptr;
+	void *real_ptr = nullptr;
+	uint32_t block_id = 0;
+	if (m_span_size > 0)
+	{
+		real_ptr = ptr;
+		block_id = ((BlockSet *)GetSpanHead(ptr, m_span_size))->id;
+	}
+	else
+	{
+		real_ptr = (char *)ptr - BlockSet::ID_DESCRIPT_LEN;
+		block_id = *(uint32_t *)real_ptr;
+	}
 	assert(m_valid_bolck_set_max_id >= block_id);
 	BlockSet *block_set = m_block_sets[block_id];
 	assert(nullptr != block_set);
+	if (nullptr == block_set->free_block.next)
+		this->LinkFreeBlockSet(block_set);
 	((BlockLink *)real_ptr)->next = block_set->free_block.next;
 	block_set->free_block.next = real_ptr;
 	real_ptr = nullptr;
 	--block_set->used_num;
+	--m_stat.used_block_num;
 
 	if (m_working_block_set_num > m_expect_working_block_set_num)
 	{
 		if (block_set->used_num <= 0)
 		{
+			this->UnlinkFreeBlockSet(block_set);
 			m_block_sets[block_id] = nullptr;
 			m_recycle_ids.push(block_id);
-			free(block_set);
+			++m_stat.block_set_free_num;
+			m_stat.total_block_num -= block_set->total_num;
+			m_stat.block_set_bytes -= block_set->span_head.size;
+			this->FreeBlockSet(block_set);
 			block_set = nullptr;
 			--m_working_block_set_num;
+			m_stat.working_block_set_num = m_working_block_set_num;
 		}
 	}
 }
@@ -158,3 +210,54 @@ uint32_t MemoryPool::GenBlockId()
 	return ret_id;
 }
 
+void MemoryPool::LinkFreeBlockSet(BlockSet *block_set)
+{
+	block_set->prev_free_set = nullptr;
+	block_set->next_free_set = m_free_block_sets;
+	if (nullptr != m_free_block_sets)
+		m_free_block_sets->prev_free_set = block_set;
+	m_free_block_sets = block_set;
+}
+
+void MemoryPool::UnlinkFreeBlockSet(BlockSet *block_set)
+{
+	if (nullptr != block_set->prev_free_set)
+		block_set->prev_free_set->next_free_set = block_set->next_free_set;
+	else
+		m_free_block_sets = block_set->next_free_set;
+	if (nullptr != block_set->next_free_set)
+		block_set->next_free_set->prev_free_set = block_set->prev_free_set;
+	block_set->prev_free_set = nullptr;
+	block_set->next_free_set = nullptr;
+}
+
+void MemoryPool::FreeBlockSet(BlockSet *block_set)
+{
+	if (nullptr != m_span_allocator)
+		m_span_allocator->FreeSpan(block_set);
+	else if (m_span_size > 0)
+		AlignedFree(block_set);
+	else
+		free(block_set);
+}
+
+void * MemoryPool::AlignedMalloc(uint32_t alignment, size_t size)
+{
+#ifdef WIN32
+	return _aligned_malloc(size, alignment);
+#else
+	void *ptr = nullptr;
+	if (0 != posix_memalign(&ptr, alignment, size))
+		ptr = nullptr;
+	return ptr;
+#endif
+}
+
+void MemoryPool::AlignedFree(void *ptr)
+{
+#ifdef WIN32
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
\ No newline at end of file
@@ -1,32 +1,73 @@
 #pragma once
 #include <stdint.h>
+#include <stddef.h>
 #include <queue>
 #include <vector>
 #include <functional>
 struct BlockSet;
+class SpanChunkAllocator;
+
+// in span mode every BlockSet is span_size bytes and aligned to span_size, so blocks carry no header: 
+// the owner of a block is found by masking its address down to the SpanHead at the begin of the span
+struct SpanHead
+{
+	uint32_t tag = 0;
+	uint32_t size = 0;
+};
+
+struct MemoryPoolStat
+{
+	uint32_t used_block_num = 0; // blocks handed out by Malloc and not freed yet
+	uint32_t peak_used_block_num = 0;
+	uint32_t total_block_num = 0; // blocks of all working block sets
+	uint32_t working_block_set_num = 0;
+	uint64_t block_set_alloc_num = 0;
+	uint64_t block_set_free_num = 0;
+	uint64_t block_set_bytes = 0; // bytes of all working block sets
+};
 
 class MemoryPool
 {
 public:
 	MemoryPool(uint32_t block_size, uint32_t memory_page_size);
 	MemoryPool(uint32_t block_size, uint32_t memory_page_size, uint32_t expect_working_block_set_num, uint32_t min_block_num_per_block_set);
+	// span_allocator may be shared by pools of the same span_size, nullptr means every span is aligned malloced
+	MemoryPool(uint32_t block_size, uint32_t memory_page_size, uint32_t expect_working_block_set_num, uint32_t min_block_num_per_block_set, uint32_t span_size, uint32_t span_tag, 
+		SpanChunkAllocator *span_allocator = nullptr);
 	~MemoryPool();
 
 	void * Malloc();
 	void Free(void *);
 
+	const MemoryPoolStat & GetStat() { return m_stat; }
+
+	static const uint32_t SPAN_BLOCK_ALIGN = 16;
+	static inline SpanHead * GetSpanHead(void *ptr, uint32_t span_size)
+	{
+		return (SpanHead *)((uintptr_t)ptr & ~(uintptr_t)(span_size - 1));
+	}
+	static void * AlignedMalloc(uint32_t alignment, size_t size);
+	static void AlignedFree(void *ptr);
+
 private:
 	uint32_t m_last_id = 0;
 	std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> m_recycle_ids;
 	std::vector<BlockSet *> m_block_sets;
-	uint32_t m_free_block_set_min_id = 0;
+	BlockSet *m_free_block_sets = nullptr; // intrusive list of block sets which still have free blocks
 	uint32_t m_valid_bolck_set_max_id = 0;
 	uint32_t m_block_size = 0;
 	uint32_t m_memory_page_size = 4 * 1024;
 	uint32_t m_expect_working_block_set_num = 8;
 	uint32_t m_working_block_set_num = 0;
 	uint32_t m_min_block_num_per_block_set = 16;
+	uint32_t m_span_size = 0; // 0 means every block is prefixed by its block set id
+	uint32_t m_span_tag = 0;
+	SpanChunkAllocator *m_span_allocator = nullptr;
+	MemoryPoolStat m_stat;
 
 private: 
 	uint32_t GenBlockId();
+	void LinkFreeBlockSet(BlockSet *block_set);
+	void UnlinkFreeBlockSet(BlockSet *block_set);
+	void FreeBlockSet(BlockSet *block_set);
 };
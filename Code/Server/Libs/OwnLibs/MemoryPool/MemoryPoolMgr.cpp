@@ -1,10 +1,65 @@
 #include "MemoryPoolMgr.h"
 #include "MemoryPool.h"
+#include "SpanChunkAllocator.h"
 #include <algorithm>
 #include <assert.h>
+#include <string.h>
 #include <set>
 
-MemoryPoolMgr::MemoryPoolMgr(const std::vector<uint32_t> block_sizes, uint32_t memory_page_size, uint32_t expect_working_block_set_num, uint32_t min_block_num_per_block_set)
+struct MemoryPoolMgr::ThreadCache
+{
+	struct Magazine
+	{
+		void **blocks = nullptr;
+		uint32_t num = 0;
+		// written by the owner thread only, read by GetStats
+		std::atomic<uint64_t> malloc_num;
+		std::atomic<uint64_t> free_num;
+		std::atomic<uint64_t> round_waste_bytes;
+		Magazine() : malloc_num(0), free_num(0), round_waste_bytes(0) {}
+	};
+
+	MemoryPoolMgr *mgr = nullptr; // nullptr means the mgr was destroyed before the thread exit
+	Magazine *magazines = nullptr; // one per MemoryPoolData, indexed by MemoryPoolData::idx
+	ThreadCache *next = nullptr; // next cache of the same thread
+};
+
+static std::mutex thread_cache_registry_mutex;
+
+static inline void AddOwnedCounter(std::atomic<uint64_t> &counter, uint64_t val)
+{
+	// single writer, so a relaxed load and store is enough and keeps locked instructions off the fast path
+	counter.store(counter.load(std::memory_order_relaxed) + val, std::memory_order_relaxed);
+}
+
+// set when the holder of this thread is destroyed. thread_locals destroyed after it may still free blocks,
+// those calls go straight to the pools instead of creating a cache nobody would release. no destructor, so it stays readable
+static thread_local bool thread_cache_holder_destroyed = false;
+
+struct ThreadCacheHolder
+{
+	~ThreadCacheHolder()
+	{
+		thread_cache_holder_destroyed = true;
+		thread_cache_registry_mutex.lock();
+		while (nullptr != head)
+		{
+			MemoryPoolMgr::ThreadCache *cache = head;
+			head = cache->next;
+			if (nullptr != cache->mgr)
+				cache->mgr->ReleaseThreadCache(cache);
+			free(cache);
+		}
+		thread_cache_registry_mutex.unlock();
+	}
+
+	MemoryPoolMgr::ThreadCache *head = nullptr;
+};
+static thread_local ThreadCacheHolder thread_cache_holder;
+
+MemoryPoolMgr::MemoryPoolMgr(const std::vector<uint32_t> block_sizes, uint32_t memory_page_size, uint32_t expect_working_block_set_num, uint32_t min_block_num_per_block_set, uint32_t span_size,
+	uint32_t span_chunk_size, bool use_huge_page)
+	: m_span_size(span_size), m_large_malloc_num(0), m_large_free_num(0), m_large_live_bytes(0)
 {
 	assert(block_sizes.size() > 0);
 	std::vector<uint32_t> tmp_block_sizes(block_sizes);
@@ -18,13 +73,31 @@ MemoryPoolMgr::MemoryPoolMgr(const std::vector<uint32_t> block_sizes, uint32_t m
 		assert(0 == block_size % BLOCK_SIZE_MULTI_BASE);
 	}
 	m_max_block_size = tmp_block_sizes.back();
+	if (m_span_size > 0)
+	{
+		// every span comes from the chunk allocator, so an address outside its chunks is a large block
+		m_span_allocator = new SpanChunkAllocator(m_span_size, span_chunk_size > m_span_size ? span_chunk_size : m_span_size, use_huge_page);
+		m_large_head_len = LARGE_SPAN_MODE_HEAD_LEN;
+	}
 	m_memory_pool_fast_idx = (MemoryPoolData **)malloc(sizeof(MemoryPoolData *) * (m_max_block_size / BLOCK_SIZE_MULTI_BASE + 1));
 	m_memory_pool_fast_idx[0] = nullptr;
 	uint32_t used_pool_idx = 0;
 	for (uint32_t block_size : block_sizes)
 	{
-		MemoryPool *memory_pool = new MemoryPool(block_size + BLOCK_SIZE_DESCRIPT_LEN, memory_page_size, expect_working_block_set_num, min_block_num_per_block_set);
-		MemoryPoolData *memory_pool_data = new MemoryPoolData(memory_pool);
+		uint32_t cache_capacity = THREAD_CACHE_BYTES_PER_POOL / block_size;
+		if (cache_capacity < THREAD_CACHE_MIN_BLOCK_NUM)
+			cache_capacity = THREAD_CACHE_MIN_BLOCK_NUM;
+		if (cache_capacity > THREAD_CACHE_MAX_BLOCK_NUM)
+			cache_capacity = THREAD_CACHE_MAX_BLOCK_NUM;
+		m_thread_cache_block_num += cache_capacity;
+
+		uint32_t pool_idx = (uint32_t)m_memory_pools.size();
+		MemoryPool *memory_pool = nullptr;
+		if (m_span_size > 0)
+			memory_pool = new MemoryPool(block_size, memory_page_size, expect_working_block_set_num, min_block_num_per_block_set, m_span_size, pool_idx, m_span_allocator);
+		else
+			memory_pool = new MemoryPool(block_size + BLOCK_SIZE_DESCRIPT_LEN, memory_page_size, expect_working_block_set_num, min_block_num_per_block_set);
+		MemoryPoolData *memory_pool_data = new MemoryPoolData(memory_pool, pool_idx, block_size, cache_capacity);
 		m_memory_pools.push_back(memory_pool_data);
 		for (uint32_t i = used_pool_idx + 1; i <= block_size / BLOCK_SIZE_MULTI_BASE; ++i)
 		{
@@ -36,11 +109,20 @@ MemoryPoolMgr::MemoryPoolMgr(const std::vector<uint32_t> block_sizes, uint32_t m
 
 MemoryPoolMgr::~MemoryPoolMgr()
 {
+	// blocks still cached by other threads go away together with the pools
+	thread_cache_registry_mutex.lock();
+	for (ThreadCache *cache : m_thread_caches)
+		cache->mgr = nullptr;
+	m_thread_caches.clear();
+	thread_cache_registry_mutex.unlock();
+
 	for (MemoryPoolData *memory_pool : m_memory_pools)
 	{
 		delete memory_pool;
 	}
 	m_memory_pools.clear();
+	delete m_span_allocator;
+	m_span_allocator = nullptr;
 	free(m_memory_pool_fast_idx);
 	m_memory_pool_fast_idx = nullptr;
 }
@@ -48,38 +130,342 @@ MemoryPoolMgr::~MemoryPoolMgr()
 void * MemoryPoolMgr::Malloc(uint32_t malloc_size)
 {
 	assert(malloc_size > 0);
-	void *ret_ptr = nullptr;
 	if (malloc_size > m_max_block_size)
-		ret_ptr = malloc(malloc_size + BLOCK_SIZE_DESCRIPT_LEN);
-	else
-	{
-		uint32_t pool_idx = malloc_size / BLOCK_SIZE_MULTI_BASE;
-		pool_idx += (malloc_size % BLOCK_SIZE_MULTI_BASE) > 0 ? 1 : 0;
-		MemoryPoolData *data = m_memory_pool_fast_idx[pool_idx];
-		data->mtx.lock();
-		ret_ptr = data->memory_pool->Malloc();
-		data->mtx.unlock();
-	}
+		return this->MallocLarge(malloc_size);
+
+	void *ret_ptr = this->MallocBlock(this->GetPoolData(malloc_size), malloc_size);
 	assert(nullptr != ret_ptr);
+	if (m_span_size > 0)
+		return ret_ptr;
 	*(uint32_t *)ret_ptr = malloc_size;
 	return (char *)ret_ptr + BLOCK_SIZE_DESCRIPT_LEN;
 }
 
 void MemoryPoolMgr::Free(void *ptr)
 {
+	if (m_span_size > 0)
+	{
+		if (m_span_allocator->IsChunkMemory(ptr))
+			this->FreeBlock(m_memory_pools[MemoryPool::GetSpanHead(ptr, m_span_size)->tag], ptr);
+		else
+			this->FreeLarge(ptr);
+		return;
+	}
+
 	void *real_ptr = (char *)ptr - BLOCK_SIZE_DESCRIPT_LEN;
-	ptr = nullptr;
 	uint32_t malloc_size = *(uint32_t *)real_ptr;
 	if (malloc_size > m_max_block_size)
-		free(real_ptr);
+		this->FreeLarge(ptr);
+	else
+		this->FreeBlock(this->GetPoolData(malloc_size), real_ptr);
+	ptr = nullptr;
+	real_ptr = nullptr;
+}
+
+void * MemoryPoolMgr::Realloc(void *ptr, uint32_t malloc_size)
+{
+	if (nullptr == ptr)
+		return this->Malloc(malloc_size);
+	if (malloc_size <= 0)
+	{
+		this->Free(ptr);
+		return nullptr;
+	}
+
+	bool is_large = false;
+	uint32_t old_size = 0;
+	if (m_span_size > 0)
+	{
+		is_large = !m_span_allocator->IsChunkMemory(ptr);
+		if (is_large)
+			old_size = this->LargeSize(ptr);
+		else
+		{
+			MemoryPoolData *data = m_memory_pools[MemoryPool::GetSpanHead(ptr, m_span_size)->tag];
+			old_size = data->block_size;
+			if (malloc_size <= m_max_block_size && data == this->GetPoolData(malloc_size))
+				return ptr;
+		}
+	}
+	else
+	{
+		uint32_t *size_head = (uint32_t *)((char *)ptr - BLOCK_SIZE_DESCRIPT_LEN);
+		old_size = *size_head;
+		is_large = old_size > m_max_block_size;
+		if (!is_large && malloc_size <= m_max_block_size && this->GetPoolData(old_size) == this->GetPoolData(malloc_size))
+		{
+			*size_head = malloc_size;
+			return ptr;
+		}
+	}
+	if (is_large && malloc_size > m_max_block_size)
+		return this->ReallocLarge(ptr, malloc_size);
+
+	void *new_ptr = this->Malloc(malloc_size);
+	memcpy(new_ptr, ptr, old_size < malloc_size ? old_size : malloc_size);
+	this->Free(ptr);
+	return new_ptr;
+}
+
+uint32_t MemoryPoolMgr::MallocSize(void *ptr)
+{
+	if (m_span_size > 0)
+	{
+		if (!m_span_allocator->IsChunkMemory(ptr))
+			return this->LargeSize(ptr);
+		return m_memory_pools[MemoryPool::GetSpanHead(ptr, m_span_size)->tag]->block_size;
+	}
+	return *(uint32_t *)((char *)ptr - BLOCK_SIZE_DESCRIPT_LEN);
+}
+
+void * MemoryPoolMgr::MallocLarge(uint32_t malloc_size)
+{
+	m_large_malloc_num.fetch_add(1, std::memory_order_relaxed);
+	m_large_live_bytes.fetch_add(malloc_size, std::memory_order_relaxed);
+	void *ret_ptr = malloc(malloc_size + m_large_head_len);
+	assert(nullptr != ret_ptr);
+	*(uint32_t *)ret_ptr = malloc_size;
+	return (char *)ret_ptr + m_large_head_len;
+}
+
+void MemoryPoolMgr::FreeLarge(void *ptr)
+{
+	m_large_free_num.fetch_add(1, std::memory_order_relaxed);
+	m_large_live_bytes.fetch_sub(this->LargeSize(ptr), std::memory_order_relaxed);
+	free((char *)ptr - m_large_head_len);
+}
+
+void * MemoryPoolMgr::ReallocLarge(void *ptr, uint32_t malloc_size)
+{
+	// big chunks are mmaped by the platform malloc, and realloc grows them by mremap without a copy
+	void *real_ptr = (char *)ptr - m_large_head_len;
+	uint32_t old_size = *(uint32_t *)real_ptr;
+	real_ptr = realloc(real_ptr, malloc_size + m_large_head_len);
+	assert(nullptr != real_ptr);
+	*(uint32_t *)real_ptr = malloc_size;
+	m_large_live_bytes.fetch_add((uint64_t)malloc_size - old_size, std::memory_order_relaxed);
+	return (char *)real_ptr + m_large_head_len;
+}
+
+void * MemoryPoolMgr::MallocBlock(MemoryPoolData *data, uint32_t malloc_size)
+{
+	void *ret_ptr = nullptr;
+	ThreadCache *cache = this->GetThreadCache();
+	if (nullptr == cache)
+	{
+		data->mtx.lock();
+		ret_ptr = data->memory_pool->Malloc();
+		++data->malloc_num;
+		data->round_waste_bytes += data->block_size - malloc_size;
+		data->mtx.unlock();
+	}
 	else
 	{
-		uint32_t pool_idx = malloc_size / BLOCK_SIZE_MULTI_BASE;
-		pool_idx += (malloc_size % BLOCK_SIZE_MULTI_BASE) > 0 ? 1 : 0;
-		MemoryPoolData *data = m_memory_pool_fast_idx[pool_idx];
+		ThreadCache::Magazine &magazine = cache->magazines[data->idx];
+		if (magazine.num <= 0)
+		{
+			// exchange takes the whole list, so no node is ever popped concurrently and ABA can not happen
+			void *remote_block = nullptr;
+			if (nullptr != data->remote_free_blocks.load(std::memory_order_relaxed))
+				remote_block = data->remote_free_blocks.exchange(nullptr, std::memory_order_acquire);
+			if (nullptr != remote_block)
+			{
+				while (nullptr != remote_block && magazine.num < data->cache_capacity)
+				{
+					magazine.blocks[magazine.num++] = remote_block;
+					remote_block = *(void **)remote_block;
+				}
+				data->remote_free_num.fetch_sub(magazine.num, std::memory_order_relaxed);
+				if (nullptr != remote_block)
+				{
+					uint32_t rest_num = 1;
+					void *rest_tail = remote_block;
+					while (nullptr != *(void **)rest_tail)
+					{
+						rest_tail = *(void **)rest_tail;
+						++rest_num;
+					}
+					data->remote_free_num.fetch_sub(rest_num, std::memory_order_relaxed);
+					this->PushRemoteFreeBlocks(data, remote_block, rest_tail, rest_num);
+				}
+			}
+			else
+			{
+				data->mtx.lock();
+				while (magazine.num < data->cache_batch_num)
+					magazine.blocks[magazine.num++] = data->memory_pool->Malloc();
+				data->mtx.unlock();
+			}
+		}
+		ret_ptr = magazine.blocks[--magazine.num];
+		AddOwnedCounter(magazine.malloc_num, 1);
+		AddOwnedCounter(magazine.round_waste_bytes, data->block_size - malloc_size);
+	}
+	return ret_ptr;
+}
+
+void MemoryPoolMgr::FreeBlock(MemoryPoolData *data, void *block)
+{
+	ThreadCache *cache = this->GetThreadCache();
+	if (nullptr == cache)
+	{
 		data->mtx.lock();
-		data->memory_pool->Free(real_ptr);
+		data->memory_pool->Free(block);
+		++data->free_num;
 		data->mtx.unlock();
 	}
-	real_ptr = nullptr;
+	else
+	{
+		ThreadCache::Magazine &magazine = cache->magazines[data->idx];
+		if (magazine.num >= data->cache_capacity)
+		{
+			// give back the coldest blocks, keep the recently freed ones hot in this thread
+			if (data->remote_free_num.load(std::memory_order_relaxed) < (int32_t)data->remote_free_limit)
+			{
+				for (uint32_t i = 0; i + 1 < data->cache_batch_num; ++i)
+					*(void **)magazine.blocks[i] = magazine.blocks[i + 1];
+				this->PushRemoteFreeBlocks(data, magazine.blocks[0], magazine.blocks[data->cache_batch_num - 1], data->cache_batch_num);
+			}
+			else
+			{
+				data->mtx.lock();
+				for (uint32_t i = 0; i < data->cache_batch_num; ++i)
+					data->memory_pool->Free(magazine.blocks[i]);
+				data->mtx.unlock();
+			}
+			magazine.num -= data->cache_batch_num;
+			memmove(magazine.blocks, magazine.blocks + data->cache_batch_num, sizeof(void *) * magazine.num);
+		}
+		magazine.blocks[magazine.num++] = block;
+		AddOwnedCounter(magazine.free_num, 1);
+	}
+}
+
+void MemoryPoolMgr::PushRemoteFreeBlocks(MemoryPoolData *data, void *head, void *tail, uint32_t num)
+{
+	// counted before linked, so the count may run ahead of the list but never behind
+	data->remote_free_num.fetch_add(num, std::memory_order_relaxed);
+	void *old_head = data->remote_free_blocks.load(std::memory_order_relaxed);
+	do
+	{
+		*(void **)tail = old_head;
+	} while (!data->remote_free_blocks.compare_exchange_weak(old_head, head, std::memory_order_release, std::memory_order_relaxed));
+}
+
+MemoryPoolMgr::ThreadCache * MemoryPoolMgr::GetThreadCache()
+{
+	if (thread_cache_holder_destroyed)
+		return nullptr;
+	for (ThreadCache *cache = thread_cache_holder.head; nullptr != cache; cache = cache->next)
+	{
+		if (this == cache->mgr)
+			return cache;
+	}
+	return this->NewThreadCache();
+}
+
+MemoryPoolMgr::ThreadCache * MemoryPoolMgr::NewThreadCache()
+{
+	uint32_t magazines_size = sizeof(ThreadCache::Magazine) * (uint32_t)m_memory_pools.size();
+	uint32_t malloc_size = sizeof(ThreadCache) + magazines_size + sizeof(void *) * m_thread_cache_block_num;
+	char *mem = (char *)malloc(malloc_size);
+	if (nullptr == mem)
+		return nullptr;
+
+	ThreadCache *cache = new(mem) ThreadCache();
+	cache->mgr = this;
+	cache->magazines = (ThreadCache::Magazine *)(mem + sizeof(ThreadCache));
+	void **blocks = (void **)(mem + sizeof(ThreadCache) + magazines_size);
+	for (MemoryPoolData *data : m_memory_pools)
+	{
+		ThreadCache::Magazine *magazine = new(&cache->magazines[data->idx]) ThreadCache::Magazine();
+		magazine->blocks = blocks;
+		blocks += data->cache_capacity;
+	}
+
+	thread_cache_registry_mutex.lock();
+	m_thread_caches.insert(cache);
+	thread_cache_registry_mutex.unlock();
+	cache->next = thread_cache_holder.head;
+	thread_cache_holder.head = cache;
+	return cache;
+}
+
+void MemoryPoolMgr::ReleaseThreadCache(ThreadCache *cache)
+{
+	// caller holds thread_cache_registry_mutex
+	for (MemoryPoolData *data : m_memory_pools)
+	{
+		ThreadCache::Magazine &magazine = cache->magazines[data->idx];
+		// the exiting thread may have been the only one refilling, so hand the remote list back to the pool too
+		void *remote_block = data->remote_free_blocks.exchange(nullptr, std::memory_order_acquire);
+		data->mtx.lock();
+		while (magazine.num > 0)
+			data->memory_pool->Free(magazine.blocks[--magazine.num]);
+		while (nullptr != remote_block)
+		{
+			void *next_block = *(void **)remote_block;
+			data->memory_pool->Free(remote_block);
+			data->remote_free_num.fetch_sub(1, std::memory_order_relaxed);
+			remote_block = next_block;
+		}
+		data->malloc_num += magazine.malloc_num.load(std::memory_order_relaxed);
+		data->free_num += magazine.free_num.load(std::memory_order_relaxed);
+		data->round_waste_bytes += magazine.round_waste_bytes.load(std::memory_order_relaxed);
+		data->mtx.unlock();
+	}
+	m_thread_caches.erase(cache);
+	cache->mgr = nullptr;
 }
+
+
+void MemoryPoolMgr::GetStats(std::vector<MemoryPoolMgrStat> &pool_stats, MemoryPoolMgrStat &large_stat)
+{
+	pool_stats.clear();
+	pool_stats.resize(m_memory_pools.size());
+
+	// registry first then pool, the same order as ReleaseThreadCache, so no cache is counted twice or lost
+	thread_cache_registry_mutex.lock();
+	for (ThreadCache *cache : m_thread_caches)
+	{
+		for (MemoryPoolData *data : m_memory_pools)
+		{
+			ThreadCache::Magazine &magazine = cache->magazines[data->idx];
+			MemoryPoolMgrStat &stat = pool_stats[data->idx];
+			stat.malloc_num += magazine.malloc_num.load(std::memory_order_relaxed);
+			stat.free_num += magazine.free_num.load(std::memory_order_relaxed);
+			stat.round_waste_bytes += magazine.round_waste_bytes.load(std::memory_order_relaxed);
+		}
+	}
+	for (MemoryPoolData *data : m_memory_pools)
+	{
+		MemoryPoolMgrStat &stat = pool_stats[data->idx];
+		data->mtx.lock();
+		MemoryPoolStat pool_stat = data->memory_pool->GetStat();
+		stat.malloc_num += data->malloc_num;
+		stat.free_num += data->free_num;
+		stat.round_waste_bytes += data->round_waste_bytes;
+		data->mtx.unlock();
+
+		stat.block_size = data->block_size;
+		// threads keep running while we sum, so a block freed by another thread may be seen before its malloc
+		stat.live_block_num = stat.malloc_num > stat.free_num ? stat.malloc_num - stat.free_num : 0;
+		stat.live_bytes = stat.live_block_num * data->block_size;
+		stat.peak_block_num = pool_stat.peak_used_block_num;
+		stat.cached_block_num = pool_stat.used_block_num > stat.live_block_num ? pool_stat.used_block_num - stat.live_block_num : 0;
+		int32_t remote_free_num = data->remote_free_num.load(std::memory_order_relaxed);
+		stat.remote_free_block_num = remote_free_num > 0 ? remote_free_num : 0;
+		stat.block_set_num = pool_stat.working_block_set_num;
+		stat.block_set_alloc_num = pool_stat.block_set_alloc_num;
+		stat.block_set_free_num = pool_stat.block_set_free_num;
+		stat.header_waste_bytes = pool_stat.block_set_bytes - (uint64_t)pool_stat.total_block_num * data->block_size;
+	}
+	thread_cache_registry_mutex.unlock();
+
+	large_stat = MemoryPoolMgrStat();
+	large_stat.malloc_num = m_large_malloc_num.load(std::memory_order_relaxed);
+	large_stat.free_num = m_large_free_num.load(std::memory_order_relaxed);
+	large_stat.live_block_num = large_stat.malloc_num > large_stat.free_num ? large_stat.malloc_num - large_stat.free_num : 0;
+	large_stat.live_bytes = m_large_live_bytes.load(std::memory_order_relaxed);
+	large_stat.header_waste_bytes = large_stat.live_block_num * m_large_head_len;
+}
\ No newline at end of file
@@ -1,25 +1,74 @@
 #pragma once
 
+#include <stdint.h>
 #include <vector>
+#include <set>
 #include <mutex>
+#include <atomic>
 
 class MemoryPool;
+class SpanChunkAllocator;
+struct ThreadCacheHolder;
+
+// counters of one size class, or of the large blocks which fall through to raw malloc (block_size is 0)
+struct MemoryPoolMgrStat
+{
+	uint32_t block_size = 0;
+	uint64_t malloc_num = 0;
+	uint64_t free_num = 0;
+	uint64_t live_block_num = 0;
+	uint64_t live_bytes = 0;
+	uint64_t peak_block_num = 0; // peak of blocks out of the shared pool, thread cached ones included
+	uint64_t cached_block_num = 0; // blocks held by thread caches and the remote free list
+	uint64_t remote_free_block_num = 0;
+	uint64_t block_set_num = 0;
+	uint64_t block_set_alloc_num = 0;
+	uint64_t block_set_free_num = 0;
+	uint64_t round_waste_bytes = 0; // accumulated (block_size - requested size) of every malloc
+	uint64_t header_waste_bytes = 0; // block headers, block set headers and span tails currently held
+};
 
 class MemoryPoolMgr
 {
+	friend struct ThreadCacheHolder;
 public:
-	MemoryPoolMgr(std::vector<uint32_t> block_sizes, uint32_t memory_page_size, uint32_t expect_working_block_set_num, uint32_t min_block_num_per_block_set);
+	// span_size > 0 switches to header-free mode: block sets are span_size aligned and Free finds the owner pool by address. 
+	// in this mode memory_page_size and min_block_num_per_block_set are unused, and only large blocks carry a head.
+	// the spans of all pools are carved from chunks of span_chunk_size (span_size if smaller), use_huge_page asks the os to back them by huge pages
+	MemoryPoolMgr(std::vector<uint32_t> block_sizes, uint32_t memory_page_size, uint32_t expect_working_block_set_num, uint32_t min_block_num_per_block_set, uint32_t span_size = 0, 
+		uint32_t span_chunk_size = 0, bool use_huge_page = false);
 	~MemoryPoolMgr();
 
 	const static uint32_t BLOCK_SIZE_DESCRIPT_LEN = sizeof(uint32_t);
 	void * Malloc(uint32_t malloc_size);
 	void Free(void *ptr);
+	// keeps ptr when the new size is in the same size class, large blocks are resized in place when possible
+	void * Realloc(void *ptr, uint32_t malloc_size);
+	uint32_t MallocSize(void *ptr); // usable bytes of ptr, may be greater than the requested size in span mode
+	bool IsSpanMode() { return m_span_size > 0; }
+	// a snapshot of all size classes, counters of different threads are summed without stopping them
+	void GetStats(std::vector<MemoryPoolMgrStat> &pool_stats, MemoryPoolMgrStat &large_stat);
 private:
 	struct MemoryPoolData
 	{
-		MemoryPoolData(MemoryPool *_memory_pool) : memory_pool(_memory_pool) {}
+		MemoryPoolData(MemoryPool *_memory_pool, uint32_t _idx, uint32_t _block_size, uint32_t _cache_capacity) 
+			: memory_pool(_memory_pool), idx(_idx), block_size(_block_size), cache_capacity(_cache_capacity), cache_batch_num(_cache_capacity / 2),
+			remote_free_limit(_cache_capacity * REMOTE_FREE_LIMIT_MULTI), remote_free_blocks(nullptr), remote_free_num(0) {}
 		std::mutex mtx;
 		MemoryPool *memory_pool = nullptr;
+		uint32_t idx = 0;
+		uint32_t block_size = 0;
+		uint32_t cache_capacity = 0; // max blocks a thread cache keeps for this pool
+		uint32_t cache_batch_num = 0; // blocks moved per refill/flush
+		// batches flushed by thread caches are pushed here without the lock, and the next refill takes the whole list at once.
+		// so blocks malloced by one thread and freed by another travel between them without touching mtx
+		uint32_t remote_free_limit = 0; // beyond it flushes go to memory_pool, so the list can not hoard memory
+		std::atomic<void *> remote_free_blocks;
+		std::atomic<int32_t> remote_free_num;
+		// counters of the uncached path and of released thread caches, guarded by mtx
+		uint64_t malloc_num = 0;
+		uint64_t free_num = 0;
+		uint64_t round_waste_bytes = 0;
 	};
 
 	std::vector<MemoryPoolData *> m_memory_pools;
@@ -27,4 +76,40 @@ private:
 	MemoryPoolData **m_memory_pool_fast_idx = nullptr;
 
 	const static int BLOCK_SIZE_MULTI_BASE = 8; // block must be times of 8
+
+	uint32_t m_span_size = 0;
+	SpanChunkAllocator *m_span_allocator = nullptr;
+	const static uint32_t LARGE_SPAN_MODE_HEAD_LEN = 16; // keeps large blocks 16 bytes aligned in span mode
+	uint32_t m_large_head_len = BLOCK_SIZE_DESCRIPT_LEN; // large blocks are malloced with their size in front
+	std::atomic<uint64_t> m_large_malloc_num;
+	std::atomic<uint64_t> m_large_free_num;
+	std::atomic<uint64_t> m_large_live_bytes;
+	void * MallocLarge(uint32_t malloc_size);
+	void FreeLarge(void *ptr);
+	void * ReallocLarge(void *ptr, uint32_t malloc_size);
+	uint32_t LargeSize(void *ptr) { return *(uint32_t *)((char *)ptr - m_large_head_len); }
+	MemoryPoolData * GetPoolData(uint32_t malloc_size)
+	{
+		uint32_t pool_idx = malloc_size / BLOCK_SIZE_MULTI_BASE;
+		pool_idx += (malloc_size % BLOCK_SIZE_MULTI_BASE) > 0 ? 1 : 0;
+		return m_memory_pool_fast_idx[pool_idx];
+	}
+	void * MallocBlock(MemoryPoolData *data, uint32_t malloc_size);
+	void FreeBlock(MemoryPoolData *data, void *block);
+	void PushRemoteFreeBlocks(MemoryPoolData *data, void *head, void *tail, uint32_t num);
+	const static uint32_t REMOTE_FREE_LIMIT_MULTI = 4;
+
+private:
+	// every thread owns one ThreadCache per MemoryPoolMgr, so the common Malloc/Free path takes no lock.
+	// blocks are moved between the ThreadCache and the shared MemoryPool in batches of MemoryPoolData::cache_batch_num
+	struct ThreadCache;
+	ThreadCache * GetThreadCache();
+	ThreadCache * NewThreadCache();
+	void ReleaseThreadCache(ThreadCache *cache);
+	std::set<ThreadCache *> m_thread_caches; // guarded by thread cache registry mutex
+	uint32_t m_thread_cache_block_num = 0;
+
+	const static uint32_t THREAD_CACHE_BYTES_PER_POOL = 32 * 1024;
+	const static uint32_t THREAD_CACHE_MIN_BLOCK_NUM = 4;
+	const static uint32_t THREAD_CACHE_MAX_BLOCK_NUM = 128;
 };
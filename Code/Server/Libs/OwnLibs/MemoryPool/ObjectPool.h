@@ -0,0 +1,227 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <new>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include "ShareCode/Common/Utils/MemoryUtil.h"
+
+struct ObjectPoolStat
+{
+	const char *name = nullptr;
+	uint32_t object_size = 0;
+	uint64_t live_num = 0;
+	uint64_t peak_live_num = 0;
+	uint64_t capacity = 0; // objects of all chunks
+	uint64_t chunk_num = 0;
+	uint64_t cached_num = 0; // released objects which are still constructed
+	uint64_t fallback_num = 0; // allocations of other sizes (derived classes) passed to MemoryUtil
+};
+
+// every ObjectPool registers itself, so all of them can be inspected at runtime
+class ObjectPoolBase
+{
+public:
+	ObjectPoolBase(const char *name) : m_name(name)
+	{
+		RegistryMutex().lock();
+		Registry().push_back(this);
+		RegistryMutex().unlock();
+	}
+	virtual ~ObjectPoolBase()
+	{
+		RegistryMutex().lock();
+		std::vector<ObjectPoolBase *> &pools = Registry();
+		pools.erase(std::remove(pools.begin(), pools.end(), this), pools.end());
+		RegistryMutex().unlock();
+	}
+	virtual void GetStat(ObjectPoolStat &stat) = 0;
+
+	static void GetAllStats(std::vector<ObjectPoolStat> &stats)
+	{
+		stats.clear();
+		RegistryMutex().lock();
+		for (ObjectPoolBase *pool : Registry())
+		{
+			stats.push_back(ObjectPoolStat());
+			pool->GetStat(stats.back());
+		}
+		RegistryMutex().unlock();
+	}
+
+protected:
+	const char *m_name = nullptr;
+
+	static std::vector<ObjectPoolBase *> & Registry() { static std::vector<ObjectPoolBase *> pools; return pools; }
+	static std::mutex & RegistryMutex() { static std::mutex mtx; return mtx; }
+};
+
+// fixed size slots carved from chunks and kept on an intrusive freelist, chunks are only released with the pool.
+// Malloc/Free only hand out memory, Acquire/Release additionally keep up to max_cached_num released objects constructed
+template <typename T>
+class ObjectPool : public ObjectPoolBase
+{
+public:
+	ObjectPool(const char *name, bool is_thread_safe, uint32_t max_cached_num = 0)
+		: ObjectPoolBase(name), m_is_thread_safe(is_thread_safe), m_max_cached_num(max_cached_num)
+	{
+		size_t align = alignof(T) > alignof(FreeNode) ? alignof(T) : alignof(FreeNode);
+		assert(align <= MAX_ALIGN);
+		m_slot_size = sizeof(T) > sizeof(FreeNode) ? sizeof(T) : sizeof(FreeNode);
+		m_slot_size = (m_slot_size + align - 1) / align * align;
+		m_slot_num_per_chunk = (uint32_t)(CHUNK_BYTES / m_slot_size);
+		if (m_slot_num_per_chunk < MIN_SLOT_NUM_PER_CHUNK)
+			m_slot_num_per_chunk = MIN_SLOT_NUM_PER_CHUNK;
+	}
+
+	virtual ~ObjectPool()
+	{
+		for (T *obj : m_cached_objs)
+			obj->~T();
+		m_cached_objs.clear();
+		for (void *chunk : m_chunks)
+			free(chunk);
+		m_chunks.clear();
+		m_free_nodes = nullptr;
+	}
+
+	void * Malloc(size_t size)
+	{
+		if (size != sizeof(T))
+		{
+			this->Lock();
+			++m_fallback_num;
+			this->Unlock();
+			return MemoryUtil::Malloc(size);
+		}
+
+		void *ret_ptr = nullptr;
+		this->Lock();
+		if (nullptr != m_free_nodes || this->NewChunk())
+		{
+			ret_ptr = m_free_nodes;
+			m_free_nodes = m_free_nodes->next;
+			if (++m_live_num > m_peak_live_num)
+				m_peak_live_num = m_live_num;
+		}
+		this->Unlock();
+		return ret_ptr;
+	}
+
+	void Free(void *ptr, size_t size)
+	{
+		if (nullptr == ptr)
+			return;
+		if (size != sizeof(T))
+		{
+			MemoryUtil::Free(ptr);
+			return;
+		}
+
+		FreeNode *node = (FreeNode *)ptr;
+		this->Lock();
+		node->next = m_free_nodes;
+		m_free_nodes = node;
+		--m_live_num;
+		this->Unlock();
+	}
+
+	T * Acquire()
+	{
+		T *obj = nullptr;
+		this->Lock();
+		if (!m_cached_objs.empty())
+		{
+			obj = m_cached_objs.back();
+			m_cached_objs.pop_back();
+			if (++m_live_num > m_peak_live_num)
+				m_peak_live_num = m_live_num;
+		}
+		this->Unlock();
+		if (nullptr != obj)
+			return obj;
+
+		void *mem = this->Malloc(sizeof(T));
+		if (nullptr == mem)
+			return nullptr;
+		return ::new(mem) T();
+	}
+
+	void Release(T *obj)
+	{
+		if (nullptr == obj)
+			return;
+
+		bool is_cached = false;
+		this->Lock();
+		if (m_cached_objs.size() < m_max_cached_num)
+		{
+			m_cached_objs.push_back(obj);
+			--m_live_num;
+			is_cached = true;
+		}
+		this->Unlock();
+		if (!is_cached)
+		{
+			obj->~T();
+			this->Free(obj, sizeof(T));
+		}
+	}
+
+	virtual void GetStat(ObjectPoolStat &stat)
+	{
+		this->Lock();
+		stat.name = m_name;
+		stat.object_size = sizeof(T);
+		stat.live_num = m_live_num;
+		stat.peak_live_num = m_peak_live_num;
+		stat.capacity = (uint64_t)m_chunks.size() * m_slot_num_per_chunk;
+		stat.chunk_num = m_chunks.size();
+		stat.cached_num = m_cached_objs.size();
+		stat.fallback_num = m_fallback_num;
+		this->Unlock();
+	}
+
+	static const uint32_t CHUNK_BYTES = 16 * 1024;
+	static const uint32_t MIN_SLOT_NUM_PER_CHUNK = 8;
+	static const uint32_t MAX_ALIGN = 16; // alignment guaranteed by malloc
+
+private:
+	struct FreeNode
+	{
+		FreeNode *next;
+	};
+
+	bool m_is_thread_safe = false;
+	std::mutex m_mtx;
+	size_t m_slot_size = 0;
+	uint32_t m_slot_num_per_chunk = 0;
+	FreeNode *m_free_nodes = nullptr;
+	std::vector<void *> m_chunks;
+	uint32_t m_max_cached_num = 0;
+	std::vector<T *> m_cached_objs;
+	uint64_t m_live_num = 0;
+	uint64_t m_peak_live_num = 0;
+	uint64_t m_fallback_num = 0;
+
+	void Lock() { if (m_is_thread_safe) m_mtx.lock(); }
+	void Unlock() { if (m_is_thread_safe) m_mtx.unlock(); }
+
+	bool NewChunk()
+	{
+		char *chunk = (char *)malloc(m_slot_size * m_slot_num_per_chunk);
+		if (nullptr == chunk)
+			return false;
+		m_chunks.push_back(chunk);
+		for (uint32_t i = m_slot_num_per_chunk; i > 0; --i)
+		{
+			FreeNode *node = (FreeNode *)(chunk + m_slot_size * (i - 1));
+			node->next = m_free_nodes;
+			m_free_nodes = node;
+		}
+		return true;
+	}
+};
@@ -0,0 +1,208 @@
+#include "SpanChunkAllocator.h"
+#include <assert.h>
+#include <stdlib.h>
+#ifdef WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+SpanChunkAllocator::SpanChunkAllocator(uint32_t span_size, uint32_t chunk_size, bool use_huge_page)
+	: m_span_size(span_size), m_chunk_size(chunk_size), m_use_huge_page(use_huge_page)
+{
+	assert(0 == (span_size & (span_size - 1)));
+	assert(0 == (chunk_size & (chunk_size - 1)));
+	assert(chunk_size >= span_size);
+	m_span_num_per_chunk = m_chunk_size / m_span_size;
+	while (((uint32_t)1 << m_chunk_shift) < m_chunk_size)
+		++m_chunk_shift;
+	uint32_t chunk_idx_bits = ADDRESS_BITS - m_chunk_shift;
+	m_chunk_map_root_bits = chunk_idx_bits < CHUNK_MAP_ROOT_BITS ? chunk_idx_bits : CHUNK_MAP_ROOT_BITS;
+	m_chunk_map_leaf_bits = chunk_idx_bits - m_chunk_map_root_bits;
+	size_t root_num = (size_t)1 << m_chunk_map_root_bits;
+	m_chunk_map = new std::atomic<std::atomic<uint8_t> *>[root_num];
+	for (size_t i = 0; i < root_num; ++i)
+		m_chunk_map[i].store(nullptr, std::memory_order_relaxed);
+}
+
+SpanChunkAllocator::~SpanChunkAllocator()
+{
+	for (auto kv_pair : m_chunks)
+	{
+		this->ChunkFree(kv_pair.second->mem);
+		delete kv_pair.second;
+	}
+	m_chunks.clear();
+	m_free_chunks = nullptr;
+	m_empty_chunk_num = 0;
+	for (size_t i = 0; i < ((size_t)1 << m_chunk_map_root_bits); ++i)
+		free(m_chunk_map[i].load(std::memory_order_relaxed));
+	delete[] m_chunk_map;
+	m_chunk_map = nullptr;
+}
+
+void * SpanChunkAllocator::AllocSpan()
+{
+	void *span = nullptr;
+	m_mtx.lock();
+	Chunk *chunk = m_free_chunks;
+	if (nullptr == chunk)
+		chunk = this->NewChunk();
+	if (nullptr != chunk)
+	{
+		if (nullptr != chunk->free_span)
+		{
+			span = chunk->free_span;
+			chunk->free_span = *(void **)span;
+		}
+		else
+		{
+			span = chunk->mem + (size_t)chunk->carved_span_num * m_span_size;
+			++chunk->carved_span_num;
+		}
+		if (0 == chunk->used_span_num++)
+			--m_empty_chunk_num;
+		if (chunk->used_span_num >= m_span_num_per_chunk)
+			this->UnlinkFreeChunk(chunk);
+	}
+	m_mtx.unlock();
+	return span;
+}
+
+void SpanChunkAllocator::FreeSpan(void *span)
+{
+	m_mtx.lock();
+	auto it = m_chunks.find((uintptr_t)span & ~(uintptr_t)(m_chunk_size - 1));
+	assert(m_chunks.end() != it);
+	Chunk *chunk = it->second;
+	if (chunk->used_span_num >= m_span_num_per_chunk)
+		this->LinkFreeChunk(chunk);
+	*(void **)span = chunk->free_span;
+	chunk->free_span = span;
+	if (0 == --chunk->used_span_num)
+	{
+		++m_empty_chunk_num;
+		if (m_empty_chunk_num > KEEP_EMPTY_CHUNK_NUM)
+			this->ReleaseChunk(chunk);
+	}
+	m_mtx.unlock();
+}
+
+uint32_t SpanChunkAllocator::ChunkNum()
+{
+	m_mtx.lock();
+	uint32_t ret = (uint32_t)m_chunks.size();
+	m_mtx.unlock();
+	return ret;
+}
+
+uint32_t SpanChunkAllocator::EmptyChunkNum()
+{
+	m_mtx.lock();
+	uint32_t ret = m_empty_chunk_num;
+	m_mtx.unlock();
+	return ret;
+}
+
+SpanChunkAllocator::Chunk * SpanChunkAllocator::NewChunk()
+{
+	char *mem = (char *)this->ChunkMalloc();
+	if (nullptr == mem)
+		return nullptr;
+	if (((uint64_t)(uintptr_t)mem >> m_chunk_shift) >> (m_chunk_map_root_bits + m_chunk_map_leaf_bits) > 0)
+	{
+		// beyond the chunk map, IsChunkMemory could not find it
+		this->ChunkFree(mem);
+		return nullptr;
+	}
+
+	Chunk *chunk = new Chunk();
+	chunk->mem = mem;
+	m_chunks[(uintptr_t)mem] = chunk;
+	this->SetChunkMap(mem, 1);
+	++m_empty_chunk_num;
+	this->LinkFreeChunk(chunk);
+	return chunk;
+}
+
+void SpanChunkAllocator::ReleaseChunk(Chunk *chunk)
+{
+	assert(0 == chunk->used_span_num);
+	this->UnlinkFreeChunk(chunk);
+	m_chunks.erase((uintptr_t)chunk->mem);
+	this->SetChunkMap(chunk->mem, 0);
+	--m_empty_chunk_num;
+	this->ChunkFree(chunk->mem);
+	delete chunk;
+}
+
+void SpanChunkAllocator::SetChunkMap(void *mem, uint8_t val)
+{
+	// caller holds m_mtx, readers see a leaf only after it is zeroed
+	uint64_t chunk_idx = (uint64_t)(uintptr_t)mem >> m_chunk_shift;
+	std::atomic<std::atomic<uint8_t> *> &root = m_chunk_map[chunk_idx >> m_chunk_map_leaf_bits];
+	std::atomic<uint8_t> *leaf = root.load(std::memory_order_relaxed);
+	if (nullptr == leaf)
+	{
+		// calloced pages are zero filled by the os on first touch, so a sparse leaf costs little
+		leaf = (std::atomic<uint8_t> *)calloc((size_t)1 << m_chunk_map_leaf_bits, sizeof(std::atomic<uint8_t>));
+		assert(nullptr != leaf);
+		root.store(leaf, std::memory_order_release);
+	}
+	leaf[chunk_idx & (((uint64_t)1 << m_chunk_map_leaf_bits) - 1)].store(val, std::memory_order_release);
+}
+
+void SpanChunkAllocator::LinkFreeChunk(Chunk *chunk)
+{
+	chunk->prev_free_chunk = nullptr;
+	chunk->next_free_chunk = m_free_chunks;
+	if (nullptr != m_free_chunks)
+		m_free_chunks->prev_free_chunk = chunk;
+	m_free_chunks = chunk;
+}
+
+void SpanChunkAllocator::UnlinkFreeChunk(Chunk *chunk)
+{
+	if (nullptr != chunk->prev_free_chunk)
+		chunk->prev_free_chunk->next_free_chunk = chunk->next_free_chunk;
+	else
+		m_free_chunks = chunk->next_free_chunk;
+	if (nullptr != chunk->next_free_chunk)
+		chunk->next_free_chunk->prev_free_chunk = chunk->prev_free_chunk;
+	chunk->prev_free_chunk = nullptr;
+	chunk->next_free_chunk = nullptr;
+}
+
+void * SpanChunkAllocator::ChunkMalloc()
+{
+#ifdef WIN32
+	return _aligned_malloc(m_chunk_size, m_chunk_size);
+#else
+	// map twice the size and cut off the misaligned head and the tail
+	size_t map_size = (size_t)m_chunk_size * 2;
+	void *map_mem = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (MAP_FAILED == map_mem)
+		return nullptr;
+	uintptr_t map_begin = (uintptr_t)map_mem;
+	uintptr_t mem_begin = (map_begin + m_chunk_size - 1) & ~(uintptr_t)(m_chunk_size - 1);
+	uintptr_t mem_end = mem_begin + m_chunk_size;
+	if (mem_begin > map_begin)
+		munmap((void *)map_begin, mem_begin - map_begin);
+	if (map_begin + map_size > mem_end)
+		munmap((void *)mem_end, map_begin + map_size - mem_end);
+#ifdef MADV_HUGEPAGE
+	if (m_use_huge_page)
+		madvise((void *)mem_begin, m_chunk_size, MADV_HUGEPAGE);
+#endif
+	return (void *)mem_begin;
+#endif
+}
+
+void SpanChunkAllocator::ChunkFree(void *mem)
+{
+#ifdef WIN32
+	_aligned_free(mem);
+#else
+	munmap(mem, m_chunk_size);
+#endif
+}
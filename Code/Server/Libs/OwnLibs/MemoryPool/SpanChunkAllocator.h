@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+
+// hands out span_size spans carved from chunk_size chunks which are aligned to chunk_size,
+// so the block sets of all pools share few big mappings instead of one libc call each.
+// a chunk is returned to the os only when it is empty and more than KEEP_EMPTY_CHUNK_NUM chunks are empty
+class SpanChunkAllocator
+{
+public:
+	SpanChunkAllocator(uint32_t span_size, uint32_t chunk_size, bool use_huge_page);
+	~SpanChunkAllocator();
+
+	void * AllocSpan();
+	void FreeSpan(void *span);
+	uint32_t ChunkNum();
+	uint32_t EmptyChunkNum();
+	// true if ptr is inside a live chunk. takes no lock, so Free can tell span blocks from other memory by address
+	bool IsChunkMemory(void *ptr)
+	{
+		uint64_t chunk_idx = (uint64_t)(uintptr_t)ptr >> m_chunk_shift;
+		if (chunk_idx >> (m_chunk_map_root_bits + m_chunk_map_leaf_bits) > 0)
+			return false;
+		std::atomic<uint8_t> *leaf = m_chunk_map[chunk_idx >> m_chunk_map_leaf_bits].load(std::memory_order_acquire);
+		return nullptr != leaf && 0 != leaf[chunk_idx & (((uint64_t)1 << m_chunk_map_leaf_bits) - 1)].load(std::memory_order_relaxed);
+	}
+
+	const static uint32_t KEEP_EMPTY_CHUNK_NUM = 1;
+	const static uint32_t ADDRESS_BITS = 48; // user space addresses of x64 and arm64
+	const static uint32_t CHUNK_MAP_ROOT_BITS = 12;
+
+private:
+	struct Chunk
+	{
+		char *mem = nullptr;
+		uint32_t used_span_num = 0;
+		uint32_t carved_span_num = 0; // spans beyond it were never touched
+		void *free_span = nullptr; // intrusive list of spans freed back to the chunk
+		Chunk *prev_free_chunk = nullptr;
+		Chunk *next_free_chunk = nullptr;
+	};
+
+	uint32_t m_span_size = 0;
+	uint32_t m_chunk_size = 0;
+	uint32_t m_span_num_per_chunk = 0;
+	bool m_use_huge_page = false;
+	std::mutex m_mtx;
+	std::unordered_map<uintptr_t, Chunk *> m_chunks;
+	Chunk *m_free_chunks = nullptr; // chunks which still have free spans
+	uint32_t m_empty_chunk_num = 0;
+	// chunk index (address >> m_chunk_shift) -> 1 if the chunk is live. two levels, a leaf is calloced when a chunk first falls in it
+	uint32_t m_chunk_shift = 0;
+	uint32_t m_chunk_map_root_bits = 0;
+	uint32_t m_chunk_map_leaf_bits = 0;
+	std::atomic<std::atomic<uint8_t> *> *m_chunk_map = nullptr;
+
+	Chunk * NewChunk();
+	void ReleaseChunk(Chunk *chunk);
+	void SetChunkMap(void *mem, uint8_t val);
+	void LinkFreeChunk(Chunk *chunk);
+	void UnlinkFreeChunk(Chunk *chunk);
+	void * ChunkMalloc();
+	void ChunkFree(void *mem);
+};
@@ -0,0 +1,137 @@
+#include "FastLZ.h"
+#include <string.h>
+
+namespace FastLZ
+{
+	static const uint32_t MAX_COPY = 32;
+	static const uint32_t MIN_MATCH = 3;
+	static const uint32_t MAX_MATCH = 264;
+	static const uint32_t MAX_DISTANCE = 8192;
+	static const int HASH_LOG = 13;
+	static const uint32_t HASH_SIZE = 1 << HASH_LOG;
+
+	static inline uint32_t Read24(const uint8_t *p)
+	{
+		return p[0] | (p[1] << 8) | (p[2] << 16);
+	}
+
+	static inline uint32_t Hash(uint32_t seq)
+	{
+		return (seq * 2654435769u) >> (32 - HASH_LOG);
+	}
+
+	// ctrl 000LLLLL, then L + 1 literals
+	static uint8_t * EmitLiterals(const uint8_t *src, uint32_t len, uint8_t *op)
+	{
+		while (len > 0)
+		{
+			uint32_t run = len < MAX_COPY ? len : MAX_COPY;
+			*op++ = (uint8_t)(run - 1);
+			memcpy(op, src, run);
+			op += run;
+			src += run;
+			len -= run;
+		}
+		return op;
+	}
+
+	// ctrl LLLDDDDD with L = len - 2, L of 7 takes one more byte for len - 9, then the low byte of distance - 1
+	static uint8_t * EmitMatch(uint32_t len, uint32_t distance, uint8_t *op)
+	{
+		uint32_t ofs = distance - 1;
+		if (len - 2 < 7)
+		{
+			*op++ = (uint8_t)(((len - 2) << 5) + (ofs >> 8));
+		}
+		else
+		{
+			*op++ = (uint8_t)((7 << 5) + (ofs >> 8));
+			*op++ = (uint8_t)(len - 9);
+		}
+		*op++ = (uint8_t)(ofs & 255);
+		return op;
+	}
+
+	uint32_t MaxCompressedLen(uint32_t len)
+	{
+		return len + len / MAX_COPY + 1;
+	}
+
+	uint32_t Compress(const void *in, uint32_t len, void *out)
+	{
+		const uint8_t *ip_begin = (const uint8_t *)in;
+		const uint8_t *ip_end = ip_begin + len;
+		const uint8_t *ip = ip_begin;
+		const uint8_t *anchor = ip_begin;
+		uint8_t *op = (uint8_t *)out;
+
+		// positions by the hash of their first 3 bytes, a stale or colliding one fails the compare
+		uint32_t htab[HASH_SIZE];
+		memset(htab, 0, sizeof(htab));
+		while (ip + MIN_MATCH <= ip_end)
+		{
+			uint32_t seq = Read24(ip);
+			uint32_t *slot = &htab[Hash(seq)];
+			const uint8_t *ref = ip_begin + *slot;
+			*slot = (uint32_t)(ip - ip_begin);
+			uint32_t distance = (uint32_t)(ip - ref);
+			if (0 == distance || distance > MAX_DISTANCE || Read24(ref) != seq)
+			{
+				++ip;
+				continue;
+			}
+			uint32_t match_max = (uint32_t)(ip_end - ip) < MAX_MATCH ? (uint32_t)(ip_end - ip) : MAX_MATCH;
+			uint32_t match_len = MIN_MATCH;
+			while (match_len < match_max && ref[match_len] == ip[match_len])
+				++match_len;
+			op = EmitLiterals(anchor, (uint32_t)(ip - anchor), op);
+			op = EmitMatch(match_len, distance, op);
+			ip += match_len;
+			anchor = ip;
+		}
+		op = EmitLiterals(anchor, (uint32_t)(ip_end - anchor), op);
+		return (uint32_t)(op - (uint8_t *)out);
+	}
+
+	uint32_t Decompress(const void *in, uint32_t len, void *out, uint32_t out_cap)
+	{
+		const uint8_t *ip = (const uint8_t *)in;
+		const uint8_t *ip_end = ip + len;
+		uint8_t *op_begin = (uint8_t *)out;
+		uint8_t *op = op_begin;
+		uint8_t *op_end = op_begin + out_cap;
+
+		// the input comes from the network, every length and distance is checked
+		while (ip < ip_end)
+		{
+			uint32_t ctrl = *ip++;
+			if (ctrl < MAX_COPY)
+			{
+				uint32_t run = ctrl + 1;
+				if ((uint32_t)(ip_end - ip) < run || (uint32_t)(op_end - op) < run)
+					return 0;
+				memcpy(op, ip, run);
+				ip += run;
+				op += run;
+				continue;
+			}
+			uint32_t match_len = (ctrl >> 5) + 2;
+			if (7 == (ctrl >> 5))
+			{
+				if (ip >= ip_end)
+					return 0;
+				match_len += *ip++;
+			}
+			if (ip >= ip_end)
+				return 0;
+			uint32_t distance = ((ctrl & 31) << 8) + *ip++ + 1;
+			if (distance > (uint32_t)(op - op_begin) || (uint32_t)(op_end - op) < match_len)
+				return 0;
+			// the match may overlap what it writes, byte by byte repeats the short periods
+			const uint8_t *ref = op - distance;
+			while (match_len-- > 0)
+				*op++ = *ref++;
+		}
+		return (uint32_t)(op - op_begin);
+	}
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+// level 1 of the FastLZ block format: runs of up to 32 literals and matches of 3 to 264 bytes within 8 KB back.
+// no frame and no checksum, the caller keeps the raw length
+namespace FastLZ
+{
+	// the out buffer of Compress must hold this many bytes, incompressible input grows by a byte every 32
+	uint32_t MaxCompressedLen(uint32_t len);
+	// returns the compressed length
+	uint32_t Compress(const void *in, uint32_t len, void *out);
+	// returns the decompressed length, 0 when the input is broken or does not fit in out_cap
+	uint32_t Decompress(const void *in, uint32_t len, void *out, uint32_t out_cap);
+}
@@ -0,0 +1,73 @@
+#include "ThreadUtil.h"
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace ThreadUtil
+{
+	bool SetCurrentThreadName(const std::string &name)
+	{
+		if (name.empty())
+			return false;
+#ifdef WIN32
+		// SetThreadDescription only exists since windows 10 1607, so it is looked up instead of linked
+		using SetThreadDescriptionFunc = HRESULT(WINAPI *)(HANDLE, PCWSTR);
+		HMODULE kernel = GetModuleHandleA("kernel32.dll");
+		SetThreadDescriptionFunc set_desc = nullptr;
+		if (nullptr != kernel)
+			set_desc = (SetThreadDescriptionFunc)GetProcAddress(kernel, "SetThreadDescription");
+		if (nullptr == set_desc)
+			return false;
+		std::wstring wname(name.begin(), name.end());
+		return SUCCEEDED(set_desc(GetCurrentThread(), wname.c_str()));
+#elif defined(__linux__)
+		static const size_t NAME_MAX_LEN = 15;
+		std::string short_name = name.substr(0, NAME_MAX_LEN);
+		return 0 == pthread_setname_np(pthread_self(), short_name.c_str());
+#elif defined(__APPLE__)
+		return 0 == pthread_setname_np(name.c_str());
+#else
+		return false;
+#endif
+	}
+
+	bool SetCurrentThreadAffinity(const std::vector<int> &cpus)
+	{
+		if (cpus.empty())
+			return true;
+#ifdef WIN32
+		DWORD_PTR mask = 0;
+		for (int cpu : cpus)
+		{
+			if (cpu < 0 || cpu >= (int)(sizeof(DWORD_PTR) * 8))
+				return false;
+			mask |= (DWORD_PTR)1 << cpu;
+		}
+		return 0 != SetThreadAffinityMask(GetCurrentThread(), mask);
+#elif defined(__linux__)
+		cpu_set_t cpu_set;
+		CPU_ZERO(&cpu_set);
+		for (int cpu : cpus)
+		{
+			if (cpu < 0 || cpu >= CPU_SETSIZE)
+				return false;
+			CPU_SET(cpu, &cpu_set);
+		}
+		return 0 == pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#else
+		return false;
+#endif
+	}
+
+	std::vector<int> ChoseCpus(const std::vector<int> &cpus, int idx)
+	{
+		std::vector<int> ret;
+		if (!cpus.empty() && idx >= 0)
+			ret.push_back(cpus[idx % cpus.size()]);
+		return ret;
+	}
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace ThreadUtil
+{
+	// shown by debuggers and profilers, linux keeps the first 15 chars
+	bool SetCurrentThreadName(const std::string &name);
+	// the calling thread only runs on these cpus, empty cpus leaves it to the os
+	bool SetCurrentThreadAffinity(const std::vector<int> &cpus);
+	// the idx-th thread of a group sharing cpus runs on cpus[idx % cpus count], on any cpu if cpus is empty
+	std::vector<int> ChoseCpus(const std::vector<int> &cpus, int idx);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+
+// splits the byte stream of a connection into messages on the net worker thread.
+// one framer may be shared by many connections, so it keeps no stream state: every message is a head describing the content length, then the content
+class INetFramer
+{
+public:
+	virtual ~INetFramer() {}
+	virtual uint32_t LenDescriptSize() = 0;
+	// content length described by a head of LenDescriptSize bytes, 0 if the head is malformed or the message too long
+	virtual uint32_t ParseContentLen(char *head) = 0;
+
+	const static uint32_t MAX_LEN_DESCRIPT_SIZE = sizeof(uint64_t);
+};
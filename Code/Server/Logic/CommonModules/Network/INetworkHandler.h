@@ -4,6 +4,8 @@
 #include <memory>
 #include "Common/Macro/MemoryPoolMacro.h"
 
+class INetFramer;
+
 enum ENetworkHandlerType
 {
 	ENetworkHandler_Connect,
@@ -34,6 +36,13 @@ public:
 	INetConnectHander() : INetworkHandler(ENetworkHandler_Connect) {}
 	virtual ~INetConnectHander() {}
 	virtual void OnRecvData(char *data, uint32_t len) = 0;
+	// a handler returning a framer when the connection is added gets whole messages by OnRecvMsg instead of OnRecvData,
+	// the stream is split and checked on the net worker thread
+	virtual std::shared_ptr<INetFramer> GetFramer() { return nullptr; }
+	virtual void OnRecvMsg(char *data, uint32_t len) {}
+	virtual void OnFrameFail() {}
+	// the bytes waiting to be sent went over the high watermark, or back down to the low one, see NetSendWatermarkOpt
+	virtual void OnSendWatermark(bool is_high) {}
 };
 class INetListenHander : public INetworkHandler
 {
@@ -4,6 +4,97 @@
 #include "ModuleDef/IModule.h"
 #include <string>
 #include <functional>
+#include <vector>
+
+// opt of INetworkModule::Listen, nullptr for the defaults
+struct NetListenOpt
+{
+	// one SO_REUSEPORT listener per net worker, the kernel spreads the accepts and every worker sets up its own connections.
+	// the logic thread is only asked for the handler of each new connection. a single listener is opened where SO_REUSEPORT is missing
+	bool is_shard_on_workers = false;
+};
+
+// opt of INetworkModule::Connect and ConnectAsync, nullptr for the defaults. both copy it, it may be gone once they return
+struct NetConnectOpt
+{
+	uint32_t timeout_ms = 3000; // the connect fails with a timeout errno after this, 0 waits as long as the os does
+};
+
+// the rings between one net worker and the logic thread
+struct NetQueueStat
+{
+	uint32_t event_depth = 0; // worker -> logic, reads, accepts and closes not handled by the logic thread yet
+	uint32_t event_peak_depth = 0;
+	uint32_t event_capacity = 0;
+	uint64_t event_full_num = 0; // events held back in the worker because the ring was full
+	uint32_t send_depth = 0; // logic -> worker, send buffers not written to their connections yet
+	uint32_t send_peak_depth = 0;
+	uint32_t send_capacity = 0;
+	uint64_t send_full_num = 0; // send buffers kept for the next tick because the ring was full
+};
+
+// bytes sent to connections but not taken by their sockets yet, piling up when a client reads slower than it is sent to.
+// a limit of 0 is off
+struct NetSendWatermarkOpt
+{
+	// per connection. going over high calls OnSendWatermark(true) of its handler, draining to low calls OnSendWatermark(false)
+	uint32_t cnn_high_bytes = 0;
+	uint32_t cnn_low_bytes = 0;
+	uint32_t cnn_close_bytes = 0; // the connection is closed, its handler gets OnClose(CLOSE_ERR_NUM)
+	// all connections together, the crossings call on_global_watermark on the logic thread
+	uint64_t global_high_bytes = 0;
+	uint64_t global_low_bytes = 0;
+	std::function<void(bool is_high, uint64_t send_bytes)> on_global_watermark;
+
+	const static int CLOSE_ERR_NUM = -2;
+};
+
+struct NetSendStat
+{
+	uint64_t send_bytes = 0; // held for all connections now
+	uint64_t cnn_high_num = 0;
+	uint64_t cnn_low_num = 0;
+	uint64_t cnn_close_num = 0;
+	uint64_t global_high_num = 0;
+	uint64_t global_low_num = 0;
+};
+
+// the counters of one connection since it was set up. the bytes and reads are counted by its net worker,
+// the round trip times come from AddRttSample
+struct NetCnnStat
+{
+	NetId netid = 0;
+	int worker_idx = 0;
+	uint64_t recv_bytes = 0;
+	uint64_t recv_msg_num = 0; // whole messages split by the framer, none on a connection without one
+	uint64_t read_num = 0; // read callbacks, each hands over what the socket had
+	uint64_t send_bytes = 0; // taken by the socket
+	uint64_t send_msg_num = 0; // Send, CommitSend and CommitMulticast for it
+	uint32_t send_queue_bytes = 0; // written to the connection but not taken by the socket yet
+	uint32_t send_queue_peak_bytes = 0;
+	uint32_t idle_ms = 0; // since the last read or the last bytes taken by the socket
+	uint32_t rtt_us = 0; // the last sample, 0 before the first
+	uint32_t rtt_avg_us = 0; // moves 1/8 towards every sample, like the srtt of tcp
+	uint32_t rtt_max_us = 0;
+	uint32_t rtt_sample_num = 0;
+};
+
+// the counters of one net worker. the totals keep the closed connections, the rest are over its connections now
+struct NetWorkerStat
+{
+	int worker_idx = 0;
+	uint32_t cnn_num = 0;
+	uint64_t recv_bytes = 0;
+	uint64_t recv_msg_num = 0;
+	uint64_t read_num = 0;
+	uint64_t send_bytes = 0;
+	uint64_t send_msg_num = 0;
+	uint64_t send_queue_bytes = 0;
+	uint32_t send_queue_peak_bytes = 0; // the biggest peak of one connection
+	uint32_t rtt_avg_us = 0; // mean of the rtt_avg_us of the connections with a sample
+	uint32_t rtt_max_us = 0;
+	NetId rtt_max_netid = 0;
+};
 
 class INetworkModule : public IModule
 {
@@ -24,6 +115,25 @@ public:
 	virtual int64_t ListenAsync(std::string ip, uint16_t port, void *opt, std::weak_ptr<INetListenHander> handler) = 0;
 	virtual int64_t ConnectAsync(std::string ip, uint16_t port, void *opt, std::weak_ptr<INetConnectHander> handler) = 0;
 	virtual void CancelAsync(uint64_t async_id) = 0;
+	// sends are gathered in a buffer per connection during the tick, nothing leaves before FlushSends.
+	// ReserveSend gives len writable bytes at the end of that buffer, they are sent once CommitSend is called with the used length
 	virtual bool Send(NetId netId, char *buffer, uint32_t len) = 0;
+	virtual char * ReserveSend(NetId netid, uint32_t len) = 0;
+	virtual bool CommitSend(NetId netid, uint32_t len) = 0;
+	// ReserveMulticast gives len writable bytes of a shared buffer, CommitMulticast appends it to the tick buffer of every netid,
+	// so the content is built once however many connections receive it. big content is appended by reference instead of copied
+	virtual char * ReserveMulticast(uint32_t len) = 0;
+	virtual bool CommitMulticast(NetId *netids, uint32_t netid_num, uint32_t len) = 0;
+	// hands the buffers of the tick to the net workers, called once at the end of every tick
+	virtual void FlushSends() = 0;
+	virtual void GetQueueStats(std::vector<NetQueueStat> &stats) = 0;
+	virtual void SetSendWatermark(const NetSendWatermarkOpt &opt) = 0;
+	virtual void GetSendStat(NetSendStat &stat) = 0;
+	// for diagnostics rather than every tick, the connection tables of the workers are locked while they are read
+	virtual bool GetCnnStat(NetId netid, NetCnnStat &stat) = 0;
+	virtual void GetCnnStats(std::vector<NetCnnStat> &stats) = 0;
+	virtual void GetWorkerStats(std::vector<NetWorkerStat> &stats) = 0;
+	// a round trip of the connection timed above the module, see NetworkAgent::SendPing
+	virtual void AddRttSample(NetId netid, uint32_t rtt_us) = 0;
 };
 
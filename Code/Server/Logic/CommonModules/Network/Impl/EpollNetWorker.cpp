@@ -0,0 +1,339 @@
+#include "EpollNetWorker.h"
+
+#ifdef __linux__
+
+#include "event2/event.h"
+#include "event2/buffer.h"
+#include "Common/Utils/MemoryUtil.h"
+#include "Utils/ThreadUtil.h"
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+
+namespace Net
+{
+	NewDelOperaImplement(EpollNetWorker);
+	NewDelOperaImplement(EpollNetWorker::EpollCnnData);
+
+	EpollNetWorker::EpollNetWorker(int worker_idx, int worker_num) : NetWorkerBase(worker_idx, worker_num)
+	{
+	}
+
+	EpollNetWorker::~EpollNetWorker()
+	{
+		if (m_epoll_fd >= 0)
+		{
+			close(m_epoll_fd);
+			m_epoll_fd = -1;
+		}
+	}
+
+	bool EpollNetWorker::Start()
+	{
+		if (m_is_done)
+			return false;
+		if (m_is_runing)
+			return true;
+		if (m_epoll_fd < 0)
+			m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if (m_epoll_fd < 0)
+			return false;
+		if (!NetWorkerBase::Start())
+		{
+			close(m_epoll_fd);
+			m_epoll_fd = -1;
+			return false;
+		}
+		return true;
+	}
+
+	EpollNetWorker::EpollCnnData::~EpollCnnData()
+	{
+		if (nullptr != input)
+		{
+			evbuffer_free(input);
+			input = nullptr;
+		}
+		if (nullptr != output)
+		{
+			evbuffer_free(output);
+			output = nullptr;
+		}
+	}
+
+	NetWorkerBase::NetConnectionData * EpollNetWorker::NewCnnData(NetId netid, int fd, std::weak_ptr<INetworkHandler> handler)
+	{
+		return new EpollCnnData(this, netid, fd, handler);
+	}
+
+	bool EpollNetWorker::OpenCnn(NetConnectionData *cnn_data, bool is_read)
+	{
+		EpollCnnData *ep_cnn_data = (EpollCnnData *)cnn_data;
+		epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.data.ptr = cnn_data;
+		if (ENetworkHandler_Connect == cnn_data->handler_type)
+		{
+			ep_cnn_data->input = evbuffer_new();
+			ep_cnn_data->output = evbuffer_new();
+			if (nullptr == ep_cnn_data->input || nullptr == ep_cnn_data->output)
+				return false;
+			ep_cnn_data->is_read_enable = is_read;
+			// registered once for both directions, an edge only wakes the loop when the state changes
+			ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+		}
+		else if (ENetworkHandler_Listen == cnn_data->handler_type)
+		{
+			ev.events = EPOLLIN | EPOLLET;
+		}
+		else
+		{
+			return true;
+		}
+		return 0 == epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, cnn_data->fd, &ev);
+	}
+
+	void EpollNetWorker::CloseCnn(NetConnectionData *cnn_data)
+	{
+		// closing the fd also takes it out of the epoll
+		if (cnn_data->fd >= 0)
+			close(cnn_data->fd);
+		delete (EpollCnnData *)cnn_data;
+	}
+
+	void EpollNetWorker::EnableRead(NetConnectionData *cnn_data, bool is_enable)
+	{
+		EpollCnnData *ep_cnn_data = (EpollCnnData *)cnn_data;
+		if (ENetworkHandler_Connect != cnn_data->handler_type || ep_cnn_data->is_read_enable == is_enable)
+			return;
+		ep_cnn_data->is_read_enable = is_enable;
+		// the edge may have come while reading was off, the bytes already there are read now
+		if (is_enable && !cnn_data->is_expired && !ep_cnn_data->is_read_again)
+			this->ReadCnn(ep_cnn_data);
+	}
+
+	void EpollNetWorker::WriteCnn(NetConnectionData *cnn_data, evbuffer *buffer)
+	{
+		EpollCnnData *ep_cnn_data = (EpollCnnData *)cnn_data;
+		evbuffer_add_buffer(ep_cnn_data->output, buffer);
+		if (!ep_cnn_data->is_write_block)
+			this->FlushOutput(ep_cnn_data);
+	}
+
+	void EpollNetWorker::ReadCnn(EpollCnnData *cnn_data)
+	{
+		cnn_data->is_read_again = false;
+		int read_bytes = 0;
+		int err_num = 1; // stays 1 while the connection is fine
+		while (true)
+		{
+			if (read_bytes >= MAX_READ_BYTES)
+			{
+				cnn_data->is_read_again = true;
+				m_read_again_netids.push_back(cnn_data->netid);
+				break;
+			}
+			evbuffer_iovec vecs[2];
+			int vec_num = evbuffer_reserve_space(cnn_data->input, READ_RESERVE_BYTES, vecs, 2);
+			if (vec_num <= 0)
+				break;
+			iovec iovs[2];
+			size_t reserve_len = 0;
+			for (int i = 0; i < vec_num; ++i)
+			{
+				iovs[i].iov_base = vecs[i].iov_base;
+				iovs[i].iov_len = vecs[i].iov_len;
+				reserve_len += vecs[i].iov_len;
+			}
+			ssize_t ret = readv(cnn_data->fd, iovs, vec_num);
+			if (ret > 0)
+			{
+				size_t left_len = (size_t)ret;
+				int used_num = 0;
+				for (; used_num < vec_num && left_len > 0; ++used_num)
+				{
+					if (vecs[used_num].iov_len > left_len)
+						vecs[used_num].iov_len = left_len;
+					left_len -= vecs[used_num].iov_len;
+				}
+				evbuffer_commit_space(cnn_data->input, vecs, used_num);
+				read_bytes += (int)ret;
+				// the socket was drained, bytes coming later raise a new edge
+				if ((size_t)ret < reserve_len)
+					break;
+				continue;
+			}
+			if (0 == ret)
+			{
+				err_num = 0;
+				break;
+			}
+			if (EINTR == errno)
+				continue;
+			if (EAGAIN != errno && EWOULDBLOCK != errno)
+				err_num = -1;
+			break;
+		}
+		if (evbuffer_get_length(cnn_data->input) > 0)
+			this->OnCnnRead(cnn_data, cnn_data->input);
+		if (err_num <= 0)
+			this->ExpireCnn(cnn_data, err_num);
+	}
+
+	void EpollNetWorker::FlushOutput(EpollCnnData *cnn_data)
+	{
+		while (!cnn_data->is_expired && evbuffer_get_length(cnn_data->output) > 0)
+		{
+			evbuffer_iovec vecs[MAX_WRITE_IOVECS];
+			int vec_num = evbuffer_peek(cnn_data->output, -1, nullptr, vecs, MAX_WRITE_IOVECS);
+			if (vec_num > MAX_WRITE_IOVECS)
+				vec_num = MAX_WRITE_IOVECS;
+			iovec iovs[MAX_WRITE_IOVECS];
+			size_t peek_len = 0;
+			for (int i = 0; i < vec_num; ++i)
+			{
+				iovs[i].iov_base = vecs[i].iov_base;
+				iovs[i].iov_len = vecs[i].iov_len;
+				peek_len += vecs[i].iov_len;
+			}
+			msghdr msg;
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_iov = iovs;
+			msg.msg_iovlen = vec_num;
+			ssize_t ret = sendmsg(cnn_data->fd, &msg, MSG_NOSIGNAL);
+			if (ret > 0)
+			{
+				// drained before anything else, the watermarks see the bytes leave
+				evbuffer_drain(cnn_data->output, (size_t)ret);
+				if ((size_t)ret < peek_len)
+				{
+					cnn_data->is_write_block = true;
+					break;
+				}
+				continue;
+			}
+			if (ret < 0 && EINTR == errno)
+				continue;
+			if (ret < 0 && (EAGAIN == errno || EWOULDBLOCK == errno))
+				cnn_data->is_write_block = true;
+			else
+				this->ExpireCnn(cnn_data, -1);
+			break;
+		}
+	}
+
+	void EpollNetWorker::AcceptCnns(EpollCnnData *listen_cnn_data)
+	{
+		while (!listen_cnn_data->is_expired)
+		{
+			int fd = accept4(listen_cnn_data->fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if (fd >= 0)
+			{
+				this->OnAccept(listen_cnn_data, fd);
+				continue;
+			}
+			if (EINTR == errno || ECONNABORTED == errno)
+				continue;
+			// out of fds or memory the backlog waits for the next connection to raise an edge
+			if (EAGAIN != errno && EWOULDBLOCK != errno && EMFILE != errno && ENFILE != errno && ENOBUFS != errno && ENOMEM != errno)
+				this->ExpireCnn(listen_cnn_data, 0);
+			break;
+		}
+	}
+
+	void EpollNetWorker::HandleEvent(const epoll_event &ev)
+	{
+		EpollCnnData *cnn_data = (EpollCnnData *)ev.data.ptr;
+		if (nullptr == cnn_data)
+		{
+			this->DrainWakeup();
+			return;
+		}
+		if (cnn_data->is_expired)
+			return;
+		if (ENetworkHandler_Listen == cnn_data->handler_type)
+		{
+			this->AcceptCnns(cnn_data);
+			return;
+		}
+
+		// what came before a hang up or an error is read first
+		if (ev.events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+		{
+			if (cnn_data->is_read_enable)
+			{
+				if (!cnn_data->is_read_again)
+					this->ReadCnn(cnn_data);
+			}
+			else if (ev.events & (EPOLLHUP | EPOLLERR))
+			{
+				this->ExpireCnn(cnn_data, (ev.events & EPOLLERR) ? -1 : 0);
+			}
+		}
+		if ((ev.events & EPOLLOUT) && !cnn_data->is_expired)
+		{
+			cnn_data->is_write_block = false;
+			this->FlushOutput(cnn_data);
+		}
+	}
+
+	void EpollNetWorker::Loop()
+	{
+		ThreadUtil::SetCurrentThreadName(m_thread_name);
+		ThreadUtil::SetCurrentThreadAffinity(m_thread_cpus);
+		event_set_mem_functions(Malloc, Realloc, Free);
+
+		epoll_event wakeup_ev;
+		memset(&wakeup_ev, 0, sizeof(wakeup_ev));
+		wakeup_ev.events = EPOLLIN;
+		wakeup_ev.data.ptr = nullptr;
+		if (0 != epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_wakeup_fds[0], &wakeup_ev))
+			m_is_runing = false;
+		std::vector<epoll_event> events(MAX_EPOLL_EVENTS);
+		while (m_is_runing)
+		{
+			this->CheckRemoveCnnDatas();
+			// connections first, so the first sends to a new connection find it
+			this->CheckAddCnnDatas();
+			this->CheckBindCnnDatas();
+			this->CheckSendDatas();
+
+			// the connections cut short last round are read after the ready ones, without waiting
+			m_read_again_swap_netids.swap(m_read_again_netids);
+			int timeout_ms = -1;
+			if (!m_read_again_swap_netids.empty())
+				timeout_ms = 0;
+			else if (!m_overflow_datas.empty())
+				timeout_ms = OVERFLOW_RETRY_MS;
+			int event_num = epoll_wait(m_epoll_fd, events.data(), MAX_EPOLL_EVENTS, timeout_ms);
+			for (int i = 0; i < event_num; ++i)
+				this->HandleEvent(events[i]);
+			for (NetId netid : m_read_again_swap_netids)
+			{
+				auto it = m_cnn_datas.find(netid);
+				if (m_cnn_datas.end() == it)
+					continue;
+				EpollCnnData *cnn_data = (EpollCnnData *)it->second;
+				if (!cnn_data->is_read_again)
+					continue;
+				cnn_data->is_read_again = false;
+				if (cnn_data->is_read_enable && !cnn_data->is_expired)
+					this->ReadCnn(cnn_data);
+			}
+			m_read_again_swap_netids.clear();
+			this->FlushFrameBatches();
+			this->FlushOverflowDatas();
+
+			this->CheckRemoveCnnDatas();
+		}
+		this->RemoveAllCnnDatas();
+		m_read_again_netids.clear();
+		close(m_epoll_fd);
+		m_epoll_fd = -1;
+	}
+}
+
+#endif
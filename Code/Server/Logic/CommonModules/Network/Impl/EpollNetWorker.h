@@ -0,0 +1,57 @@
+#pragma once
+
+#ifdef __linux__
+
+#include "NetWorkerBase.h"
+
+struct epoll_event;
+
+namespace Net
+{
+	// the sockets are watched by an edge triggered epoll and read and written by the loop itself, into evbuffers
+	// as libevent would. every ready socket is served until it would block, at most MAX_READ_BYTES a round
+	class EpollNetWorker : public NetWorkerBase
+	{
+		NewDelOperaDeclaration;
+	public:
+		EpollNetWorker(int worker_idx, int worker_num);
+		virtual ~EpollNetWorker();
+		// the epoll is created here, so a kernel refusing it fails Start and not the loop
+		virtual bool Start();
+
+	protected:
+		virtual void Loop();
+		struct EpollCnnData : public NetConnectionData
+		{
+			NewDelOperaDeclaration;
+			EpollCnnData(EpollNetWorker *_networker, NetId _netid, int _fd, std::weak_ptr<INetworkHandler> _handler)
+				: NetConnectionData(_networker, _netid, _fd, _handler) {}
+			virtual ~EpollCnnData();
+			evbuffer *input = nullptr;
+			bool is_read_enable = false;
+			bool is_read_again = false; // still readable when its round ended, in m_read_again_cnns
+			bool is_write_block = false; // the socket buffer is full, writing waits for EPOLLOUT
+		};
+		virtual NetConnectionData * NewCnnData(NetId netid, int fd, std::weak_ptr<INetworkHandler> handler);
+		virtual bool OpenCnn(NetConnectionData *cnn_data, bool is_read);
+		virtual void CloseCnn(NetConnectionData *cnn_data);
+		virtual void EnableRead(NetConnectionData *cnn_data, bool is_enable);
+		virtual void WriteCnn(NetConnectionData *cnn_data, evbuffer *buffer);
+
+		void ReadCnn(EpollCnnData *cnn_data);
+		void FlushOutput(EpollCnnData *cnn_data);
+		void AcceptCnns(EpollCnnData *listen_cnn_data);
+		void HandleEvent(const epoll_event &ev);
+		// connections which had more to read than MAX_READ_BYTES, read on first in the next round
+		std::vector<NetId> m_read_again_netids;
+		std::vector<NetId> m_read_again_swap_netids;
+
+		int m_epoll_fd = -1;
+		static const int MAX_EPOLL_EVENTS = 1024;
+		static const int READ_RESERVE_BYTES = 16384;
+		static const int MAX_READ_BYTES = 262144;
+		static const int MAX_WRITE_IOVECS = 64;
+	};
+}
+
+#endif
@@ -9,9 +9,30 @@ namespace Net
 		INetWorker() {}
 		virtual ~INetWorker() {}
 		virtual bool AddCnn(NetId id, int fd, std::weak_ptr<INetworkHandler> handler) = 0;
+		// connections accepted by this listener are set up on this worker, see ENetWorkDataAction_Accept
+		virtual bool AddListenShard(NetId id, int fd, std::weak_ptr<INetListenHander> handler) = 0;
+		virtual void BindCnn(NetId id, std::weak_ptr<INetConnectHander> handler) = 0;
+		// unique over all workers, and ChoseWorker of the netid is this worker. thread safe
+		virtual NetId GenNetId() = 0;
 		virtual void RemoveCnn(NetId id) = 0;
-		virtual bool Send(NetId netId, char *buffer, uint32_t len) = 0;
-		virtual bool GetNetDatas(std::queue<NetWorkData, std::deque<NetWorkData, StlAllocator<NetWorkData>>> *&out_datas) = 0;
+		// logic thread only. takes over the leading buffers until its ring is full and returns how many it took,
+		// the rest stay with the caller. every taken buffer is written to its connection and freed by the worker
+		virtual uint32_t SendBuffers(NetSendBuffer *send_bufs, uint32_t buf_num) = 0;
+		// logic thread only
+		virtual bool PopNetData(NetWorkData &out_data) = 0;
+		virtual uint32_t NetDataNum() = 0;
+		virtual void GetQueueStat(NetQueueStat &stat) = 0;
+		// only the per connection limits of opt are used, they apply from the next change of each connection's output
+		virtual void SetSendWatermark(const NetSendWatermarkOpt &opt) = 0;
+		// bytes held in the outputs of the connections of this worker, thread safe
+		virtual uint64_t SendBytes() = 0;
+		// adds the numbers of this worker to stat
+		virtual void AddSendStat(NetSendStat &stat) = 0;
+		// the counters kept by this worker, the rtt fields are left to the caller. thread safe
+		virtual bool GetCnnStat(NetId netid, NetCnnStat &stat) = 0;
+		// appends one stat for each connection of this worker
+		virtual void GetCnnStats(std::vector<NetCnnStat> &stats) = 0;
+		virtual void GetWorkerStat(NetWorkerStat &stat) = 0;
 		virtual bool Start() = 0;
 		virtual void Stop() = 0;
 	};
@@ -1,11 +1,23 @@
 #include "NetConnectTask.h"
 #include "Common/Utils/MemoryUtil.h"
+#include "CommonModules/Network/INetworkModule.h"
+#ifndef WIN32
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+#endif
 
 namespace Net
 {
 	NewDelOperaImplement(ConnectTask);
-	NewDelOperaImplement(ConnectTaskConnect);
-	NewDelOperaImplement(ConnectTaskListen);
+	// tasks are created by the logic thread and deleted by the connect task threads
+	ObjectPoolOperaImplement(ConnectTaskConnect, true);
+	ObjectPoolOperaImplement(ConnectTaskListen, true);
 
 	ConnectTask::ConnectTask(EConnectTaskType task_type, int64_t id)
 	{
@@ -21,8 +33,11 @@ namespace Net
 	}
 
 	ConnectTaskConnect::ConnectTaskConnect(int64_t id, std::string ip, uint16_t port, void *opt)
-		: ConnectTask(EConnectTask_Connect, id), m_ip(ip), m_port(port), m_opt(opt)
+		: ConnectTask(EConnectTask_Connect, id), m_ip(ip), m_port(port)
 	{
+		// async tasks run later on a connect task thread, so the opt is copied rather than kept
+		NetConnectOpt default_opt;
+		m_timeout_ms = nullptr != opt ? ((NetConnectOpt *)opt)->timeout_ms : default_opt.timeout_ms;
 	}
 
 	ConnectTaskConnect::~ConnectTaskConnect()
@@ -31,9 +46,10 @@ namespace Net
 	}
 
 	ConnectTaskListen::ConnectTaskListen(int64_t id, std::string ip, uint16_t port, void *opt)
-		: ConnectTask(EConnectTask_Listen, id), m_ip(ip), m_port(port), m_opt(opt)
+		: ConnectTask(EConnectTask_Listen, id), m_ip(ip), m_port(port)
 	{
-
+		if (nullptr != opt)
+			m_is_shard_on_workers = ((NetListenOpt *)opt)->is_shard_on_workers;
 	}
 
 	ConnectTaskListen::~ConnectTaskListen()
@@ -69,15 +85,42 @@ namespace Net
 			listen_addr.sin_addr.S_un.S_addr = inet_addr(m_ip.c_str());
 			listen_addr.sin_port = htons(m_port);
 			memset(listen_addr.sin_zero, 0x00, 8);
+			Net::u_long non_block = 1;
+			ioctlsocket(sock, FIONBIO, &non_block);
 			if (0 != connect(sock, (struct sockaddr *)&listen_addr, sizeof(listen_addr)))
 			{
-				m_result.err_num = GetLastError();
-				m_result.err_msg = "connect socket fail";
-				break;
+				if (WSAEWOULDBLOCK != WSAGetLastError())
+				{
+					m_result.err_num = WSAGetLastError();
+					m_result.err_msg = "connect socket fail";
+					break;
+				}
+				// a failed connect shows up in the except set
+				fd_set write_set, except_set;
+				FD_ZERO(&write_set);
+				FD_ZERO(&except_set);
+				FD_SET(sock, &write_set);
+				FD_SET(sock, &except_set);
+				timeval timeout;
+				timeout.tv_sec = m_timeout_ms / 1000;
+				timeout.tv_usec = (m_timeout_ms % 1000) * 1000;
+				int select_ret = select(0, nullptr, &write_set, &except_set, m_timeout_ms > 0 ? &timeout : nullptr);
+				if (select_ret <= 0)
+				{
+					m_result.err_num = 0 == select_ret ? WSAETIMEDOUT : WSAGetLastError();
+					m_result.err_msg = 0 == select_ret ? "connect socket timeout" : "connect socket fail";
+					break;
+				}
+				int sock_err = 0;
+				int sock_err_len = sizeof(sock_err);
+				getsockopt(sock, SOL_SOCKET, SO_ERROR, (char *)&sock_err, &sock_err_len);
+				if (0 != sock_err || !FD_ISSET(sock, &write_set))
+				{
+					m_result.err_num = 0 != sock_err ? sock_err : WSAECONNREFUSED;
+					m_result.err_msg = "connect socket fail";
+					break;
+				}
 			}
-
-			Net::u_long ret = 0;
-			ioctlsocket(sock, FIONBIO, &ret);
 			m_result.fd = sock;
 
 		} while (false);
@@ -136,5 +179,141 @@ namespace Net
 		}
 		m_task_state = EConnectTask_Done;
 	}
+#else
+
+	void ConnectTaskConnect::Process()
+	{
+		if (EConnectTask_Ready != m_task_state)
+			return;
+
+		m_task_state = EConnectTask_Process;
+		int sock = -1;
+		do 
+		{
+			sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+			if (sock < 0)
+			{
+				m_result.err_num = errno;
+				m_result.err_msg = "create socket fail";
+				sock = -1;
+				break;
+			}
+
+			struct sockaddr_in listen_addr;
+			memset(&listen_addr, 0x00, sizeof(listen_addr));
+			listen_addr.sin_family = AF_INET;
+			listen_addr.sin_addr.s_addr = inet_addr(m_ip.c_str());
+			listen_addr.sin_port = htons(m_port);
+			// nonblocking, so an unreachable peer costs m_timeout_ms of this thread instead of the syn retries of the os
+			int flags = fcntl(sock, F_GETFL, 0);
+			if (flags < 0 || 0 != fcntl(sock, F_SETFL, flags | O_NONBLOCK))
+			{
+				m_result.err_num = errno;
+				m_result.err_msg = "nonblock socket fail";
+				break;
+			}
+			if (0 != connect(sock, (struct sockaddr *)&listen_addr, sizeof(listen_addr)))
+			{
+				if (EINPROGRESS != errno)
+				{
+					m_result.err_num = errno;
+					m_result.err_msg = "connect socket fail";
+					break;
+				}
+				pollfd poll_fd;
+				poll_fd.fd = sock;
+				poll_fd.events = POLLOUT;
+				poll_fd.revents = 0;
+				int poll_ret = -1;
+				do 
+				{
+					poll_ret = poll(&poll_fd, 1, m_timeout_ms > 0 ? (int)m_timeout_ms : -1);
+				} while (poll_ret < 0 && EINTR == errno);
+				if (poll_ret <= 0)
+				{
+					m_result.err_num = 0 == poll_ret ? ETIMEDOUT : errno;
+					m_result.err_msg = 0 == poll_ret ? "connect socket timeout" : "connect socket fail";
+					break;
+				}
+				int sock_err = 0;
+				socklen_t sock_err_len = sizeof(sock_err);
+				if (0 != getsockopt(sock, SOL_SOCKET, SO_ERROR, &sock_err, &sock_err_len))
+					sock_err = errno;
+				if (0 != sock_err)
+				{
+					m_result.err_num = sock_err;
+					m_result.err_msg = "connect socket fail";
+					break;
+				}
+			}
+			m_result.fd = sock;
+
+		} while (false);
+		if (0 != m_result.err_num)
+		{
+			if (sock >= 0)
+				close(sock);
+		}
+		m_task_state = EConnectTask_Done;
+	}
+
+	void ConnectTaskListen::Process()
+	{
+		if (EConnectTask_Ready != m_task_state)
+			return;
+
+		m_task_state = EConnectTask_Process;
+		int sock = -1;
+		do 
+		{
+			sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+			if (sock < 0)
+			{
+				m_result.err_num = errno;
+				m_result.err_msg = "create socket fail";
+				sock = -1;
+				break;
+			}
+
+			int on = 1;
+			setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+#ifdef SO_REUSEPORT
+			// every shard binds the same port, the kernel spreads the accepts over them
+			if (m_is_shard_on_workers &&
+				0 != setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)))
+			{
+				m_result.err_num = errno;
+				m_result.err_msg = "reuse port fail";
+				break;
+			}
+#endif
+
+			struct sockaddr_in listen_addr;
+			memset(&listen_addr, 0x00, sizeof(listen_addr));
+			listen_addr.sin_family = AF_INET;
+			listen_addr.sin_addr.s_addr = inet_addr(m_ip.c_str());
+			listen_addr.sin_port = htons(m_port);
+			if (0 != bind(sock, (struct sockaddr *)&listen_addr, sizeof(listen_addr)))
+			{
+				m_result.err_num = errno;
+				m_result.err_msg = "bind socket fail";
+				break;
+			}
+			if (0 != listen(sock, 64))
+			{
+				m_result.err_num = errno;
+				m_result.err_msg = "listen socket fail";
+				break;
+			}
+			m_result.fd = sock;
+
+		} while (false);
+		if (0 != m_result.err_num)
+		{
+			if (sock >= 0)
+				close(sock);
+		}
+		m_task_state = EConnectTask_Done;
+	}
 #endif
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <functional>
 #include "Common/Define/NetworkDefine.h"
 #include "Common/Macro/MemoryPoolMacro.h"
+#include "Common/Macro/ObjectPoolMacro.h"
 
 namespace Net
 {
@@ -52,7 +53,7 @@ namespace Net
 
 	class ConnectTaskConnect : public ConnectTask
 	{
-		NewDelOperaDeclaration;
+		ObjectPoolOperaDeclaration(ConnectTaskConnect);
 	public:
 		ConnectTaskConnect(int64_t id, std::string ip, uint16_t port, void *opt);
 		virtual ~ConnectTaskConnect();
@@ -61,12 +62,12 @@ namespace Net
 	protected:
 		std::string m_ip;
 		uint16_t m_port = 0;
-		void *m_opt = nullptr;
+		uint32_t m_timeout_ms = 0;
 	};
 
 	class ConnectTaskListen : public ConnectTask
 	{
-		NewDelOperaDeclaration;
+		ObjectPoolOperaDeclaration(ConnectTaskListen);
 	public:
 		ConnectTaskListen(int64_t id, std::string ip, uint16_t port, void *opt);
 		virtual ~ConnectTaskListen();
@@ -75,6 +76,6 @@ namespace Net
 	protected:
 		std::string m_ip;
 		uint16_t m_port = 0;
-		void *m_opt = nullptr;
+		bool m_is_shard_on_workers = false;
 	};
 }
\ No newline at end of file
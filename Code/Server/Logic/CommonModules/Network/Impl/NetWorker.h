@@ -1,86 +1,44 @@
 #pragma once
 
-#include <memory>
-#include <queue>
-#include <unordered_map>
-#include <set>
-#include <mutex>
-#include "INetWorker.h"
-#include "event2/util.h"
-#include "Common/Macro/MemoryPoolMacro.h"
+#include "NetWorkerBase.h"
 
 struct bufferevent;
 struct evconnlistener;
 struct event_base;
-struct evbuffer;
 
 namespace Net
 {
-	class NetWorker : public INetWorker
+	// the io is done by libevent, bufferevents for the connections and evconnlisteners for the listeners
+	class NetWorker : public NetWorkerBase
 	{
 		NewDelOperaDeclaration;
 	public:
-		NetWorker();
+		NetWorker(int worker_idx, int worker_num);
 		virtual ~NetWorker();
-		virtual bool AddCnn(NetId id, int fd, std::weak_ptr<INetworkHandler> handler);
-		virtual void RemoveCnn(NetId id);
-		virtual bool Send(NetId netId, char *buffer, uint32_t len);
-		virtual bool GetNetDatas(std::queue<NetWorkData, std::deque<NetWorkData, StlAllocator<NetWorkData>>> *&out_datas);
-		virtual bool Start();
-		virtual void Stop();
 
 	protected:
 		virtual void Loop();
-		void PushNetworkData(const NetWorkData &data);
-	protected:
-		struct NetConnectionData
+		struct EventCnnData : public NetConnectionData
 		{
 			NewDelOperaDeclaration;
-			// ݽṹֶοԿǷֳ2ṹ壺
-			// һṹᾺֶΣһᾺֶ
-			NetConnectionData() {}
-			NetConnectionData(NetWorker *_networker, NetId _netid, int _fd, std::weak_ptr<INetworkHandler> _handler)
-				: netid(_netid), fd(_fd), handler(_handler), net_worker(_networker) {}
-			NetId netid = 0;
-			int fd = 0;
-			std::weak_ptr<INetworkHandler> handler;
-			ENetworkHandlerType handler_type = ENetworkHandlerType_Max;
-			bool is_expired = false;
+			EventCnnData(NetWorker *_networker, NetId _netid, int _fd, std::weak_ptr<INetworkHandler> _handler)
+				: NetConnectionData(_networker, _netid, _fd, _handler) {}
 			bufferevent *buffer_ev = nullptr;
 			evconnlistener *listen_ev = nullptr;
-			NetWorker *net_worker = nullptr;
 		};
-
-		std::unordered_map<NetId, NetConnectionData *,std::hash<NetId>, std::equal_to<NetId>, StlAllocator<std::pair<const NetId, NetConnectionData *>>> m_cnn_datas;
-		std::unordered_map<NetId, NetConnectionData *, std::hash<NetId>, std::equal_to<NetId>, StlAllocator<std::pair<const NetId, NetConnectionData *>>> m_wait_add_cnn_datas;
-		std::set<NetId, std::less<NetId>, StlAllocator<NetId>> m_wait_remove_netids;
-		std::mutex m_cnn_data_mutex;
-		std::set < NetId, std::less<NetId>, StlAllocator<NetId >> m_internal_wait_remove_netids;
-
-		std::mutex m_need_send_bufs_mutex;
-		std::unordered_map<NetId, evbuffer *> m_need_send_bufs;
-
-	protected:
-		void CheckAddCnnDatas(event_base *base);
-		void CheckRemoveCnnDatas();
-		void CheckSendDatas();
-
-		static const int NETWORK_DATA_QUEUE_LEN = 2;
-		int m_working_network_data_queue = 0;
-		
-		std::queue<NetWorkData, std::deque<NetWorkData, StlAllocator<NetWorkData>>> m_network_data_queues[NETWORK_DATA_QUEUE_LEN];
-		std::mutex m_network_data_mutex;
-
-		std::thread *m_loop_thread = nullptr;
-		bool m_is_runing = false;
-		bool m_is_done = false;
-		int m_loop_span = 1;
+		virtual NetConnectionData * NewCnnData(NetId netid, int fd, std::weak_ptr<INetworkHandler> handler);
+		virtual bool OpenCnn(NetConnectionData *cnn_data, bool is_read);
+		virtual void CloseCnn(NetConnectionData *cnn_data);
+		virtual void EnableRead(NetConnectionData *cnn_data, bool is_enable);
+		virtual void WriteCnn(NetConnectionData *cnn_data, evbuffer *buffer);
+		event_base *m_base = nullptr;
 
 	protected:
+		static void WakeupCb(evutil_socket_t fd, short events, void *ctx);
 		static void CnnEventCb(struct bufferevent *bev, short events, void *ptr);
 		static void CnnReadCb(struct bufferevent *bev, void *ctx);
 		static void CnnWriteCb(struct bufferevent *bev, void *ctx);
 		static void ListenAcceptCb(struct evconnlistener *listener, evutil_socket_t fd, struct sockaddr *address, int socklen, void *ctx);
 		static void ListenErrorCb(struct evconnlistener *listener, void *ctx);
 	};
-}
\ No newline at end of file
+}
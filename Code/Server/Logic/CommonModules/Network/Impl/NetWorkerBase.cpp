@@ -0,0 +1,793 @@
+#include "NetWorkerBase.h"
+#include "event2/buffer.h"
+#include "Common/Utils/MemoryUtil.h"
+#include <chrono>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#elif !defined(WIN32)
+#include <sys/socket.h>
+#endif
+
+namespace Net
+{
+	NetWorkerBase::NetWorkerBase(int worker_idx, int worker_num)
+		: m_worker_idx(worker_idx), m_worker_num(worker_num), m_send_ring(SEND_RING_CAPACITY), m_event_ring(EVENT_RING_CAPACITY)
+	{
+		if (m_worker_num <= 0)
+			m_worker_num = 1;
+	}
+
+	NetWorkerBase::~NetWorkerBase()
+	{
+
+	}
+
+	void NetWorkerBase::SetThreadAttr(const std::string &name, const std::vector<int> &cpus)
+	{
+		m_thread_name = name;
+		m_thread_cpus = cpus;
+	}
+
+	NetWorkerBase::NetConnectionData::~NetConnectionData()
+	{
+		if (nullptr != frame_buffer)
+		{
+			evbuffer_free(frame_buffer);
+			frame_buffer = nullptr;
+		}
+	}
+
+	bool NetWorkerBase::AddCnn(NetId id, int fd, std::weak_ptr<INetworkHandler> handler)
+	{
+		return this->AddCnnData(id, fd, handler, false);
+	}
+
+	bool NetWorkerBase::AddListenShard(NetId id, int fd, std::weak_ptr<INetListenHander> handler)
+	{
+		return this->AddCnnData(id, fd, handler, true);
+	}
+
+	void NetWorkerBase::BindCnn(NetId id, std::weak_ptr<INetConnectHander> handler)
+	{
+		std::shared_ptr<INetConnectHander> sp_handler = handler.lock();
+		if (!m_is_runing || nullptr == sp_handler)
+			return;
+		sp_handler->SetNetId(id);
+
+		BindCnnData bind_data;
+		bind_data.netid = id;
+		bind_data.handler = handler;
+		bind_data.framer = sp_handler->GetFramer();
+		m_cnn_data_mutex.lock();
+		m_wait_bind_cnn_datas.push_back(bind_data);
+		m_cnn_data_mutex.unlock();
+		this->Wakeup();
+	}
+
+	NetId NetWorkerBase::GenNetId()
+	{
+		NetId seq = m_last_netid_seq.fetch_add(1) + 1;
+		return seq * m_worker_num + m_worker_idx;
+	}
+
+	bool NetWorkerBase::AddCnnData(NetId id, int fd, std::weak_ptr<INetworkHandler> handler, bool is_accept_local)
+	{
+		if (!m_is_runing)
+			return false;
+		std::shared_ptr<INetworkHandler> sp_handler = handler.lock();
+		if (nullptr == sp_handler)
+			return false;
+		sp_handler->SetNetId(id);
+
+		bool ret = false;
+		m_cnn_data_mutex.lock();
+		if (m_cnn_datas.count(id) <= 0 && m_wait_add_cnn_datas.count(id) <= 0)
+		{
+			ret = true;
+			NetConnectionData *cnn_data = this->NewCnnData(id, fd, handler);
+			cnn_data->handler_type = sp_handler->HandlerType();
+			cnn_data->is_accept_local = is_accept_local;
+			if (ENetworkHandler_Connect == cnn_data->handler_type)
+			{
+				std::shared_ptr<INetConnectHander> cnn_handler = std::static_pointer_cast<INetConnectHander>(sp_handler);
+				cnn_data->framer = cnn_handler->GetFramer();
+			}
+			m_wait_add_cnn_datas[cnn_data->netid] = cnn_data;
+		}
+		m_cnn_data_mutex.unlock();
+		if (ret)
+			this->Wakeup();
+		return ret;
+	}
+
+	void NetWorkerBase::RemoveCnn(NetId id)
+	{
+		if (!m_is_runing)
+			return;
+
+		// the loop pushes the close event, only it may push to m_event_ring.
+		// the id is queued even if unknown here, CheckAddCnnDatas may be holding the connection
+		m_cnn_data_mutex.lock();
+		m_wait_remove_netids.insert(id);
+		m_cnn_data_mutex.unlock();
+		this->Wakeup();
+	}
+
+	uint32_t NetWorkerBase::SendBuffers(NetSendBuffer *send_bufs, uint32_t buf_num)
+	{
+		if (nullptr == send_bufs || buf_num <= 0)
+			return 0;
+
+		uint32_t push_num = 0;
+		while (push_num < buf_num && m_send_ring.TryPush(send_bufs[push_num]))
+			++push_num;
+		if (push_num < buf_num)
+			m_send_full_num.fetch_add(1, std::memory_order_relaxed);
+		uint32_t depth = m_send_ring.Size();
+		if (depth > m_send_peak_depth.load(std::memory_order_relaxed))
+			m_send_peak_depth.store(depth, std::memory_order_relaxed);
+		if (push_num > 0)
+			this->Wakeup();
+		return push_num;
+	}
+
+	bool NetWorkerBase::PopNetData(NetWorkData &out_data)
+	{
+		return m_event_ring.TryPop(out_data);
+	}
+
+	uint32_t NetWorkerBase::NetDataNum()
+	{
+		return m_event_ring.Size();
+	}
+
+	void NetWorkerBase::GetQueueStat(NetQueueStat &stat)
+	{
+		stat.event_depth = m_event_ring.Size();
+		stat.event_peak_depth = m_event_peak_depth.load(std::memory_order_relaxed);
+		stat.event_capacity = m_event_ring.Capacity();
+		stat.event_full_num = m_event_full_num.load(std::memory_order_relaxed);
+		stat.send_depth = m_send_ring.Size();
+		stat.send_peak_depth = m_send_peak_depth.load(std::memory_order_relaxed);
+		stat.send_capacity = m_send_ring.Capacity();
+		stat.send_full_num = m_send_full_num.load(std::memory_order_relaxed);
+	}
+
+	void NetWorkerBase::SetSendWatermark(const NetSendWatermarkOpt &opt)
+	{
+		m_cnn_send_high_bytes.store(opt.cnn_high_bytes, std::memory_order_relaxed);
+		m_cnn_send_low_bytes.store(opt.cnn_low_bytes, std::memory_order_relaxed);
+		m_cnn_send_close_bytes.store(opt.cnn_close_bytes, std::memory_order_relaxed);
+	}
+
+	uint64_t NetWorkerBase::SendBytes()
+	{
+		return m_send_bytes.load(std::memory_order_relaxed);
+	}
+
+	void NetWorkerBase::AddSendStat(NetSendStat &stat)
+	{
+		stat.send_bytes += m_send_bytes.load(std::memory_order_relaxed);
+		stat.cnn_high_num += m_cnn_send_high_num.load(std::memory_order_relaxed);
+		stat.cnn_low_num += m_cnn_send_low_num.load(std::memory_order_relaxed);
+		stat.cnn_close_num += m_cnn_send_close_num.load(std::memory_order_relaxed);
+	}
+
+	bool NetWorkerBase::GetCnnStat(NetId netid, NetCnnStat &stat)
+	{
+		bool ret = false;
+		m_cnn_data_mutex.lock();
+		auto it = m_cnn_datas.find(netid);
+		if (m_cnn_datas.end() != it && ENetworkHandler_Connect == it->second->handler_type)
+		{
+			ret = true;
+			this->FillCnnStat(it->second, NowMs(), stat);
+		}
+		m_cnn_data_mutex.unlock();
+		return ret;
+	}
+
+	void NetWorkerBase::GetCnnStats(std::vector<NetCnnStat> &stats)
+	{
+		int64_t now_ms = NowMs();
+		m_cnn_data_mutex.lock();
+		for (auto &kv_pair : m_cnn_datas)
+		{
+			if (ENetworkHandler_Connect != kv_pair.second->handler_type)
+				continue;
+			stats.emplace_back();
+			this->FillCnnStat(kv_pair.second, now_ms, stats.back());
+		}
+		m_cnn_data_mutex.unlock();
+	}
+
+	void NetWorkerBase::GetWorkerStat(NetWorkerStat &stat)
+	{
+		stat.worker_idx = m_worker_idx;
+		stat.recv_bytes = m_recv_bytes.load(std::memory_order_relaxed);
+		stat.recv_msg_num = m_recv_msg_num.load(std::memory_order_relaxed);
+		stat.read_num = m_read_num.load(std::memory_order_relaxed);
+		stat.send_bytes = m_sent_bytes.load(std::memory_order_relaxed);
+		stat.send_msg_num = m_sent_msg_num.load(std::memory_order_relaxed);
+		stat.send_queue_bytes = m_send_bytes.load(std::memory_order_relaxed);
+		stat.cnn_num = 0;
+		stat.send_queue_peak_bytes = 0;
+		m_cnn_data_mutex.lock();
+		for (auto &kv_pair : m_cnn_datas)
+		{
+			if (ENetworkHandler_Connect != kv_pair.second->handler_type)
+				continue;
+			++stat.cnn_num;
+			uint32_t peak_bytes = (uint32_t)kv_pair.second->send_peak_bytes.load(std::memory_order_relaxed);
+			if (peak_bytes > stat.send_queue_peak_bytes)
+				stat.send_queue_peak_bytes = peak_bytes;
+		}
+		m_cnn_data_mutex.unlock();
+	}
+
+	void NetWorkerBase::FillCnnStat(NetConnectionData *cnn_data, int64_t now_ms, NetCnnStat &stat)
+	{
+		stat.netid = cnn_data->netid;
+		stat.worker_idx = m_worker_idx;
+		stat.recv_bytes = cnn_data->recv_bytes.load(std::memory_order_relaxed);
+		stat.recv_msg_num = cnn_data->recv_msg_num.load(std::memory_order_relaxed);
+		stat.read_num = cnn_data->read_num.load(std::memory_order_relaxed);
+		stat.send_bytes = cnn_data->sent_bytes.load(std::memory_order_relaxed);
+		stat.send_msg_num = cnn_data->sent_msg_num.load(std::memory_order_relaxed);
+		stat.send_queue_bytes = (uint32_t)cnn_data->send_bytes.load(std::memory_order_relaxed);
+		stat.send_queue_peak_bytes = (uint32_t)cnn_data->send_peak_bytes.load(std::memory_order_relaxed);
+		int64_t active_ms = cnn_data->active_ms.load(std::memory_order_relaxed);
+		stat.idle_ms = now_ms > active_ms ? (uint32_t)(now_ms - active_ms) : 0;
+	}
+
+	int64_t NetWorkerBase::NowMs()
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	bool NetWorkerBase::Start()
+	{
+		if (m_is_done)
+			return false;
+		if (m_is_runing)
+			return true;
+
+		bool ret = false;
+		if (nullptr == m_loop_thread && this->CreateWakeupFds())
+		{
+			ret = true;
+			m_is_runing = true;
+			m_loop_thread = new std::thread(std::bind(&NetWorkerBase::Loop, this));
+		}
+		return ret;
+	}
+
+	void NetWorkerBase::Stop()
+	{
+		m_is_done = true;
+		m_is_runing = false;
+		if (nullptr != m_loop_thread)
+		{
+			this->Wakeup();
+			m_loop_thread->join();
+			delete m_loop_thread;
+			m_loop_thread = nullptr;
+		}
+		this->CloseWakeupFds();
+
+		// the loop thread is gone, the rings are only touched here now
+		NetWorkData data;
+		while (m_event_ring.TryPop(data))
+		{
+			if (nullptr != data.recv_buffer)
+				evbuffer_free(data.recv_buffer);
+			data.recv_buffer = nullptr;
+		}
+		for (NetWorkData &overflow_data : m_overflow_datas)
+		{
+			if (nullptr != overflow_data.recv_buffer)
+				evbuffer_free(overflow_data.recv_buffer);
+		}
+		m_overflow_datas.clear();
+		NetSendBuffer send_buf;
+		while (m_send_ring.TryPop(send_buf))
+			evbuffer_free(send_buf.buffer);
+	}
+
+	void NetWorkerBase::OnCnnRead(NetConnectionData *cnn_data, evbuffer *in_buffer)
+	{
+		size_t read_len = evbuffer_get_length(in_buffer);
+		AddCount(cnn_data->read_num, 1);
+		AddCount(cnn_data->recv_bytes, read_len);
+		AddCount(m_read_num, 1);
+		AddCount(m_recv_bytes, read_len);
+		cnn_data->active_ms.store(NowMs(), std::memory_order_relaxed);
+		if (nullptr != cnn_data->framer)
+		{
+			this->FrameRecvData(cnn_data, in_buffer);
+			return;
+		}
+		if (evbuffer_get_length(in_buffer) > 0)
+		{
+			// the chains holding the read bytes change owner, nothing is copied
+			struct evbuffer *recv_buffer = evbuffer_new();
+			if (nullptr == recv_buffer)
+				return;
+			if (0 != evbuffer_add_buffer(recv_buffer, in_buffer))
+			{
+				evbuffer_free(recv_buffer);
+				return;
+			}
+			NetWorkData data(cnn_data->netid, cnn_data->fd, cnn_data->handler, ENetWorkDataAction_Read, 0, 0, recv_buffer);
+			this->PushNetworkData(data);
+		}
+	}
+
+	void NetWorkerBase::ExpireCnn(NetConnectionData *cnn_data, int err_num)
+	{
+		if (cnn_data->is_expired)
+			return;
+		cnn_data->is_expired = true;
+		m_internal_wait_remove_netids.insert(cnn_data->netid);
+		if (cnn_data->is_in_frame_batch)
+		{
+			// the messages read before the socket broke go first, see FlushFrameBatches
+			cnn_data->is_close_after_frame = true;
+			cnn_data->frame_close_err_num = err_num;
+			return;
+		}
+		NetWorkData data(cnn_data->netid, cnn_data->fd, cnn_data->handler, ENetWorkDataAction_Close, err_num, 0, nullptr);
+		this->PushNetworkData(data);
+	}
+
+	void NetWorkerBase::OutputCb(struct evbuffer *buffer, const struct evbuffer_cb_info *info, void *ctx)
+	{
+		NetConnectionData *cnn_data = (NetConnectionData *)ctx;
+		cnn_data->net_worker->OnOutputChange(cnn_data, info->orig_size + info->n_added - info->n_deleted, info->n_deleted);
+	}
+
+	void NetWorkerBase::WatchOutput(NetConnectionData *cnn_data)
+	{
+		cnn_data->output_cb_entry = evbuffer_add_cb(cnn_data->output, OutputCb, cnn_data);
+	}
+
+	void NetWorkerBase::UnwatchOutput(NetConnectionData *cnn_data)
+	{
+		if (nullptr != cnn_data->output_cb_entry)
+		{
+			evbuffer_remove_cb_entry(cnn_data->output, cnn_data->output_cb_entry);
+			cnn_data->output_cb_entry = nullptr;
+		}
+		m_send_bytes.fetch_sub(cnn_data->send_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		cnn_data->send_bytes.store(0, std::memory_order_relaxed);
+	}
+
+	void NetWorkerBase::OnOutputChange(NetConnectionData *cnn_data, size_t send_bytes, size_t sent_bytes)
+	{
+		size_t old_send_bytes = cnn_data->send_bytes.load(std::memory_order_relaxed);
+		if (send_bytes >= old_send_bytes)
+			m_send_bytes.fetch_add(send_bytes - old_send_bytes, std::memory_order_relaxed);
+		else
+			m_send_bytes.fetch_sub(old_send_bytes - send_bytes, std::memory_order_relaxed);
+		cnn_data->send_bytes.store(send_bytes, std::memory_order_relaxed);
+		if (send_bytes > cnn_data->send_peak_bytes.load(std::memory_order_relaxed))
+			cnn_data->send_peak_bytes.store(send_bytes, std::memory_order_relaxed);
+		if (sent_bytes > 0)
+		{
+			AddCount(cnn_data->sent_bytes, sent_bytes);
+			AddCount(m_sent_bytes, sent_bytes);
+			cnn_data->active_ms.store(NowMs(), std::memory_order_relaxed);
+		}
+		if (cnn_data->is_expired)
+			return;
+
+		uint32_t close_bytes = m_cnn_send_close_bytes.load(std::memory_order_relaxed);
+		if (close_bytes > 0 && send_bytes >= close_bytes)
+		{
+			// freed by CheckRemoveCnnDatas, what is still in the output is dropped with the socket
+			m_cnn_send_close_num.fetch_add(1, std::memory_order_relaxed);
+			this->ExpireCnn(cnn_data, NetSendWatermarkOpt::CLOSE_ERR_NUM);
+			return;
+		}
+		uint32_t high_bytes = m_cnn_send_high_bytes.load(std::memory_order_relaxed);
+		if (!cnn_data->is_send_high && high_bytes > 0 && send_bytes >= high_bytes)
+		{
+			cnn_data->is_send_high = true;
+			m_cnn_send_high_num.fetch_add(1, std::memory_order_relaxed);
+			NetWorkData data(cnn_data->netid, cnn_data->fd, cnn_data->handler, ENetWorkDataAction_SendHigh, 0, 0, nullptr);
+			this->PushNetworkData(data);
+		}
+		else if (cnn_data->is_send_high && send_bytes <= m_cnn_send_low_bytes.load(std::memory_order_relaxed))
+		{
+			cnn_data->is_send_high = false;
+			m_cnn_send_low_num.fetch_add(1, std::memory_order_relaxed);
+			NetWorkData data(cnn_data->netid, cnn_data->fd, cnn_data->handler, ENetWorkDataAction_SendLow, 0, 0, nullptr);
+			this->PushNetworkData(data);
+		}
+	}
+
+	void NetWorkerBase::OnAccept(NetConnectionData *listen_cnn_data, evutil_socket_t fd)
+	{
+		if (listen_cnn_data->is_accept_local)
+		{
+			this->AcceptLocal(listen_cnn_data, fd);
+			return;
+		}
+		NetWorkData data(listen_cnn_data->netid, listen_cnn_data->fd, listen_cnn_data->handler, ENetWorkDataAction_Read, 0, fd, nullptr);
+		this->PushNetworkData(data);
+	}
+
+	void NetWorkerBase::AcceptLocal(NetConnectionData *listen_cnn_data, evutil_socket_t fd)
+	{
+		// accepted fds are nonblocking. reading waits for the handler, see CheckBindCnnDatas
+		NetId netid = this->GenNetId();
+		NetConnectionData *cnn_data = this->NewCnnData(netid, (int)fd, std::weak_ptr<INetworkHandler>());
+		cnn_data->handler_type = ENetworkHandler_Connect;
+		if (!this->OpenCnn(cnn_data, false))
+		{
+			evutil_closesocket(fd);
+			delete cnn_data;
+			return;
+		}
+		this->WatchOutput(cnn_data);
+		m_cnn_data_mutex.lock();
+		m_cnn_datas[netid] = cnn_data;
+		m_cnn_data_mutex.unlock();
+
+		NetWorkData data(netid, (int)fd, listen_cnn_data->handler, ENetWorkDataAction_Accept, 0, (int)fd, nullptr);
+		this->PushNetworkData(data);
+	}
+
+	void NetWorkerBase::CheckBindCnnDatas()
+	{
+		std::vector<BindCnnData> swap_bind_datas;
+		m_cnn_data_mutex.lock();
+		swap_bind_datas.swap(m_wait_bind_cnn_datas);
+		m_cnn_data_mutex.unlock();
+
+		for (BindCnnData &bind_data : swap_bind_datas)
+		{
+			auto it = m_cnn_datas.find(bind_data.netid);
+			if (m_cnn_datas.end() == it || it->second->is_expired || ENetworkHandler_Connect != it->second->handler_type)
+				continue;
+			NetConnectionData *cnn_data = it->second;
+			cnn_data->handler = bind_data.handler;
+			cnn_data->framer = bind_data.framer;
+			if (nullptr != cnn_data->framer && nullptr == cnn_data->frame_buffer)
+			{
+				cnn_data->frame_buffer = evbuffer_new();
+				if (nullptr == cnn_data->frame_buffer)
+				{
+					this->ExpireCnn(cnn_data, 0);
+					continue;
+				}
+			}
+			this->EnableRead(cnn_data, true);
+		}
+	}
+
+	void NetWorkerBase::FrameRecvData(NetConnectionData *cnn_data, evbuffer *in_buffer)
+	{
+		if (cnn_data->is_frame_fail)
+		{
+			evbuffer_drain(in_buffer, evbuffer_get_length(in_buffer));
+			return;
+		}
+		if (0 != evbuffer_add_buffer(cnn_data->frame_buffer, in_buffer))
+			return;
+
+		// only heads are copied out, the contents stay in the chains
+		INetFramer *framer = cnn_data->framer.get();
+		uint32_t head_len = framer->LenDescriptSize();
+		char head[INetFramer::MAX_LEN_DESCRIPT_SIZE];
+		size_t buffer_len = evbuffer_get_length(cnn_data->frame_buffer);
+		uint32_t old_msg_num = cnn_data->frame_msg_num;
+		while (buffer_len - cnn_data->frame_complete_len >= head_len)
+		{
+			evbuffer_ptr pos;
+			evbuffer_ptr_set(cnn_data->frame_buffer, &pos, cnn_data->frame_complete_len, EVBUFFER_PTR_SET);
+			evbuffer_copyout_from(cnn_data->frame_buffer, &pos, head, head_len);
+			uint32_t content_len = framer->ParseContentLen(head);
+			if (content_len <= 0)
+			{
+				cnn_data->is_frame_fail = true;
+				this->EnableRead(cnn_data, false);
+				break;
+			}
+			if (buffer_len - cnn_data->frame_complete_len < head_len + content_len)
+				break;
+			cnn_data->frame_complete_len += head_len + content_len;
+			++cnn_data->frame_msg_num;
+		}
+		AddCount(cnn_data->recv_msg_num, cnn_data->frame_msg_num - old_msg_num);
+		AddCount(m_recv_msg_num, cnn_data->frame_msg_num - old_msg_num);
+
+		if ((cnn_data->frame_msg_num > 0 || cnn_data->is_frame_fail) && !cnn_data->is_in_frame_batch)
+		{
+			cnn_data->is_in_frame_batch = true;
+			m_frame_batch_cnns.push_back(cnn_data);
+		}
+	}
+
+	void NetWorkerBase::FlushFrameBatches()
+	{
+		if (m_frame_batch_cnns.empty())
+			return;
+
+		for (NetConnectionData *cnn_data : m_frame_batch_cnns)
+		{
+			cnn_data->is_in_frame_batch = false;
+			if (cnn_data->frame_msg_num > 0)
+			{
+				evbuffer *batch_buffer = evbuffer_new();
+				if (nullptr != batch_buffer)
+				{
+					// whole chains change owner, only the chain shared with the incomplete message is copied
+					if (evbuffer_get_length(cnn_data->frame_buffer) == cnn_data->frame_complete_len)
+						evbuffer_add_buffer(batch_buffer, cnn_data->frame_buffer);
+					else
+						evbuffer_remove_buffer(cnn_data->frame_buffer, batch_buffer, cnn_data->frame_complete_len);
+					NetWorkData data(cnn_data->netid, cnn_data->fd, cnn_data->handler, ENetWorkDataAction_Read, 0, 0, batch_buffer);
+					data.msg_num = cnn_data->frame_msg_num;
+					m_frame_batch_datas.push_back(data);
+					cnn_data->frame_complete_len = 0;
+					cnn_data->frame_msg_num = 0;
+				}
+			}
+			if (cnn_data->is_frame_fail && !cnn_data->is_frame_fail_reported)
+			{
+				cnn_data->is_frame_fail_reported = true;
+				evbuffer_drain(cnn_data->frame_buffer, evbuffer_get_length(cnn_data->frame_buffer));
+				NetWorkData data(cnn_data->netid, cnn_data->fd, cnn_data->handler, ENetWorkDataAction_FrameFail, 0, 0, nullptr);
+				m_frame_batch_datas.push_back(data);
+			}
+			if (cnn_data->is_close_after_frame)
+			{
+				cnn_data->is_close_after_frame = false;
+				NetWorkData data(cnn_data->netid, cnn_data->fd, cnn_data->handler, ENetWorkDataAction_Close, cnn_data->frame_close_err_num, 0, nullptr);
+				m_frame_batch_datas.push_back(data);
+			}
+		}
+		m_frame_batch_cnns.clear();
+
+		for (NetWorkData &data : m_frame_batch_datas)
+			this->PushNetworkData(data);
+		m_frame_batch_datas.clear();
+	}
+
+	void NetWorkerBase::FlushOverflowDatas()
+	{
+		while (!m_overflow_datas.empty() && m_event_ring.TryPush(m_overflow_datas.front()))
+			m_overflow_datas.pop_front();
+		uint32_t depth = m_event_ring.Size();
+		if (depth > m_event_peak_depth.load(std::memory_order_relaxed))
+			m_event_peak_depth.store(depth, std::memory_order_relaxed);
+	}
+
+	bool NetWorkerBase::CreateWakeupFds()
+	{
+#ifdef __linux__
+		int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (fd < 0)
+			return false;
+		m_wakeup_fds[0] = fd;
+		m_wakeup_fds[1] = fd;
+#else
+#ifdef WIN32
+		int family = AF_INET;
+#else
+		int family = AF_UNIX;
+#endif
+		evutil_socket_t fds[2];
+		if (0 != evutil_socketpair(family, SOCK_STREAM, 0, fds))
+			return false;
+		evutil_make_socket_nonblocking(fds[0]);
+		evutil_make_socket_nonblocking(fds[1]);
+		m_wakeup_fds[0] = fds[0];
+		m_wakeup_fds[1] = fds[1];
+#endif
+		return true;
+	}
+
+	void NetWorkerBase::CloseWakeupFds()
+	{
+		if (m_wakeup_fds[1] >= 0 && m_wakeup_fds[1] != m_wakeup_fds[0])
+			evutil_closesocket(m_wakeup_fds[1]);
+		if (m_wakeup_fds[0] >= 0)
+			evutil_closesocket(m_wakeup_fds[0]);
+		m_wakeup_fds[0] = -1;
+		m_wakeup_fds[1] = -1;
+	}
+
+	void NetWorkerBase::Wakeup()
+	{
+		if (m_is_wakeup_pending.exchange(true))
+			return;
+#ifdef __linux__
+		uint64_t count = 1;
+		(void)write(m_wakeup_fds[1], &count, sizeof(count));
+#else
+		char byte = 0;
+		send(m_wakeup_fds[1], &byte, 1, 0);
+#endif
+	}
+
+	void NetWorkerBase::DrainWakeup()
+	{
+#ifdef __linux__
+		uint64_t count = 0;
+		(void)read(m_wakeup_fds[0], &count, sizeof(count));
+#else
+		char bytes[64];
+		while (recv(m_wakeup_fds[0], bytes, sizeof(bytes), 0) > 0) {}
+#endif
+		this->OnWakeup();
+	}
+
+	void NetWorkerBase::OnWakeup()
+	{
+		// cleared after draining, so a Wakeup coming later always leaves the fd readable.
+		// work queued by a Wakeup which saw the flag still set is picked up by the Check* functions run after this
+		m_is_wakeup_pending.exchange(false);
+	}
+
+	void NetWorkerBase::PushNetworkData(const NetWorkData &data)
+	{
+		// behind older overflowed events, the logic thread has to see them in order
+		if (m_overflow_datas.empty() && m_event_ring.TryPush(data))
+			return;
+		m_event_full_num.fetch_add(1, std::memory_order_relaxed);
+		m_overflow_datas.push_back(data);
+	}
+
+	void NetWorkerBase::CheckAddCnnDatas()
+	{
+		// the wait lists are only looked at under their mutex, a stale empty list would leave the work to a later wakeup
+		std::unordered_map<NetId, NetConnectionData *, std::hash<NetId>, std::equal_to<NetId>, StlAllocator<std::pair<const NetId, NetConnectionData *>>> swap_cnn_datas;
+		m_cnn_data_mutex.lock();
+		swap_cnn_datas.swap(m_wait_add_cnn_datas);
+		m_cnn_data_mutex.unlock();
+
+		if (!swap_cnn_datas.empty())
+		{
+			for (auto kv_pair : swap_cnn_datas)
+			{
+				NetId netid = kv_pair.first;
+				NetConnectionData *cnn_data = kv_pair.second;
+
+				bool is_ok = true;
+				do
+				{
+					if (0 != evutil_make_socket_nonblocking(cnn_data->fd))
+					{
+						is_ok = false;
+						break;
+					}
+					if (cnn_data->handler.expired())
+					{
+						is_ok = false;
+						break;
+					}
+					if (ENetworkHandler_Connect == cnn_data->handler_type && nullptr != cnn_data->framer)
+					{
+						cnn_data->frame_buffer = evbuffer_new();
+						if (nullptr == cnn_data->frame_buffer)
+						{
+							is_ok = false;
+							break;
+						}
+					}
+					if (!this->OpenCnn(cnn_data, true))
+					{
+						is_ok = false;
+						break;
+					}
+					if (nullptr != cnn_data->output)
+						this->WatchOutput(cnn_data);
+				} while (false);
+
+				if (is_ok)
+				{
+					m_cnn_data_mutex.lock();
+					m_cnn_datas[netid] = cnn_data;
+					m_cnn_data_mutex.unlock();
+				}
+				else
+				{
+					NetWorkData data(cnn_data->netid, cnn_data->fd, cnn_data->handler, ENetWorkDataAction_Close, 0, 0, nullptr);
+					this->PushNetworkData(data);
+					m_internal_wait_remove_netids.insert(netid);
+					if (cnn_data->fd >= 0)
+						evutil_closesocket(cnn_data->fd);
+					delete cnn_data;
+					continue;
+				}
+			}
+			swap_cnn_datas.clear();
+		}
+	}
+
+	void NetWorkerBase::CheckRemoveCnnDatas()
+	{
+		m_cnn_data_mutex.lock();
+		for (NetId netid : m_wait_remove_netids)
+		{
+			// closed by the logic side, its handler still hears about it unless the connection broke first
+			NetConnectionData *cnn_data = nullptr;
+			auto it = m_cnn_datas.find(netid);
+			if (m_cnn_datas.end() != it)
+				cnn_data = it->second;
+			else
+			{
+				auto wait_it = m_wait_add_cnn_datas.find(netid);
+				if (m_wait_add_cnn_datas.end() != wait_it)
+					cnn_data = wait_it->second;
+			}
+			if (nullptr != cnn_data && !cnn_data->is_expired)
+			{
+				cnn_data->is_expired = true;
+				NetWorkData data(cnn_data->netid, cnn_data->fd, cnn_data->handler, ENetWorkDataAction_Close, 0, 0, nullptr);
+				this->PushNetworkData(data);
+			}
+		}
+		m_internal_wait_remove_netids.insert(m_wait_remove_netids.begin(), m_wait_remove_netids.end());
+		m_wait_remove_netids.clear();
+		if (!m_internal_wait_remove_netids.empty())
+		{
+			for (NetId netid : m_internal_wait_remove_netids)
+			{
+				{
+					auto it = m_wait_add_cnn_datas.find(netid);
+					if (m_wait_add_cnn_datas.end() != it)
+					{
+						if (it->second->fd >= 0)
+							evutil_closesocket(it->second->fd);
+						delete it->second;
+						m_wait_add_cnn_datas.erase(it);
+					}
+				}
+				{
+					auto it = m_cnn_datas.find(netid);
+					if (m_cnn_datas.end() != it)
+					{
+						NetConnectionData *cnn_data = it->second;
+						m_cnn_datas.erase(it);
+						if (nullptr != cnn_data->output)
+							this->UnwatchOutput(cnn_data);
+						this->CloseCnn(cnn_data);
+					}
+				}
+			}
+			m_internal_wait_remove_netids.clear();
+		}
+		m_cnn_data_mutex.unlock();
+	}
+
+	void NetWorkerBase::CheckSendDatas()
+	{
+		// m_cnn_datas is only changed by this thread, reading it needs no lock
+		NetSendBuffer send_buf;
+		while (m_send_ring.TryPop(send_buf))
+		{
+			auto it = m_cnn_datas.find(send_buf.netid);
+			if (m_cnn_datas.end() != it && ENetworkHandler_Connect == it->second->handler_type && !it->second->is_expired)
+			{
+				AddCount(it->second->sent_msg_num, send_buf.msg_num);
+				AddCount(m_sent_msg_num, send_buf.msg_num);
+				this->WriteCnn(it->second, send_buf.buffer);
+			}
+			evbuffer_free(send_buf.buffer);
+		}
+	}
+
+	void NetWorkerBase::RemoveAllCnnDatas()
+	{
+		for (auto kv_pair : m_cnn_datas)
+			m_internal_wait_remove_netids.insert(kv_pair.first);
+		for (auto kv_pair : m_wait_add_cnn_datas)
+			m_internal_wait_remove_netids.insert(kv_pair.first);
+		this->CheckRemoveCnnDatas();
+		this->CheckSendDatas();
+	}
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <memory>
+#include <queue>
+#include <unordered_map>
+#include <set>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <thread>
+#include "INetWorker.h"
+#include "CommonModules/Network/INetFramer.h"
+#include "event2/util.h"
+#include "DataStructure/SpscRing.h"
+#include "Common/Macro/MemoryPoolMacro.h"
+
+struct evbuffer;
+struct evbuffer_cb_entry;
+struct evbuffer_cb_info;
+
+namespace Net
+{
+	// what every net worker shares whatever does its io: the queues with the logic thread, the connection tables,
+	// framing, the send watermarks and the wakeup fd. a subclass runs Loop and moves the bytes of the sockets
+	class NetWorkerBase : public INetWorker
+	{
+	public:
+		NetWorkerBase(int worker_idx, int worker_num);
+		virtual ~NetWorkerBase();
+		virtual bool AddCnn(NetId id, int fd, std::weak_ptr<INetworkHandler> handler);
+		virtual bool AddListenShard(NetId id, int fd, std::weak_ptr<INetListenHander> handler);
+		virtual void BindCnn(NetId id, std::weak_ptr<INetConnectHander> handler);
+		virtual NetId GenNetId();
+		virtual void RemoveCnn(NetId id);
+		virtual uint32_t SendBuffers(NetSendBuffer *send_bufs, uint32_t buf_num);
+		virtual bool PopNetData(NetWorkData &out_data);
+		virtual uint32_t NetDataNum();
+		virtual void GetQueueStat(NetQueueStat &stat);
+		virtual void SetSendWatermark(const NetSendWatermarkOpt &opt);
+		virtual uint64_t SendBytes();
+		virtual void AddSendStat(NetSendStat &stat);
+		virtual bool GetCnnStat(NetId netid, NetCnnStat &stat);
+		virtual void GetCnnStats(std::vector<NetCnnStat> &stats);
+		virtual void GetWorkerStat(NetWorkerStat &stat);
+		virtual bool Start();
+		virtual void Stop();
+		// applied by the worker thread itself when Loop starts, so it must be set before Start
+		void SetThreadAttr(const std::string &name, const std::vector<int> &cpus);
+
+	protected:
+		virtual void Loop() = 0;
+		void PushNetworkData(const NetWorkData &data);
+	protected:
+		struct NetConnectionData
+		{
+			// ݽṹֶοԿǷֳ2ṹ壺
+			// һṹᾺֶΣһᾺֶ
+			NetConnectionData() {}
+			NetConnectionData(NetWorkerBase *_networker, NetId _netid, int _fd, std::weak_ptr<INetworkHandler> _handler)
+				: netid(_netid), fd(_fd), handler(_handler), net_worker(_networker), active_ms(NowMs()) {}
+			virtual ~NetConnectionData();
+			NetId netid = 0;
+			int fd = 0;
+			std::weak_ptr<INetworkHandler> handler;
+			ENetworkHandlerType handler_type = ENetworkHandlerType_Max;
+			bool is_expired = false;
+			bool is_accept_local = false; // a sharded listener, its connections stay on this worker
+			NetWorkerBase *net_worker = nullptr;
+
+			// framing on the net worker thread, only used by it
+			std::shared_ptr<INetFramer> framer;
+			evbuffer *frame_buffer = nullptr; // whole messages of this loop round followed by the incomplete one
+			uint32_t frame_complete_len = 0; // bytes of the whole messages at the front of frame_buffer
+			uint32_t frame_msg_num = 0;
+			bool is_in_frame_batch = false;
+			bool is_frame_fail = false;
+			bool is_frame_fail_reported = false;
+			bool is_close_after_frame = false; // expired while its messages wait in the batch, closed behind them
+			int frame_close_err_num = 0;
+
+			// bytes waiting to be sent, owned by the subclass and watched by OutputCb
+			evbuffer *output = nullptr;
+			evbuffer_cb_entry *output_cb_entry = nullptr;
+			std::atomic<size_t> send_bytes{ 0 };
+			bool is_send_high = false;
+
+			// for GetCnnStat, written by the loop thread only and read by others under m_cnn_data_mutex
+			std::atomic<uint64_t> recv_bytes{ 0 };
+			std::atomic<uint64_t> recv_msg_num{ 0 };
+			std::atomic<uint64_t> read_num{ 0 };
+			std::atomic<uint64_t> sent_bytes{ 0 };
+			std::atomic<uint64_t> sent_msg_num{ 0 };
+			std::atomic<size_t> send_peak_bytes{ 0 };
+			std::atomic<int64_t> active_ms{ 0 }; // steady clock of the last read or the last bytes taken by the socket
+		};
+
+		// the io of a connection is up to the subclass, these are called by the loop thread only.
+		// NewCnnData is also called by the thread of AddCnn and AddListenShard
+		virtual NetConnectionData * NewCnnData(NetId netid, int fd, std::weak_ptr<INetworkHandler> handler) = 0;
+		// sets up the io of a connection or a listener, by handler_type. a connection reads from the start if is_read.
+		// on fail the fd is still open and cnn_data is freed by the caller
+		virtual bool OpenCnn(NetConnectionData *cnn_data, bool is_read) = 0;
+		// closes the fd and frees cnn_data, now or once the io still using it is over
+		virtual void CloseCnn(NetConnectionData *cnn_data) = 0;
+		virtual void EnableRead(NetConnectionData *cnn_data, bool is_enable) = 0;
+		// moves the content of buffer to the output of the connection, buffer is freed by the caller
+		virtual void WriteCnn(NetConnectionData *cnn_data, evbuffer *buffer) = 0;
+
+		// for the subclasses, the bytes read and the sockets accepted or broken
+		void OnCnnRead(NetConnectionData *cnn_data, evbuffer *in_buffer);
+		void OnAccept(NetConnectionData *listen_cnn_data, evutil_socket_t fd);
+		// pushes the close event and frees the connection at the next CheckRemoveCnnDatas
+		void ExpireCnn(NetConnectionData *cnn_data, int err_num);
+
+		std::unordered_map<NetId, NetConnectionData *,std::hash<NetId>, std::equal_to<NetId>, StlAllocator<std::pair<const NetId, NetConnectionData *>>> m_cnn_datas;
+		std::unordered_map<NetId, NetConnectionData *, std::hash<NetId>, std::equal_to<NetId>, StlAllocator<std::pair<const NetId, NetConnectionData *>>> m_wait_add_cnn_datas;
+		std::set<NetId, std::less<NetId>, StlAllocator<NetId>> m_wait_remove_netids;
+		std::mutex m_cnn_data_mutex;
+		std::set < NetId, std::less<NetId>, StlAllocator<NetId >> m_internal_wait_remove_netids;
+		bool AddCnnData(NetId id, int fd, std::weak_ptr<INetworkHandler> handler, bool is_accept_local);
+
+		// connections accepted by a sharded listener read nothing until the logic thread binds their handler
+		struct BindCnnData
+		{
+			NetId netid = 0;
+			std::weak_ptr<INetworkHandler> handler;
+			std::shared_ptr<INetFramer> framer;
+		};
+		std::vector<BindCnnData> m_wait_bind_cnn_datas;
+		void AcceptLocal(NetConnectionData *listen_cnn_data, evutil_socket_t fd);
+		void CheckBindCnnDatas();
+
+		int m_worker_idx = 0;
+		int m_worker_num = 1;
+		std::string m_thread_name;
+		std::vector<int> m_thread_cpus;
+		std::atomic<NetId> m_last_netid_seq{ 0 };
+
+		// filled by SendBuffers on the logic thread, each buffer is owned by the ring until popped
+		SpscRing<NetSendBuffer> m_send_ring;
+		std::atomic<uint32_t> m_send_peak_depth{ 0 };
+		std::atomic<uint64_t> m_send_full_num{ 0 };
+
+		// every change of a connection output is seen by OutputCb, which counts the bytes and reports the watermark crossings.
+		// the limits may be changed by the logic thread at any time, the counters are only written by the loop
+		std::atomic<uint32_t> m_cnn_send_high_bytes{ 0 };
+		std::atomic<uint32_t> m_cnn_send_low_bytes{ 0 };
+		std::atomic<uint32_t> m_cnn_send_close_bytes{ 0 };
+		std::atomic<uint64_t> m_send_bytes{ 0 };
+		std::atomic<uint64_t> m_cnn_send_high_num{ 0 };
+		std::atomic<uint64_t> m_cnn_send_low_num{ 0 };
+		std::atomic<uint64_t> m_cnn_send_close_num{ 0 };
+		void WatchOutput(NetConnectionData *cnn_data);
+		void UnwatchOutput(NetConnectionData *cnn_data);
+		// send_bytes is what the output holds now, sent_bytes what the socket took since the last change
+		void OnOutputChange(NetConnectionData *cnn_data, size_t send_bytes, size_t sent_bytes);
+		static void OutputCb(struct evbuffer *buffer, const struct evbuffer_cb_info *info, void *ctx);
+
+		// the totals of the NetConnectionData counters, closed connections included
+		std::atomic<uint64_t> m_recv_bytes{ 0 };
+		std::atomic<uint64_t> m_recv_msg_num{ 0 };
+		std::atomic<uint64_t> m_read_num{ 0 };
+		std::atomic<uint64_t> m_sent_bytes{ 0 };
+		std::atomic<uint64_t> m_sent_msg_num{ 0 };
+		// every counter has the loop thread as its only writer, so no locked add is needed
+		static void AddCount(std::atomic<uint64_t> &counter, uint64_t num) { counter.store(counter.load(std::memory_order_relaxed) + num, std::memory_order_relaxed); }
+		static int64_t NowMs();
+		void FillCnnStat(NetConnectionData *cnn_data, int64_t now_ms, NetCnnStat &stat);
+
+	protected:
+		// the loop of a subclass runs these every round: the Check* ones before waiting for its sockets, with
+		// CheckRemoveCnnDatas first, and FlushFrameBatches, FlushOverflowDatas and CheckRemoveCnnDatas after
+		void CheckAddCnnDatas();
+		void CheckRemoveCnnDatas();
+		void CheckSendDatas();
+		// when the loop is over
+		void RemoveAllCnnDatas();
+
+		// reads only split the stream, the whole messages of every connection are pushed once per loop round
+		void FrameRecvData(NetConnectionData *cnn_data, evbuffer *in_buffer);
+		void FlushFrameBatches();
+		std::vector<NetConnectionData *> m_frame_batch_cnns;
+		std::vector<NetWorkData> m_frame_batch_datas;
+
+		// only the loop thread pushes events. when the ring is full they wait in m_overflow_datas, in order,
+		// and the loop wakes up every OVERFLOW_RETRY_MS to move them on
+		SpscRing<NetWorkData> m_event_ring;
+		std::deque<NetWorkData, StlAllocator<NetWorkData>> m_overflow_datas;
+		void FlushOverflowDatas();
+		std::atomic<uint32_t> m_event_peak_depth{ 0 };
+		std::atomic<uint64_t> m_event_full_num{ 0 };
+		static const uint32_t EVENT_RING_CAPACITY = 16384;
+		static const uint32_t SEND_RING_CAPACITY = 16384;
+		static const int OVERFLOW_RETRY_MS = 1;
+
+		std::thread *m_loop_thread = nullptr;
+		std::atomic<bool> m_is_runing{ false };
+		bool m_is_done = false;
+
+		// the loop blocks until a socket is ready or AddCnn, RemoveCnn, SendBuffers or Stop call Wakeup.
+		// on linux both fds are one eventfd, elsewhere a socket pair whose [1] is written and [0] read by the loop
+		bool CreateWakeupFds();
+		void CloseWakeupFds();
+		void Wakeup();
+		// the loop calls DrainWakeup when m_wakeup_fds[0] is readable, or OnWakeup if it has read the fd itself
+		void DrainWakeup();
+		void OnWakeup();
+		evutil_socket_t m_wakeup_fds[2] = { -1, -1 };
+		std::atomic<bool> m_is_wakeup_pending{ false }; // one write is enough until the loop has run the Check* functions
+	};
+}
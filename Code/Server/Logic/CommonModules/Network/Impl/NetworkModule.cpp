@@ -2,27 +2,73 @@
 #include "ModuleDef/ModuleMgr.h"
 #include "CommonModules/Log/LogModule.h"
 #include "NetWorker.h"
+#include "EpollNetWorker.h"
+#include "UringNetWorker.h"
 #include "Common/Utils/MemoryUtil.h"
 #include "MemoryPool/StlAllocator.h"
+#include "event2/buffer.h"
+#include "CommonModules/Network/INetFramer.h"
+#include "Common/Define/ServerLogicDefine.h"
+#include "ServerLogics/ThreadConfig.h"
+#include "Utils/ThreadUtil.h"
+#include <atomic>
+#include <new>
+#include <cerrno>
 
 #ifdef WIN32
 #include <winsock2.h>
 #define close closesocket
+#else
+#include <sys/socket.h>
+#include <unistd.h>
 #endif
 
+// content of a multicast, referenced by the send buffers of all its receivers.
+// the last reference is dropped on whichever net worker writes it out last, so ref_num is atomic
+struct NetSharedBuffer
+{
+	std::atomic<uint32_t> ref_num;
+	uint32_t len = 0;
+	char * Data() { return (char *)(this + 1); }
+
+	static NetSharedBuffer * Create(uint32_t len)
+	{
+		void *ptr = Malloc(sizeof(NetSharedBuffer) + len);
+		if (nullptr == ptr)
+			return nullptr;
+		NetSharedBuffer *buf = new (ptr) NetSharedBuffer();
+		buf->ref_num = 1;
+		buf->len = len;
+		return buf;
+	}
+
+	static void Release(NetSharedBuffer *buf)
+	{
+		if (1 != buf->ref_num.fetch_sub(1))
+			return;
+		buf->~NetSharedBuffer();
+		Free(buf);
+	}
+
+	// evbuffer_ref_cleanup_cb
+	static void OnRefCleanup(const void *data, size_t data_len, void *arg)
+	{
+		Release((NetSharedBuffer *)arg);
+	}
+};
+
 struct ConnectTaskThread
 {
 	NewDelOperaDeclaration;
 	using ThreadAction = void(*)(ConnectTaskThread *);
-	ConnectTaskThread(std::function<void(ConnectTaskThread *)> _action, std::mutex *_task_mutex,
+	ConnectTaskThread(std::function<void(ConnectTaskThread *)> _action, std::mutex *_task_mutex, std::condition_variable *_task_cv,
 		std::queue<Net::ConnectTask *, std::deque<Net::ConnectTask *, StlAllocator<Net::ConnectTask *>>> *_cnn_tasks, 
 		std::mutex *_result_mutex,
-		std::queue<Net::ConnectResult, std::deque<Net::ConnectResult, StlAllocator<Net::ConnectResult>>> *_cnn_results) :
-		task_mutex(_task_mutex), cnn_tasks(_cnn_tasks), result_mutex(_result_mutex),
-		cnn_results(_cnn_results), action(_action)
+		std::queue<Net::ConnectResult, std::deque<Net::ConnectResult, StlAllocator<Net::ConnectResult>>> *_cnn_results,
+		std::atomic<uint32_t> *_cnn_result_num) :
+		task_mutex(_task_mutex), task_cv(_task_cv), cnn_tasks(_cnn_tasks), result_mutex(_result_mutex),
+		cnn_results(_cnn_results), cnn_result_num(_cnn_result_num), action(_action)
 	{
-		int a = 0; 
-		++a;
 	}
 
 	~ConnectTaskThread()
@@ -45,58 +91,63 @@ struct ConnectTaskThread
 	}
 	void Exit()
 	{
+		// under the task mutex, so a thread between its check and its wait still sees it
+		std::lock_guard<std::mutex> lock(*task_mutex);
 		is_exit = true;
+		task_cv->notify_all();
 	}
 	void Join()
 	{
 		this->Exit();
-		self_thread->join();
+		if (nullptr != self_thread)
+		{
+			self_thread->join();
+			delete self_thread; self_thread = nullptr;
+		}
 		action = nullptr;
-		delete self_thread; self_thread = nullptr;
 	}
 
 	bool is_exit = false;
 	std::mutex *task_mutex;
+	std::condition_variable *task_cv;
 	std::queue<Net::ConnectTask *, std::deque<Net::ConnectTask *, StlAllocator<Net::ConnectTask *>>> *cnn_tasks;
 	std::mutex *result_mutex;
 	std::queue<Net::ConnectResult, std::deque<Net::ConnectResult, StlAllocator<Net::ConnectResult>>> *cnn_results;
+	std::atomic<uint32_t> *cnn_result_num;
 	std::function<void(ConnectTaskThread *)> action = nullptr;
 	std::thread *self_thread = nullptr;
+	std::string thread_name;
+	std::vector<int> cpus;
 };
 
 void CnnTaskWorker(ConnectTaskThread *task_thread)
 {
 	if (nullptr == task_thread) return;
 
-	bool is_exit = false;
 	std::mutex *task_mutex = task_thread->task_mutex;
+	std::condition_variable *task_cv = task_thread->task_cv;
 	std::queue<Net::ConnectTask *, std::deque<Net::ConnectTask *, StlAllocator<Net::ConnectTask *>>> *cnn_tasks = task_thread->cnn_tasks;
 	std::mutex *result_mutex = task_thread->result_mutex;
 	std::queue<Net::ConnectResult, std::deque<Net::ConnectResult, StlAllocator<Net::ConnectResult>>> *cnn_results = task_thread->cnn_results;
+	ThreadUtil::SetCurrentThreadName(task_thread->thread_name);
+	ThreadUtil::SetCurrentThreadAffinity(task_thread->cpus);
 
-	while (!task_thread->is_exit)
+	while (true)
 	{
-		if (cnn_tasks->empty())
-		{
-			static const int SLEEP_SPAN = 25;
-			std::this_thread::sleep_for(std::chrono::milliseconds(SLEEP_SPAN));
-			continue;
-		}
+		// asleep until ListenAsync, ConnectAsync or Exit notifies, an idle thread never wakes up by itself
 		Net::ConnectTask *task = nullptr;
-		if (task_mutex->try_lock())
 		{
-			if (!cnn_tasks->empty())
-			{
-				task = cnn_tasks->front();
-				cnn_tasks->pop();
-			}
-			task_mutex->unlock();
+			std::unique_lock<std::mutex> lock(*task_mutex);
+			task_cv->wait(lock, [task_thread, cnn_tasks]() { return task_thread->is_exit || !cnn_tasks->empty(); });
+			if (task_thread->is_exit)
+				break;
+			task = cnn_tasks->front();
+			cnn_tasks->pop();
 		}
-		if (nullptr == task)
-			continue;
 		task->Process();
 		result_mutex->lock();
 		cnn_results->push(task->GetResult());
+		++(*task_thread->cnn_result_num);
 		result_mutex->unlock();
 		delete task; task = nullptr;
 	}
@@ -105,8 +156,51 @@ void CnnTaskWorker(ConnectTaskThread *task_thread)
 NetworkModule::NetworkModule(ModuleMgr *module_mgr) : INetworkModule(module_mgr)
 {
 	m_cnn_task_mutex = new std::mutex();
+	m_cnn_task_cv = new std::condition_variable();
 	m_cnn_results_mutex = new std::mutex();
+	m_cnn_result_num = 0;
+}
 
+ThreadConfig * NetworkModule::LoadThreadCfg(ThreadConfigSet *cfg_set, int cfg_id, int &thread_num, std::string &name, std::vector<int> &cpus)
+{
+	ThreadConfig *cfg = nullptr == cfg_set ? nullptr : cfg_set->Get(cfg_id);
+	if (nullptr == cfg)
+		return nullptr;
+	thread_num = cfg->thread_num;
+	if (!cfg->name.empty())
+		name = cfg->name;
+	cpus = cfg->cpus;
+	return cfg;
+}
+
+std::string NetworkModule::ChoseNetWorkerImpl()
+{
+#ifdef NET_WORKER_URING
+	if (NET_WORKER_IMPL_URING == m_net_worker_impl && Net::UringNetWorker::IsSupported())
+		return NET_WORKER_IMPL_URING;
+#endif
+#ifdef __linux__
+	if (NET_WORKER_IMPL_URING == m_net_worker_impl || NET_WORKER_IMPL_EPOLL == m_net_worker_impl)
+		return NET_WORKER_IMPL_EPOLL;
+#endif
+	return NET_WORKER_IMPL_LIBEVENT;
+}
+
+Net::NetWorkerBase * NetworkModule::NewNetWorker(const std::string &impl, int worker_idx)
+{
+#ifdef NET_WORKER_URING
+	if (NET_WORKER_IMPL_URING == impl)
+		return new Net::UringNetWorker(worker_idx, m_net_worker_num);
+#endif
+#ifdef __linux__
+	if (NET_WORKER_IMPL_EPOLL == impl)
+		return new Net::EpollNetWorker(worker_idx, m_net_worker_num);
+#endif
+	return new Net::NetWorker(worker_idx, m_net_worker_num);
+}
+
+void NetworkModule::CreateThreads()
+{
 	if (m_cnn_task_thread_num <= 0)
 		m_cnn_task_thread_num = 1;
 	int malloc_size = sizeof(ConnectTaskThread *) * m_cnn_task_thread_num;
@@ -115,8 +209,10 @@ NetworkModule::NetworkModule(ModuleMgr *module_mgr) : INetworkModule(module_mgr)
 	for (int i = 0; i < m_cnn_task_thread_num; ++i)
 	{
 		m_cnn_task_threads[i] = new ConnectTaskThread(
-			CnnTaskWorker, m_cnn_task_mutex, &m_cnn_tasks,
-			m_cnn_results_mutex, &m_cnn_results);
+			CnnTaskWorker, m_cnn_task_mutex, m_cnn_task_cv, &m_cnn_tasks,
+			m_cnn_results_mutex, &m_cnn_results, &m_cnn_result_num);
+		m_cnn_task_threads[i]->thread_name = m_cnn_task_thread_name + std::to_string(i);
+		m_cnn_task_threads[i]->cpus = ThreadUtil::ChoseCpus(m_cnn_task_cpus, i);
 	}
 
 	if (m_net_worker_num <= 0)
@@ -124,14 +220,20 @@ NetworkModule::NetworkModule(ModuleMgr *module_mgr) : INetworkModule(module_mgr)
 	malloc_size = sizeof(Net::INetWorker *) * m_net_worker_num;
 	m_net_workers = (Net::INetWorker **)Malloc(malloc_size);
 	memset(m_net_workers, 0, malloc_size);
+	std::string net_worker_impl = this->ChoseNetWorkerImpl();
 	for (int i = 0; i < m_net_worker_num; ++i)
 	{
-		m_net_workers[i] = new Net::NetWorker();
+		Net::NetWorkerBase *net_worker = this->NewNetWorker(net_worker_impl, i);
+		net_worker->SetThreadAttr(m_net_worker_name + std::to_string(i), ThreadUtil::ChoseCpus(m_net_worker_cpus, i));
+		net_worker->SetSendWatermark(m_send_watermark);
+		m_net_workers[i] = net_worker;
 	}
+	m_worker_send_bufs.resize(m_net_worker_num);
 }
 
 NetworkModule::~NetworkModule()
 {
+	this->FreeTickSendBuffers();
 	if (nullptr != m_cnn_task_threads)
 	{
 		for (int i = 0; i < m_cnn_task_thread_num; ++i)
@@ -151,6 +253,11 @@ NetworkModule::~NetworkModule()
 		delete 	m_cnn_task_mutex;
 		m_cnn_task_mutex = nullptr;
 	}
+	if (nullptr != m_cnn_task_cv)
+	{
+		delete m_cnn_task_cv;
+		m_cnn_task_cv = nullptr;
+	}
 	if (nullptr != m_cnn_results_mutex)
 	{
 		delete m_cnn_results_mutex;
@@ -170,11 +277,25 @@ NetworkModule::~NetworkModule()
 
 EModuleRetCode NetworkModule::Init(void *param)
 {
+	// param is the loaded Server/ThreadConfig.csv or null, a missing row keeps the defaults
+	ThreadConfigSet *thread_cfg_set = (ThreadConfigSet *)param;
+	ThreadConfig *net_worker_cfg = this->LoadThreadCfg(thread_cfg_set, EThreadCfgId_NetWorker, m_net_worker_num, m_net_worker_name, m_net_worker_cpus);
+	if (nullptr != net_worker_cfg && !net_worker_cfg->impl.empty())
+		m_net_worker_impl = net_worker_cfg->impl;
+	this->LoadThreadCfg(thread_cfg_set, EThreadCfgId_CnnTask, m_cnn_task_thread_num, m_cnn_task_thread_name, m_cnn_task_cpus);
+	this->CreateThreads();
 	return EModuleRetCode_Succ;
 }
 
 EModuleRetCode NetworkModule::Awake()
 {
+	std::string net_worker_impl = this->ChoseNetWorkerImpl();
+	auto log = m_module_mgr->GetModule<LogModule>();
+	if (net_worker_impl != m_net_worker_impl)
+		log->Warn(this->LogId(), "NetworkModule net worker io {0} is missing here, {1} is used", m_net_worker_impl, net_worker_impl);
+	else
+		log->Info(this->LogId(), "NetworkModule net worker io is {0}", net_worker_impl);
+
 	bool ret = true;
 	if (ret)
 	{
@@ -182,6 +303,7 @@ EModuleRetCode NetworkModule::Awake()
 		{
 			if (!m_net_workers[i]->Start())
 			{
+				log->Error(this->LogId(), "NetworkModule net worker {0} start fail, errno {1}", i, errno);
 				ret = false;
 				break;
 			}
@@ -206,11 +328,13 @@ EModuleRetCode NetworkModule::Update()
 {
 	this->ProcessConnectResult();
 	this->ProcessNetDatas();
+	this->CheckGlobalSendWatermark();
 	return EModuleRetCode_Succ;
 }
 
 EModuleRetCode NetworkModule::Release()
 {
+	this->FlushSends();
 	for (int i = 0; i < m_cnn_task_thread_num; ++i)
 	{
 		m_cnn_task_threads[i]->Exit();
@@ -220,7 +344,12 @@ EModuleRetCode NetworkModule::Release()
 		m_cnn_task_threads[i]->Join();
 	}
 	while (!m_cnn_results.empty())
+	{
+		if (m_cnn_results.front().fd >= 0)
+			close(m_cnn_results.front().fd);
 		m_cnn_results.pop();
+	}
+	m_cnn_result_num = 0;
 	while (!m_cnn_tasks.empty())
 	{
 		delete m_cnn_tasks.front();
@@ -237,6 +366,7 @@ EModuleRetCode NetworkModule::Destroy()
 		m_net_workers[i]->Stop();
 	}
 	m_async_network_handlers.clear();
+	this->FreeTickSendBuffers();
 
 	return EModuleRetCode_Succ;
 }
@@ -247,20 +377,29 @@ NetId NetworkModule::Listen(std::string ip, uint16_t port, void *opt, std::weak_
 	if (nullptr == sp_handler) return 0;
 
 	NetId netid = 0;
-	Net::ConnectTaskListen task(0, ip, port, opt);
-	task.Process();
-	const Net::ConnectResult &ret = task.GetResult();
-	int err_num = ret.err_num;
-	std::string err_msg = ret.err_msg;
-	if (0 == err_num)
+	int err_num = 0;
+	NetListenOpt *listen_opt = (NetListenOpt *)opt;
+#ifdef SO_REUSEPORT
+	if (nullptr != listen_opt && listen_opt->is_shard_on_workers)
 	{
-		netid = this->GenNetId();
-		if (!ChoseWorker(netid)->AddCnn(netid, ret.fd, handler))
+		netid = this->ListenShards(ip, port, opt, handler, err_num);
+	}
+	else
+#endif
+	{
+		Net::ConnectTaskListen task(0, ip, port, opt);
+		task.Process();
+		const Net::ConnectResult &ret = task.GetResult();
+		err_num = ret.err_num;
+		if (0 == err_num)
 		{
-			err_num = 1;
-			if (ret.fd >= 0)
-				close(ret.fd);
-			err_msg = "NetWorker::Add fail";
+			netid = this->GenNetId();
+			if (!ChoseWorker(netid)->AddCnn(netid, ret.fd, handler))
+			{
+				err_num = 1;
+				if (ret.fd >= 0)
+					close(ret.fd);
+			}
 		}
 	}
 
@@ -307,8 +446,58 @@ NetId NetworkModule::Connect(std::string ip, uint16_t port, void *opt, std::weak
 	return netid;
 }
 
+NetId NetworkModule::ListenShards(std::string ip, uint16_t port, void *opt, std::weak_ptr<INetListenHander> handler, int &err_num)
+{
+	// one listener on every worker, bound to the same port with SO_REUSEPORT
+	std::vector<NetId> shard_netids;
+	for (int i = 0; i < m_net_worker_num; ++i)
+	{
+		Net::ConnectTaskListen task(0, ip, port, opt);
+		task.Process();
+		const Net::ConnectResult &ret = task.GetResult();
+		err_num = ret.err_num;
+		if (0 != err_num)
+			break;
+		NetId shard_netid = m_net_workers[i]->GenNetId();
+		if (!m_net_workers[i]->AddListenShard(shard_netid, ret.fd, handler))
+		{
+			err_num = 1;
+			if (ret.fd >= 0)
+				close(ret.fd);
+			break;
+		}
+		shard_netids.push_back(shard_netid);
+	}
+	if (0 != err_num)
+	{
+		for (NetId shard_netid : shard_netids)
+			this->ChoseWorker(shard_netid)->RemoveCnn(shard_netid);
+		return 0;
+	}
+	m_listen_shard_netids[shard_netids[0]] = shard_netids;
+	return shard_netids[0];
+}
+
 void NetworkModule::Close(NetId netid)
 {
+	auto shard_it = m_listen_shard_netids.find(netid);
+	if (m_listen_shard_netids.end() != shard_it)
+	{
+		for (NetId shard_netid : shard_it->second)
+			this->ChoseWorker(shard_netid)->RemoveCnn(shard_netid);
+		m_listen_shard_netids.erase(shard_it);
+		return;
+	}
+
+	auto it = m_tick_send_bufs.find(netid);
+	if (m_tick_send_bufs.end() != it)
+	{
+		if (m_reserved_send_buf == &it->second)
+			m_reserved_send_buf = nullptr;
+		evbuffer_free(it->second.buffer);
+		m_tick_send_bufs.erase(it);
+	}
+	m_cnn_rtts.erase(netid);
 	this->ChoseWorker(netid)->RemoveCnn(netid);
 }
 
@@ -323,6 +512,7 @@ int64_t NetworkModule::ListenAsync(std::string ip, uint16_t port, void *opt, std
 	m_cnn_task_mutex->lock();
 	m_cnn_tasks.push(task);
 	m_cnn_task_mutex->unlock();
+	m_cnn_task_cv->notify_one();
 	return async_id;
 }
 
@@ -337,6 +527,7 @@ int64_t NetworkModule::ConnectAsync(std::string ip, uint16_t port, void *opt, st
 	m_cnn_task_mutex->lock();
 	m_cnn_tasks.push(task);
 	m_cnn_task_mutex->unlock();
+	m_cnn_task_cv->notify_one();
 	return async_id;
 }
 
@@ -349,33 +540,326 @@ bool NetworkModule::Send(NetId netId, char *buffer, uint32_t len)
 {
 	if (netId <= 0 || nullptr == buffer || len <= 0)
 		return false;
-	return this->ChoseWorker(netId)->Send(netId, buffer, len);
+	NetSendBuffer *buf = this->GetTickSendBuffer(netId);
+	if (nullptr == buf || 0 != evbuffer_add(buf->buffer, buffer, len))
+		return false;
+	++buf->msg_num;
+	return true;
+}
+
+char * NetworkModule::ReserveSend(NetId netid, uint32_t len)
+{
+	m_reserved_send_buf = nullptr;
+	m_reserved_send_ptr = nullptr;
+	if (netid <= 0 || len <= 0)
+		return nullptr;
+	NetSendBuffer *buf = this->GetTickSendBuffer(netid);
+	if (nullptr == buf)
+		return nullptr;
+
+	// one iovec, so the space is contiguous
+	evbuffer_iovec iovec;
+	if (1 != evbuffer_reserve_space(buf->buffer, len, &iovec, 1))
+		return nullptr;
+	m_reserved_send_netid = netid;
+	m_reserved_send_buf = buf;
+	m_reserved_send_ptr = (char *)iovec.iov_base;
+	m_reserved_send_len = len;
+	return m_reserved_send_ptr;
+}
+
+bool NetworkModule::CommitSend(NetId netid, uint32_t len)
+{
+	if (nullptr == m_reserved_send_buf || netid != m_reserved_send_netid || len > m_reserved_send_len)
+		return false;
+
+	evbuffer_iovec iovec;
+	iovec.iov_base = m_reserved_send_ptr;
+	iovec.iov_len = len;
+	bool ret = 0 == evbuffer_commit_space(m_reserved_send_buf->buffer, &iovec, 1);
+	if (ret)
+		++m_reserved_send_buf->msg_num;
+	m_reserved_send_buf = nullptr;
+	m_reserved_send_ptr = nullptr;
+	return ret;
+}
+
+char * NetworkModule::ReserveMulticast(uint32_t len)
+{
+	this->ReleaseReservedMulticast();
+	if (len <= 0)
+		return nullptr;
+	m_reserved_multicast_buf = NetSharedBuffer::Create(len);
+	if (nullptr == m_reserved_multicast_buf)
+		return nullptr;
+	return m_reserved_multicast_buf->Data();
+}
+
+bool NetworkModule::CommitMulticast(NetId *netids, uint32_t netid_num, uint32_t len)
+{
+	NetSharedBuffer *shared_buf = m_reserved_multicast_buf;
+	if (nullptr == shared_buf || len <= 0 || len > shared_buf->len)
+	{
+		this->ReleaseReservedMulticast();
+		return false;
+	}
+
+	// a reference costs a chain per receiver, only worth it over copying for big content
+	bool is_by_ref = len >= MULTICAST_REFERENCE_MIN_LEN;
+	bool ret = true;
+	for (uint32_t i = 0; nullptr != netids && i < netid_num; ++i)
+	{
+		if (netids[i] <= 0)
+			continue;
+		NetSendBuffer *buf = this->GetTickSendBuffer(netids[i]);
+		if (nullptr == buf)
+		{
+			ret = false;
+			continue;
+		}
+		if (!is_by_ref)
+		{
+			if (0 == evbuffer_add(buf->buffer, shared_buf->Data(), len))
+				++buf->msg_num;
+			else
+				ret = false;
+			continue;
+		}
+		++shared_buf->ref_num;
+		if (0 != evbuffer_add_reference(buf->buffer, shared_buf->Data(), len, NetSharedBuffer::OnRefCleanup, shared_buf))
+		{
+			--shared_buf->ref_num;
+			ret = false;
+			continue;
+		}
+		++buf->msg_num;
+	}
+	// drops the reference held since ReserveMulticast, the receivers keep the rest
+	this->ReleaseReservedMulticast();
+	return ret;
+}
+
+void NetworkModule::ReleaseReservedMulticast()
+{
+	if (nullptr == m_reserved_multicast_buf)
+		return;
+	NetSharedBuffer::Release(m_reserved_multicast_buf);
+	m_reserved_multicast_buf = nullptr;
+}
+
+void NetworkModule::FlushSends()
+{
+	m_reserved_send_buf = nullptr;
+	m_reserved_send_ptr = nullptr;
+	this->ReleaseReservedMulticast();
+	for (auto it = m_tick_send_bufs.begin(); it != m_tick_send_bufs.end(); )
+	{
+		// a connection silent for a whole tick gives its buffer back
+		if (evbuffer_get_length(it->second.buffer) <= 0)
+		{
+			evbuffer_free(it->second.buffer);
+			it = m_tick_send_bufs.erase(it);
+			continue;
+		}
+		m_worker_send_bufs[this->ChoseWorkerIdx(it->first)].push_back(it->second);
+		++it;
+	}
+	for (int i = 0; i < m_net_worker_num; ++i)
+	{
+		std::vector<NetSendBuffer> &send_bufs = m_worker_send_bufs[i];
+		if (send_bufs.empty())
+			continue;
+		uint32_t taken_num = m_net_workers[i]->SendBuffers(send_bufs.data(), (uint32_t)send_bufs.size());
+		for (uint32_t k = 0; k < taken_num; ++k)
+			m_tick_send_bufs.erase(send_bufs[k].netid);
+		send_bufs.clear();
+	}
+}
+
+void NetworkModule::GetQueueStats(std::vector<NetQueueStat> &stats)
+{
+	stats.resize(m_net_worker_num);
+	for (int i = 0; i < m_net_worker_num; ++i)
+		m_net_workers[i]->GetQueueStat(stats[i]);
+}
+
+void NetworkModule::SetSendWatermark(const NetSendWatermarkOpt &opt)
+{
+	m_send_watermark = opt;
+	if (nullptr == m_net_workers)
+		return;
+	for (int i = 0; i < m_net_worker_num; ++i)
+		m_net_workers[i]->SetSendWatermark(opt);
+}
+
+void NetworkModule::GetSendStat(NetSendStat &stat)
+{
+	stat = NetSendStat();
+	for (int i = 0; i < m_net_worker_num && nullptr != m_net_workers; ++i)
+		m_net_workers[i]->AddSendStat(stat);
+	stat.global_high_num = m_global_send_high_num;
+	stat.global_low_num = m_global_send_low_num;
+}
+
+bool NetworkModule::GetCnnStat(NetId netid, NetCnnStat &stat)
+{
+	stat = NetCnnStat();
+	if (netid <= 0 || nullptr == m_net_workers || !this->ChoseWorker(netid)->GetCnnStat(netid, stat))
+		return false;
+	this->FillRtt(stat);
+	return true;
+}
+
+void NetworkModule::GetCnnStats(std::vector<NetCnnStat> &stats)
+{
+	stats.clear();
+	for (int i = 0; i < m_net_worker_num && nullptr != m_net_workers; ++i)
+		m_net_workers[i]->GetCnnStats(stats);
+	for (NetCnnStat &stat : stats)
+		this->FillRtt(stat);
+}
+
+void NetworkModule::GetWorkerStats(std::vector<NetWorkerStat> &stats)
+{
+	stats.clear();
+	if (nullptr == m_net_workers)
+		return;
+	stats.resize(m_net_worker_num);
+	std::vector<uint64_t> rtt_sums(m_net_worker_num, 0);
+	std::vector<uint32_t> rtt_cnn_nums(m_net_worker_num, 0);
+	for (int i = 0; i < m_net_worker_num; ++i)
+		m_net_workers[i]->GetWorkerStat(stats[i]);
+	for (auto &kv_pair : m_cnn_rtts)
+	{
+		int worker_idx = this->ChoseWorkerIdx(kv_pair.first);
+		const CnnRtt &rtt = kv_pair.second;
+		rtt_sums[worker_idx] += rtt.avg_us;
+		++rtt_cnn_nums[worker_idx];
+		if (rtt.max_us > stats[worker_idx].rtt_max_us)
+		{
+			stats[worker_idx].rtt_max_us = rtt.max_us;
+			stats[worker_idx].rtt_max_netid = kv_pair.first;
+		}
+	}
+	for (int i = 0; i < m_net_worker_num; ++i)
+	{
+		if (rtt_cnn_nums[i] > 0)
+			stats[i].rtt_avg_us = (uint32_t)(rtt_sums[i] / rtt_cnn_nums[i]);
+	}
+}
+
+void NetworkModule::AddRttSample(NetId netid, uint32_t rtt_us)
+{
+	if (netid <= 0)
+		return;
+	CnnRtt &rtt = m_cnn_rtts[netid];
+	rtt.rtt_us = rtt_us;
+	if (0 == rtt.sample_num)
+		rtt.avg_us = rtt_us;
+	else
+		rtt.avg_us = (uint32_t)(((uint64_t)rtt.avg_us * 7 + rtt_us) / 8);
+	if (rtt_us > rtt.max_us)
+		rtt.max_us = rtt_us;
+	++rtt.sample_num;
+}
+
+void NetworkModule::FillRtt(NetCnnStat &stat)
+{
+	auto it = m_cnn_rtts.find(stat.netid);
+	if (m_cnn_rtts.end() == it)
+		return;
+	stat.rtt_us = it->second.rtt_us;
+	stat.rtt_avg_us = it->second.avg_us;
+	stat.rtt_max_us = it->second.max_us;
+	stat.rtt_sample_num = it->second.sample_num;
+}
+
+void NetworkModule::CheckGlobalSendWatermark()
+{
+	if (m_send_watermark.global_high_bytes <= 0)
+		return;
+	uint64_t send_bytes = 0;
+	for (int i = 0; i < m_net_worker_num; ++i)
+		send_bytes += m_net_workers[i]->SendBytes();
+
+	bool is_cross = false;
+	if (!m_is_global_send_high && send_bytes >= m_send_watermark.global_high_bytes)
+	{
+		is_cross = true;
+		m_is_global_send_high = true;
+		++m_global_send_high_num;
+	}
+	else if (m_is_global_send_high && send_bytes <= m_send_watermark.global_low_bytes)
+	{
+		is_cross = true;
+		m_is_global_send_high = false;
+		++m_global_send_low_num;
+	}
+	if (!is_cross)
+		return;
+	auto log = m_module_mgr->GetModule<LogModule>();
+	log->Warn(this->LogId(), "NetworkModule send bytes {0} {1} the global watermark", send_bytes, m_is_global_send_high ? "over" : "back under");
+	if (nullptr != m_send_watermark.on_global_watermark)
+		m_send_watermark.on_global_watermark(m_is_global_send_high, send_bytes);
+}
+
+NetSendBuffer * NetworkModule::GetTickSendBuffer(NetId netid)
+{
+	auto it = m_tick_send_bufs.find(netid);
+	if (m_tick_send_bufs.end() != it)
+		return &it->second;
+	evbuffer *buf = evbuffer_new();
+	if (nullptr == buf)
+		return nullptr;
+	// the map keeps its elements in place, the pointer is good until the netid leaves it
+	NetSendBuffer &send_buf = m_tick_send_bufs[netid];
+	send_buf.netid = netid;
+	send_buf.buffer = buf;
+	return &send_buf;
+}
+
+void NetworkModule::FreeTickSendBuffers()
+{
+	this->ReleaseReservedMulticast();
+	for (auto kv_pair : m_tick_send_bufs)
+		evbuffer_free(kv_pair.second.buffer);
+	m_tick_send_bufs.clear();
+	m_reserved_send_buf = nullptr;
+	m_reserved_send_ptr = nullptr;
 }
 
 NetId NetworkModule::GenNetId()
 {
+	// every worker numbers its own netids, so a sharded listener can name the connections it accepts by itself
 	++ m_last_netid;
-	if (m_last_netid <= 0) m_last_netid = 1;
-	return m_last_netid;
+	return m_net_workers[m_last_netid % m_net_worker_num]->GenNetId();
 }
 
 int64_t NetworkModule::GenAsyncId()
 {
 	++ m_last_async_id;
-	if (m_last_netid <= 0) m_last_async_id = 1;
+	if (m_last_async_id <= 0) m_last_async_id = 1;
 	return m_last_async_id;
 }
 
 Net::INetWorker * NetworkModule::ChoseWorker(NetId netid)
 {
-	return m_net_workers[netid % m_net_worker_num];
+	return m_net_workers[this->ChoseWorkerIdx(netid)];
+}
+
+int NetworkModule::ChoseWorkerIdx(NetId netid)
+{
+	return (int)(netid % m_net_worker_num);
 }
 
 void NetworkModule::ProcessConnectResult()
 {
+	if (0 == m_cnn_result_num.load(std::memory_order_relaxed))
+		return;
 	std::queue<Net::ConnectResult, std::deque<Net::ConnectResult, StlAllocator<Net::ConnectResult>>> cnn_results_swap;
 	m_cnn_results_mutex->lock();
 	cnn_results_swap.swap(m_cnn_results);
+	m_cnn_result_num = 0;
 	m_cnn_results_mutex->unlock();
 	if (cnn_results_swap.empty())
 		return;
@@ -417,65 +901,151 @@ void NetworkModule::ProcessConnectResult()
 	}
 }
 
+// every segment of the buffer goes to the handler as it is, so a message is copied only when it straddles two of them
+static void DeliverRecvBuffer(INetConnectHander *handler, evbuffer *buffer)
+{
+	const int IOVEC_NUM = 8;
+	evbuffer_iovec iovecs[IOVEC_NUM];
+	while (evbuffer_get_length(buffer) > 0)
+	{
+		int iovec_num = evbuffer_peek(buffer, -1, nullptr, iovecs, IOVEC_NUM);
+		if (iovec_num > IOVEC_NUM)
+			iovec_num = IOVEC_NUM;
+		size_t deliver_len = 0;
+		for (int i = 0; i < iovec_num; ++i)
+		{
+			handler->OnRecvData((char *)iovecs[i].iov_base, (uint32_t)iovecs[i].iov_len);
+			deliver_len += iovecs[i].iov_len;
+		}
+		evbuffer_drain(buffer, deliver_len);
+	}
+}
+
+// messages split by the net worker, whose heads were checked there already. 
+// messages inside one segment are handed out in place, only one straddling two segments is pulled up into one
+static void DeliverRecvMsgs(INetConnectHander *handler, INetFramer *framer, evbuffer *buffer, uint32_t msg_num)
+{
+	uint32_t head_len = framer->LenDescriptSize();
+	char head[INetFramer::MAX_LEN_DESCRIPT_SIZE];
+	while (msg_num > 0)
+	{
+		evbuffer_iovec iovec;
+		if (evbuffer_peek(buffer, -1, nullptr, &iovec, 1) <= 0)
+			break;
+		char *segment = (char *)iovec.iov_base;
+		size_t used_len = 0;
+		while (msg_num > 0 && iovec.iov_len - used_len >= head_len)
+		{
+			uint32_t content_len = framer->ParseContentLen(segment + used_len);
+			if (iovec.iov_len - used_len < head_len + content_len)
+				break;
+			handler->OnRecvMsg(segment + used_len + head_len, content_len);
+			used_len += head_len + content_len;
+			--msg_num;
+		}
+		if (used_len > 0)
+		{
+			evbuffer_drain(buffer, used_len);
+			continue;
+		}
+
+		if (evbuffer_copyout(buffer, head, head_len) != (ev_ssize_t)head_len)
+			break;
+		uint32_t msg_len = head_len + framer->ParseContentLen(head);
+		char *msg = (char *)evbuffer_pullup(buffer, msg_len);
+		if (nullptr == msg)
+			break;
+		handler->OnRecvMsg(msg + head_len, msg_len - head_len);
+		evbuffer_drain(buffer, msg_len);
+		--msg_num;
+	}
+}
+
 void NetworkModule::ProcessNetDatas()
 {
+	NetWorkData data;
 	for (int i = 0; i < m_net_worker_num; ++i)
 	{
-		std::set<NetId, std::less<NetId>, StlAllocator<NetId>> to_remove_netids;
-		std::queue<NetWorkData, std::deque<NetWorkData, StlAllocator<NetWorkData>>> *net_datas = nullptr;
-		if (m_net_workers[i]->GetNetDatas(net_datas))
+		m_expired_netids.clear();
+		Net::INetWorker *net_worker = m_net_workers[i];
+		// what arrives while handling is left for the next tick
+		uint32_t data_num = net_worker->NetDataNum();
+		for (uint32_t k = 0; k < data_num && net_worker->PopNetData(data); ++k)
 		{
-			while (!net_datas->empty())
+			std::shared_ptr<INetworkHandler> handler = data.handler.lock();
+			if (nullptr == handler)
+			{
+				m_expired_netids.push_back(data.netid);
+			}
+			else if (ENetworkHandler_Connect == handler->HandlerType())
 			{
-				NetWorkData &data = net_datas->front();
-				std::shared_ptr<INetworkHandler> handler = data.handler.lock();
-				if (nullptr == handler)
+				// the handler type is the tag of the concrete handler interface
+				INetConnectHander *cnn_handler = static_cast<INetConnectHander *>(handler.get());
+				if (ENetWorkDataAction_Close == data.action)
 				{
-					to_remove_netids.insert(data.netid);
+					m_cnn_rtts.erase(data.netid);
+					cnn_handler->OnClose(data.err_num);
 				}
-				else
+				if (ENetWorkDataAction_Read == data.action && nullptr != data.recv_buffer)
+				{
+					std::shared_ptr<INetFramer> framer = data.msg_num > 0 ? cnn_handler->GetFramer() : nullptr;
+					if (nullptr != framer)
+						DeliverRecvMsgs(cnn_handler, framer.get(), data.recv_buffer, data.msg_num);
+					else
+						DeliverRecvBuffer(cnn_handler, data.recv_buffer);
+				}
+				if (ENetWorkDataAction_FrameFail == data.action)
+					cnn_handler->OnFrameFail();
+				if (ENetWorkDataAction_SendHigh == data.action || ENetWorkDataAction_SendLow == data.action)
+					cnn_handler->OnSendWatermark(ENetWorkDataAction_SendHigh == data.action);
+			}
+			else if (ENetworkHandler_Listen == handler->HandlerType())
+			{
+				INetListenHander *listen_handler = static_cast<INetListenHander *>(handler.get());
+				if (ENetWorkDataAction_Close == data.action)
+					listen_handler->OnClose(data.err_num);
+				if (ENetWorkDataAction_Accept == data.action)
 				{
-					if (ENetworkHandler_Connect == handler->HandlerType())
+					// set up on its worker already, it only lacks the handler. GenConnectorHandler builds logic objects, so it stays here
+					std::shared_ptr<INetConnectHander> new_handler = listen_handler->GenConnectorHandler(data.netid);
+					if (nullptr == new_handler)
 					{
-						std::shared_ptr<INetConnectHander> tmp_handler = std::dynamic_pointer_cast<INetConnectHander>(handler);
-						if (ENetWorkDataAction_Close == data.action)
-							tmp_handler->OnClose(data.err_num);
-						if (ENetWorkDataAction_Read == data.action)
-						{
-							tmp_handler->OnRecvData(data.binary, data.binary_len);
-							Free(data.binary); data.binary = nullptr; 
-							data.binary_len = 0;
-						}
+						net_worker->RemoveCnn(data.netid);
 					}
-					if (ENetworkHandler_Listen == handler->HandlerType())
+					else
 					{
-						std::shared_ptr<INetListenHander> tmp_handler = std::dynamic_pointer_cast<INetListenHander>(handler);
-						if (ENetWorkDataAction_Close == data.action)
-							tmp_handler->OnClose(data.err_num);
-						if (ENetWorkDataAction_Read == data.action)
-						{
-							NetId netid = this->GenNetId();
-							std::shared_ptr<INetConnectHander> new_handler = tmp_handler->GenConnectorHandler(netid);
-							int err_num = 0;
-							if (nullptr == new_handler || 
-								!ChoseWorker(netid)->AddCnn(netid, data.new_fd, new_handler))
-								err_num = 1;
-							if (nullptr != new_handler)
-								new_handler->OnOpen(err_num);
-							if (0 != err_num)
-							{
-								if (data.new_fd >= 0)
-									close(data.new_fd);
-							}
-						}
+						net_worker->BindCnn(data.netid, new_handler);
+						new_handler->OnOpen(0);
 					}
 				}
-				net_datas->pop();
+				if (ENetWorkDataAction_Read == data.action)
+				{
+					NetId netid = this->GenNetId();
+					std::shared_ptr<INetConnectHander> new_handler = listen_handler->GenConnectorHandler(netid);
+					int err_num = 0;
+					if (nullptr == new_handler || 
+						!ChoseWorker(netid)->AddCnn(netid, data.new_fd, new_handler))
+						err_num = 1;
+					if (nullptr != new_handler)
+						new_handler->OnOpen(err_num);
+					if (0 != err_num)
+					{
+						if (data.new_fd >= 0)
+							close(data.new_fd);
+					}
+				}
+			}
+			if (nullptr != data.recv_buffer)
+			{
+				evbuffer_free(data.recv_buffer);
+				data.recv_buffer = nullptr;
 			}
+			data.handler.reset();
 		}
-		for (NetId netid : to_remove_netids)
+		for (NetId netid : m_expired_netids)
 		{
-			m_net_workers[i]->RemoveCnn(netid);
+			m_cnn_rtts.erase(netid);
+			net_worker->RemoveCnn(netid);
 		}
 	}
 }
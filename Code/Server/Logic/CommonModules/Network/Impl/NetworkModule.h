@@ -4,22 +4,39 @@
 #include <queue>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <unordered_map>
+#include <vector>
 #include "CommonModules/Network/INetworkModule.h"
 #include "NetConnectTask.h"
 #include "Common/Macro/MemoryPoolMacro.h"
 #include "MemoryPool/StlAllocator.h"
 
 struct ConnectTaskThread;
+struct NetSharedBuffer;
+struct evbuffer;
 namespace Net
 {
 	class INetWorker;
+	class NetWorkerBase;
 }
+struct ThreadConfig;
+struct ThreadConfigSet;
+
+// the io of the net workers, as named by the impl column of the net worker row of Server/ThreadConfig.csv
+#define NET_WORKER_IMPL_LIBEVENT "libevent"
+#define NET_WORKER_IMPL_EPOLL "epoll"
+#define NET_WORKER_IMPL_URING "io_uring"
 
 enum ENetWorkDataAction
 {
 	ENetWorkDataAction_Read = 0,
 	ENetWorkDataAction_Close,
+	ENetWorkDataAction_FrameFail, // the framer of the connection met a malformed head
+	ENetWorkDataAction_Accept, // a sharded listener set up connection netid on its own worker, it waits for BindCnn
+	ENetWorkDataAction_SendHigh, // the send watermarks of the connection were crossed, see NetSendWatermarkOpt
+	ENetWorkDataAction_SendLow,
 	ENetWorkDataAction_Max,
 };
 
@@ -29,17 +46,26 @@ struct NetWorkData
 
 	NetWorkData() {}
 	NetWorkData(NetId _netid, int _fd, std::weak_ptr<INetworkHandler> _handle, 
-		ENetWorkDataAction _action, int _err_num, int _new_fd, char *_binary, uint32_t _binary_len) 
+		ENetWorkDataAction _action, int _err_num, int _new_fd, evbuffer *_recv_buffer) 
 		: netid(_netid), fd(_fd), handler(_handle), action(_action), err_num(_err_num), 
-		new_fd(_new_fd), binary(_binary), binary_len(_binary_len) {}
+		new_fd(_new_fd), recv_buffer(_recv_buffer) {}
 	NetId netid = 0;
 	int fd = -1;
 	std::weak_ptr<INetworkHandler> handler;
 	ENetWorkDataAction action = ENetWorkDataAction_Max;
 	int err_num = 0;
 	int new_fd = -1;
-	char *binary = nullptr;
-	uint32_t binary_len = 0;
+	// chains moved out of the bufferevent input without copying, freed by whoever pops the data
+	evbuffer *recv_buffer = nullptr;
+	uint32_t msg_num = 0; // > 0 if recv_buffer holds that many whole messages split by the framer of the connection
+};
+
+// what a connection was sent during a tick, handed to its worker by FlushSends
+struct NetSendBuffer
+{
+	NetId netid = 0;
+	evbuffer *buffer = nullptr;
+	uint32_t msg_num = 0;
 };
 
 class NetworkModule : public INetworkModule
@@ -61,16 +87,35 @@ public:
 	virtual int64_t ConnectAsync(std::string ip, uint16_t port, void *opt, std::weak_ptr<INetConnectHander> handler);
 	virtual void CancelAsync(uint64_t async_id);
 	virtual bool Send(NetId netId, char *buffer, uint32_t len);
+	virtual char * ReserveSend(NetId netid, uint32_t len);
+	virtual bool CommitSend(NetId netid, uint32_t len);
+	virtual char * ReserveMulticast(uint32_t len);
+	virtual bool CommitMulticast(NetId *netids, uint32_t netid_num, uint32_t len);
+	virtual void FlushSends();
+	virtual void GetQueueStats(std::vector<NetQueueStat> &stats);
+	virtual void SetSendWatermark(const NetSendWatermarkOpt &opt);
+	virtual void GetSendStat(NetSendStat &stat);
+	virtual bool GetCnnStat(NetId netid, NetCnnStat &stat);
+	virtual void GetCnnStats(std::vector<NetCnnStat> &stats);
+	virtual void GetWorkerStats(std::vector<NetWorkerStat> &stats);
+	virtual void AddRttSample(NetId netid, uint32_t rtt_us);
 	int LogId() { return m_log_Id; }
 
 protected:
 	std::mutex *m_cnn_task_mutex = nullptr;
+	std::condition_variable *m_cnn_task_cv = nullptr; // idle connect task threads wait on it for a task or the exit
 	std::queue<Net::ConnectTask *, std::deque<Net::ConnectTask *, StlAllocator<Net::ConnectTask *>>> m_cnn_tasks;
 	std::mutex *m_cnn_results_mutex = nullptr;
 	std::queue<Net::ConnectResult, std::deque<Net::ConnectResult, StlAllocator<Net::ConnectResult>>> m_cnn_results;
+	std::atomic<uint32_t> m_cnn_result_num; // lets the ticks without results skip the lock
 	int m_cnn_task_thread_num = 2;
+	std::string m_cnn_task_thread_name = "cnn_task";
+	std::vector<int> m_cnn_task_cpus;
 	ConnectTaskThread **m_cnn_task_threads = nullptr;
 	void ProcessConnectResult();
+	// counts, names and cpus of the threads, from the Server/ThreadConfig.csv rows if there are. returns the row or null
+	ThreadConfig * LoadThreadCfg(ThreadConfigSet *cfg_set, int cfg_id, int &thread_num, std::string &name, std::vector<int> &cpus);
+	void CreateThreads();
 
 protected:
 	std::unordered_map<int64_t, std::weak_ptr<INetworkHandler>> m_async_network_handlers;
@@ -82,7 +127,53 @@ protected:
 
 protected:
 	int m_net_worker_num = 2;
+	std::string m_net_worker_name = "net_worker";
+	std::vector<int> m_net_worker_cpus;
 	Net::INetWorker **m_net_workers = nullptr;
+	// where the configured io is missing, io_uring falls back to epoll and epoll to libevent
+	std::string m_net_worker_impl = NET_WORKER_IMPL_LIBEVENT;
+	std::string ChoseNetWorkerImpl();
+	Net::NetWorkerBase * NewNetWorker(const std::string &impl, int worker_idx);
 	Net::INetWorker * ChoseWorker(NetId netid);
+	// the netids of the listeners behind a sharded Listen, by the netid Listen returned
+	std::unordered_map<NetId, std::vector<NetId>> m_listen_shard_netids;
+	NetId ListenShards(std::string ip, uint16_t port, void *opt, std::weak_ptr<INetListenHander> handler, int &err_num);
+	int ChoseWorkerIdx(NetId netid);
 	void ProcessNetDatas();
+	std::vector<NetId> m_expired_netids; // connections whose handler is gone, reused by ProcessNetDatas
+
+protected:
+	// logic thread only, so a send costs no lock until FlushSends hands a whole tick to each worker at once.
+	// a buffer taken by its worker leaves the map, one the worker's ring had no room for stays for the next tick
+	std::unordered_map<NetId, NetSendBuffer> m_tick_send_bufs;
+	std::vector<std::vector<NetSendBuffer>> m_worker_send_bufs; // grouped by worker in FlushSends, reused every tick
+	NetSendBuffer * GetTickSendBuffer(NetId netid);
+	void FreeTickSendBuffers();
+	NetId m_reserved_send_netid = 0;
+	NetSendBuffer *m_reserved_send_buf = nullptr;
+	char *m_reserved_send_ptr = nullptr;
+	uint32_t m_reserved_send_len = 0;
+	NetSharedBuffer *m_reserved_multicast_buf = nullptr;
+	static const uint32_t MULTICAST_REFERENCE_MIN_LEN = 1024;
+	void ReleaseReservedMulticast();
+
+protected:
+	// the per connection watermarks are watched by the net workers, the global one here once a tick
+	NetSendWatermarkOpt m_send_watermark;
+	bool m_is_global_send_high = false;
+	uint64_t m_global_send_high_num = 0;
+	uint64_t m_global_send_low_num = 0;
+	void CheckGlobalSendWatermark();
+
+protected:
+	// the round trip times are only known on the logic thread, the rest of NetCnnStat comes from the workers
+	struct CnnRtt
+	{
+		uint32_t rtt_us = 0;
+		uint32_t avg_us = 0;
+		uint32_t max_us = 0;
+		uint32_t sample_num = 0;
+	};
+	std::unordered_map<NetId, CnnRtt> m_cnn_rtts;
+	void FillRtt(NetCnnStat &stat);
 };
@@ -0,0 +1,615 @@
+#include "UringNetWorker.h"
+
+#ifdef NET_WORKER_URING
+
+#include "event2/event.h"
+#include "event2/buffer.h"
+#include "Common/Utils/MemoryUtil.h"
+#include "Utils/ThreadUtil.h"
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+
+namespace Net
+{
+	NewDelOperaImplement(UringNetWorker);
+	NewDelOperaImplement(UringNetWorker::UringCnnData);
+
+	// there is no liburing to link, the three calls are made directly
+	static int UringSetup(unsigned entries, io_uring_params *params)
+	{
+		return (int)syscall(__NR_io_uring_setup, entries, params);
+	}
+
+	static int UringEnter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags, void *arg, size_t arg_size)
+	{
+		return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, arg_size);
+	}
+
+	static int UringRegister(int ring_fd, unsigned opcode, void *arg, unsigned arg_num)
+	{
+		return (int)syscall(__NR_io_uring_register, ring_fd, opcode, arg, arg_num);
+	}
+
+	static bool ProbeUring()
+	{
+		// multishot recv came last, with linux 6.0
+		utsname name;
+		if (0 != uname(&name))
+			return false;
+		int major = 0, minor = 0;
+		if (2 != sscanf(name.release, "%d.%d", &major, &minor) || major < 6)
+			return false;
+
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		int ring_fd = UringSetup(8, &params);
+		if (ring_fd < 0)
+			return false;
+		bool ret = 0 != (params.features & IORING_FEAT_NODROP) && 0 != (params.features & IORING_FEAT_EXT_ARG);
+		if (ret)
+		{
+			const int probe_op_num = 256;
+			size_t probe_size = sizeof(io_uring_probe) + probe_op_num * sizeof(io_uring_probe_op);
+			io_uring_probe *probe = (io_uring_probe *)calloc(1, probe_size);
+			ret = nullptr != probe && UringRegister(ring_fd, IORING_REGISTER_PROBE, probe, probe_op_num) >= 0;
+			const int need_ops[] = { IORING_OP_RECV, IORING_OP_SENDMSG, IORING_OP_ACCEPT, IORING_OP_READ, IORING_OP_ASYNC_CANCEL };
+			for (int op : need_ops)
+			{
+				if (!ret)
+					break;
+				ret = op <= probe->last_op && 0 != (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+			}
+			free(probe);
+		}
+		close(ring_fd);
+		return ret;
+	}
+
+	bool UringNetWorker::IsSupported()
+	{
+		static const bool is_supported = ProbeUring();
+		return is_supported;
+	}
+
+	UringNetWorker::UringNetWorker(int worker_idx, int worker_num) : NetWorkerBase(worker_idx, worker_num)
+	{
+	}
+
+	UringNetWorker::~UringNetWorker()
+	{
+		this->FreeRing();
+	}
+
+	UringNetWorker::UringCnnData::~UringCnnData()
+	{
+		if (nullptr != input)
+		{
+			evbuffer_free(input);
+			input = nullptr;
+		}
+		if (nullptr != output)
+		{
+			evbuffer_free(output);
+			output = nullptr;
+		}
+	}
+
+	bool UringNetWorker::Start()
+	{
+		if (m_is_done)
+			return false;
+		if (m_is_runing)
+			return true;
+		if (m_ring_fd < 0 && !this->SetupRing())
+			return false;
+		if (!NetWorkerBase::Start())
+		{
+			this->FreeRing();
+			return false;
+		}
+		return true;
+	}
+
+	bool UringNetWorker::SetupRing()
+	{
+		// created disabled, so the loop thread enabling it is its only submitter
+		io_uring_params params;
+		unsigned flags_list[] = {
+			IORING_SETUP_CQSIZE | IORING_SETUP_R_DISABLED | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN,
+			IORING_SETUP_CQSIZE | IORING_SETUP_R_DISABLED,
+		};
+		for (unsigned flags : flags_list)
+		{
+			memset(&params, 0, sizeof(params));
+			params.flags = flags;
+			params.cq_entries = CQ_ENTRIES;
+			m_ring_fd = UringSetup(SQ_ENTRIES, &params);
+			if (m_ring_fd >= 0)
+				break;
+		}
+		if (m_ring_fd < 0)
+			return false;
+
+		bool ret = false;
+		do
+		{
+			m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+			m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+			bool is_single_mmap = 0 != (params.features & IORING_FEAT_SINGLE_MMAP);
+			if (is_single_mmap)
+			{
+				if (m_cq_ring_size > m_sq_ring_size)
+					m_sq_ring_size = m_cq_ring_size;
+				m_cq_ring_size = m_sq_ring_size;
+			}
+			void *sq_ptr = mmap(nullptr, m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQ_RING);
+			if (MAP_FAILED == sq_ptr)
+				break;
+			m_sq_ring_ptr = sq_ptr;
+			if (is_single_mmap)
+			{
+				m_cq_ring_ptr = m_sq_ring_ptr;
+			}
+			else
+			{
+				void *cq_ptr = mmap(nullptr, m_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_CQ_RING);
+				if (MAP_FAILED == cq_ptr)
+					break;
+				m_cq_ring_ptr = cq_ptr;
+			}
+			m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+			void *sqes_ptr = mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQES);
+			if (MAP_FAILED == sqes_ptr)
+				break;
+			m_sqes = (io_uring_sqe *)sqes_ptr;
+
+			char *sq_base = (char *)m_sq_ring_ptr;
+			m_sq_head = (unsigned *)(sq_base + params.sq_off.head);
+			m_sq_tail = (unsigned *)(sq_base + params.sq_off.tail);
+			m_sq_mask = *(unsigned *)(sq_base + params.sq_off.ring_mask);
+			m_sq_entries = params.sq_entries;
+			m_sq_local_tail = *m_sq_tail;
+			// the sqes are used in ring order, the index array never changes
+			unsigned *sq_array = (unsigned *)(sq_base + params.sq_off.array);
+			for (unsigned i = 0; i < params.sq_entries; ++i)
+				sq_array[i] = i;
+			char *cq_base = (char *)m_cq_ring_ptr;
+			m_cq_head = (unsigned *)(cq_base + params.cq_off.head);
+			m_cq_tail = (unsigned *)(cq_base + params.cq_off.tail);
+			m_cq_mask = *(unsigned *)(cq_base + params.cq_off.ring_mask);
+			m_cqes = (io_uring_cqe *)(cq_base + params.cq_off.cqes);
+
+			void *buf_ring_ptr = mmap(nullptr, BUF_NUM * sizeof(io_uring_buf), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (MAP_FAILED == buf_ring_ptr)
+				break;
+			m_buf_ring = (io_uring_buf_ring *)buf_ring_ptr;
+			void *bufs_ptr = mmap(nullptr, (size_t)BUF_NUM * BUF_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (MAP_FAILED == bufs_ptr)
+				break;
+			m_bufs = (char *)bufs_ptr;
+			io_uring_buf_reg buf_reg;
+			memset(&buf_reg, 0, sizeof(buf_reg));
+			buf_reg.ring_addr = (uint64_t)m_buf_ring;
+			buf_reg.ring_entries = BUF_NUM;
+			buf_reg.bgid = BUF_GROUP_ID;
+			if (0 != UringRegister(m_ring_fd, IORING_REGISTER_PBUF_RING, &buf_reg, 1))
+				break;
+			m_buf_tail = 0;
+			for (uint32_t i = 0; i < BUF_NUM; ++i)
+				this->RecycleBuffer((uint16_t)i);
+			__atomic_store_n(&m_buf_ring->tail, m_buf_tail, __ATOMIC_RELEASE);
+			ret = true;
+		} while (false);
+
+		if (!ret)
+			this->FreeRing();
+		return ret;
+	}
+
+	bool UringNetWorker::EnableRing()
+	{
+		return 0 == UringRegister(m_ring_fd, IORING_REGISTER_ENABLE_RINGS, nullptr, 0);
+	}
+
+	void UringNetWorker::FreeRing()
+	{
+		// closing the ring drops the buffer ring registration and whatever is still in flight
+		if (m_ring_fd >= 0)
+		{
+			close(m_ring_fd);
+			m_ring_fd = -1;
+		}
+		if (nullptr != m_sqes)
+		{
+			munmap(m_sqes, m_sqes_size);
+			m_sqes = nullptr;
+		}
+		if (nullptr != m_cq_ring_ptr && m_cq_ring_ptr != m_sq_ring_ptr)
+			munmap(m_cq_ring_ptr, m_cq_ring_size);
+		m_cq_ring_ptr = nullptr;
+		if (nullptr != m_sq_ring_ptr)
+		{
+			munmap(m_sq_ring_ptr, m_sq_ring_size);
+			m_sq_ring_ptr = nullptr;
+		}
+		if (nullptr != m_bufs)
+		{
+			munmap(m_bufs, (size_t)BUF_NUM * BUF_SIZE);
+			m_bufs = nullptr;
+		}
+		if (nullptr != m_buf_ring)
+		{
+			munmap(m_buf_ring, BUF_NUM * sizeof(io_uring_buf));
+			m_buf_ring = nullptr;
+		}
+	}
+
+	io_uring_sqe * UringNetWorker::GetSqe()
+	{
+		unsigned head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+		if (m_sq_local_tail - head >= m_sq_entries)
+		{
+			// full, what is queued goes to the kernel now without waiting
+			__atomic_store_n(m_sq_tail, m_sq_local_tail, __ATOMIC_RELEASE);
+			UringEnter(m_ring_fd, m_sq_local_tail - head, 0, 0, nullptr, 0);
+			head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+			if (m_sq_local_tail - head >= m_sq_entries)
+				return nullptr;
+		}
+		io_uring_sqe *sqe = &m_sqes[m_sq_local_tail & m_sq_mask];
+		memset(sqe, 0, sizeof(io_uring_sqe));
+		++m_sq_local_tail;
+		return sqe;
+	}
+
+	void UringNetWorker::SubmitAndWait(int timeout_ms)
+	{
+		__atomic_store_n(m_sq_tail, m_sq_local_tail, __ATOMIC_RELEASE);
+		unsigned to_submit = m_sq_local_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+		unsigned flags = IORING_ENTER_GETEVENTS;
+		io_uring_getevents_arg arg;
+		__kernel_timespec ts;
+		void *arg_ptr = nullptr;
+		size_t arg_size = 0;
+		if (timeout_ms >= 0)
+		{
+			memset(&arg, 0, sizeof(arg));
+			ts.tv_sec = timeout_ms / 1000;
+			ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+			arg.ts = (uint64_t)&ts;
+			flags |= IORING_ENTER_EXT_ARG;
+			arg_ptr = &arg;
+			arg_size = sizeof(arg);
+		}
+		// returns at once if completions are already waiting, timeouts and signals only end the wait early
+		UringEnter(m_ring_fd, to_submit, 1, flags, arg_ptr, arg_size);
+	}
+
+	void UringNetWorker::RecycleBuffer(uint16_t bid)
+	{
+		// published by HandleCqes, the kernel only sees the tail move once a round.
+		// the entries are indexed from the ring itself, the flex array macro of some headers shifts bufs in c++
+		io_uring_buf *buf = (io_uring_buf *)m_buf_ring + (m_buf_tail & (BUF_NUM - 1));
+		buf->addr = (uint64_t)(m_bufs + (size_t)bid * BUF_SIZE);
+		buf->len = BUF_SIZE;
+		buf->bid = bid;
+		++m_buf_tail;
+	}
+
+	NetWorkerBase::NetConnectionData * UringNetWorker::NewCnnData(NetId netid, int fd, std::weak_ptr<INetworkHandler> handler)
+	{
+		return new UringCnnData(this, netid, fd, handler);
+	}
+
+	bool UringNetWorker::OpenCnn(NetConnectionData *cnn_data, bool is_read)
+	{
+		UringCnnData *ur_cnn_data = (UringCnnData *)cnn_data;
+		if (ENetworkHandler_Connect == cnn_data->handler_type)
+		{
+			ur_cnn_data->input = evbuffer_new();
+			ur_cnn_data->output = evbuffer_new();
+			if (nullptr == ur_cnn_data->input || nullptr == ur_cnn_data->output)
+				return false;
+			ur_cnn_data->is_read_enable = is_read;
+			if (is_read)
+				return this->ArmRecv(ur_cnn_data);
+			return true;
+		}
+		if (ENetworkHandler_Listen == cnn_data->handler_type)
+			return this->ArmAccept(ur_cnn_data);
+		return true;
+	}
+
+	void UringNetWorker::CloseCnn(NetConnectionData *cnn_data)
+	{
+		UringCnnData *ur_cnn_data = (UringCnnData *)cnn_data;
+		ur_cnn_data->is_closing = true;
+		if (ur_cnn_data->op_num > 0)
+		{
+			// the kernel may still read the output or write the recv buffers, the last completion frees it
+			io_uring_sqe *sqe = this->GetSqe();
+			if (nullptr != sqe)
+			{
+				sqe->opcode = IORING_OP_ASYNC_CANCEL;
+				sqe->fd = cnn_data->fd;
+				sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+				sqe->user_data = EUringOp_Cancel;
+			}
+			else
+			{
+				// no room to cancel, the ops still complete as the socket is shut down, with errors
+				shutdown(cnn_data->fd, SHUT_RDWR);
+			}
+			++m_closing_cnn_num;
+			return;
+		}
+		if (cnn_data->fd >= 0)
+			close(cnn_data->fd);
+		delete ur_cnn_data;
+	}
+
+	void UringNetWorker::EnableRead(NetConnectionData *cnn_data, bool is_enable)
+	{
+		// a recv in flight is left to run, what it brings after a frame fail is dropped by FrameRecvData
+		UringCnnData *ur_cnn_data = (UringCnnData *)cnn_data;
+		if (ENetworkHandler_Connect != cnn_data->handler_type)
+			return;
+		ur_cnn_data->is_read_enable = is_enable;
+		if (is_enable && !ur_cnn_data->is_recv_armed && !cnn_data->is_expired && !this->ArmRecv(ur_cnn_data))
+			this->ExpireCnn(cnn_data, -1);
+	}
+
+	void UringNetWorker::WriteCnn(NetConnectionData *cnn_data, evbuffer *buffer)
+	{
+		UringCnnData *ur_cnn_data = (UringCnnData *)cnn_data;
+		// only whole chains are appended, the bytes of a send in flight stay where they are
+		evbuffer_add_buffer(ur_cnn_data->output, buffer);
+		if (!ur_cnn_data->is_sending && !cnn_data->is_expired && !this->SubmitSend(ur_cnn_data))
+			this->ExpireCnn(cnn_data, -1);
+	}
+
+	bool UringNetWorker::ArmRecv(UringCnnData *cnn_data)
+	{
+		io_uring_sqe *sqe = this->GetSqe();
+		if (nullptr == sqe)
+			return false;
+		sqe->opcode = IORING_OP_RECV;
+		sqe->fd = cnn_data->fd;
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = BUF_GROUP_ID;
+		sqe->user_data = (uint64_t)cnn_data | EUringOp_Recv;
+		cnn_data->is_recv_armed = true;
+		++cnn_data->op_num;
+		return true;
+	}
+
+	bool UringNetWorker::ArmAccept(UringCnnData *cnn_data)
+	{
+		io_uring_sqe *sqe = this->GetSqe();
+		if (nullptr == sqe)
+			return false;
+		sqe->opcode = IORING_OP_ACCEPT;
+		sqe->fd = cnn_data->fd;
+		sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+		sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+		sqe->user_data = (uint64_t)cnn_data | EUringOp_Accept;
+		cnn_data->is_accept_armed = true;
+		++cnn_data->op_num;
+		return true;
+	}
+
+	bool UringNetWorker::ArmWakeup()
+	{
+		io_uring_sqe *sqe = this->GetSqe();
+		if (nullptr == sqe)
+			return false;
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = m_wakeup_fds[0];
+		sqe->addr = (uint64_t)&m_wakeup_count;
+		sqe->len = sizeof(m_wakeup_count);
+		sqe->user_data = EUringOp_Wakeup;
+		return true;
+	}
+
+	bool UringNetWorker::SubmitSend(UringCnnData *cnn_data)
+	{
+		if (evbuffer_get_length(cnn_data->output) <= 0)
+			return true;
+		evbuffer_iovec vecs[MAX_SEND_IOVECS];
+		int vec_num = evbuffer_peek(cnn_data->output, -1, nullptr, vecs, MAX_SEND_IOVECS);
+		if (vec_num > MAX_SEND_IOVECS)
+			vec_num = MAX_SEND_IOVECS;
+		if (vec_num <= 0)
+			return true;
+		io_uring_sqe *sqe = this->GetSqe();
+		if (nullptr == sqe)
+			return false;
+		for (int i = 0; i < vec_num; ++i)
+		{
+			cnn_data->send_iovs[i].iov_base = vecs[i].iov_base;
+			cnn_data->send_iovs[i].iov_len = vecs[i].iov_len;
+		}
+		memset(&cnn_data->send_msg, 0, sizeof(cnn_data->send_msg));
+		cnn_data->send_msg.msg_iov = cnn_data->send_iovs;
+		cnn_data->send_msg.msg_iovlen = vec_num;
+		sqe->opcode = IORING_OP_SENDMSG;
+		sqe->fd = cnn_data->fd;
+		sqe->addr = (uint64_t)&cnn_data->send_msg;
+		sqe->len = 1;
+		sqe->msg_flags = MSG_NOSIGNAL;
+		sqe->user_data = (uint64_t)cnn_data | EUringOp_Send;
+		cnn_data->is_sending = true;
+		++cnn_data->op_num;
+		return true;
+	}
+
+	void UringNetWorker::HandleCqes()
+	{
+		unsigned head = *m_cq_head;
+		unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+		while (head != tail)
+		{
+			io_uring_cqe cqe = m_cqes[head & m_cq_mask];
+			++head;
+			this->HandleCqe(cqe);
+		}
+		__atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+		__atomic_store_n(&m_buf_ring->tail, m_buf_tail, __ATOMIC_RELEASE);
+	}
+
+	void UringNetWorker::HandleCqe(const io_uring_cqe &cqe)
+	{
+		int op = (int)(cqe.user_data & URING_OP_MASK);
+		UringCnnData *cnn_data = (UringCnnData *)(cqe.user_data & ~URING_OP_MASK);
+		switch (op)
+		{
+		case EUringOp_Wakeup:
+			// the read has drained the eventfd
+			this->OnWakeup();
+			if (-ECANCELED != cqe.res)
+				this->ArmWakeup();
+			return;
+		case EUringOp_Recv:
+			this->OnRecvDone(cnn_data, cqe);
+			break;
+		case EUringOp_Send:
+			this->OnSendDone(cnn_data, cqe);
+			break;
+		case EUringOp_Accept:
+			this->OnAcceptDone(cnn_data, cqe);
+			break;
+		default:
+			return;
+		}
+		if (cnn_data->is_closing && cnn_data->op_num <= 0)
+		{
+			if (cnn_data->fd >= 0)
+				close(cnn_data->fd);
+			delete cnn_data;
+			--m_closing_cnn_num;
+		}
+	}
+
+	void UringNetWorker::OnRecvDone(UringCnnData *cnn_data, const io_uring_cqe &cqe)
+	{
+		bool is_more = 0 != (cqe.flags & IORING_CQE_F_MORE);
+		if (!is_more)
+		{
+			cnn_data->is_recv_armed = false;
+			--cnn_data->op_num;
+		}
+		bool is_alive = !cnn_data->is_closing && !cnn_data->is_expired;
+		if (0 != (cqe.flags & IORING_CQE_F_BUFFER))
+		{
+			uint16_t bid = (uint16_t)(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+			if (cqe.res > 0 && is_alive)
+				evbuffer_add(cnn_data->input, m_bufs + (size_t)bid * BUF_SIZE, cqe.res);
+			this->RecycleBuffer(bid);
+		}
+		if (!is_alive)
+			return;
+
+		if (cqe.res > 0)
+			this->OnCnnRead(cnn_data, cnn_data->input);
+		else if (0 == cqe.res)
+			this->ExpireCnn(cnn_data, 0);
+		else if (-ENOBUFS != cqe.res && -ECANCELED != cqe.res)
+			this->ExpireCnn(cnn_data, -1);
+		// the kernel may end a multishot recv any time, out of buffers for one
+		if (!is_more && !cnn_data->is_expired && cnn_data->is_read_enable && !this->ArmRecv(cnn_data))
+			this->ExpireCnn(cnn_data, -1);
+	}
+
+	void UringNetWorker::OnSendDone(UringCnnData *cnn_data, const io_uring_cqe &cqe)
+	{
+		cnn_data->is_sending = false;
+		--cnn_data->op_num;
+		if (cnn_data->is_closing || cnn_data->is_expired)
+			return;
+		if (cqe.res > 0)
+			evbuffer_drain(cnn_data->output, cqe.res);
+		else if (cqe.res < 0 && -EAGAIN != cqe.res && -EINTR != cqe.res)
+		{
+			this->ExpireCnn(cnn_data, -1);
+			return;
+		}
+		if (!cnn_data->is_expired && !this->SubmitSend(cnn_data))
+			this->ExpireCnn(cnn_data, -1);
+	}
+
+	void UringNetWorker::OnAcceptDone(UringCnnData *cnn_data, const io_uring_cqe &cqe)
+	{
+		bool is_more = 0 != (cqe.flags & IORING_CQE_F_MORE);
+		if (!is_more)
+		{
+			cnn_data->is_accept_armed = false;
+			--cnn_data->op_num;
+		}
+		if (cnn_data->is_closing || cnn_data->is_expired)
+		{
+			if (cqe.res >= 0)
+				close(cqe.res);
+			return;
+		}
+		if (cqe.res >= 0)
+		{
+			this->OnAccept(cnn_data, cqe.res);
+		}
+		else
+		{
+			// out of fds or memory the accept is armed again, the backlog waits meanwhile
+			int err_num = -cqe.res;
+			if (ECANCELED != err_num && EINTR != err_num && EAGAIN != err_num && ECONNABORTED != err_num &&
+				EMFILE != err_num && ENFILE != err_num && ENOBUFS != err_num && ENOMEM != err_num)
+			{
+				this->ExpireCnn(cnn_data, 0);
+				return;
+			}
+		}
+		if (!is_more && !cnn_data->is_expired && !this->ArmAccept(cnn_data))
+			this->ExpireCnn(cnn_data, 0);
+	}
+
+	void UringNetWorker::Loop()
+	{
+		ThreadUtil::SetCurrentThreadName(m_thread_name);
+		ThreadUtil::SetCurrentThreadAffinity(m_thread_cpus);
+		event_set_mem_functions(Malloc, Realloc, Free);
+
+		if (!this->EnableRing() || !this->ArmWakeup())
+			m_is_runing = false;
+		while (m_is_runing)
+		{
+			this->CheckRemoveCnnDatas();
+			// connections first, so the first sends to a new connection find it
+			this->CheckAddCnnDatas();
+			this->CheckBindCnnDatas();
+			this->CheckSendDatas();
+
+			this->SubmitAndWait(m_overflow_datas.empty() ? -1 : OVERFLOW_RETRY_MS);
+			this->HandleCqes();
+			this->FlushFrameBatches();
+			this->FlushOverflowDatas();
+
+			this->CheckRemoveCnnDatas();
+		}
+		this->RemoveAllCnnDatas();
+		// the closed connections are freed by their last completions, the ones the kernel is too slow for are left
+		for (int i = 0; i < SHUTDOWN_WAIT_ROUNDS && m_closing_cnn_num > 0; ++i)
+		{
+			this->SubmitAndWait(10);
+			this->HandleCqes();
+		}
+		this->FreeRing();
+	}
+}
+
+#endif
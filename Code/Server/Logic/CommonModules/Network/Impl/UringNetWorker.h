@@ -0,0 +1,121 @@
+#pragma once
+
+#include "NetWorkerBase.h"
+
+// needs the io_uring header of linux 6.0 or later, the kernel it runs on is checked by IsSupported
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#if defined(IORING_RECV_MULTISHOT) && defined(IORING_ACCEPT_MULTISHOT) && defined(IORING_ASYNC_CANCEL_FD)
+#define NET_WORKER_URING
+#endif
+#endif
+#endif
+
+#ifdef NET_WORKER_URING
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace Net
+{
+	// the sockets are served by an io_uring: a multishot accept on every listener and a multishot recv on every connection,
+	// which fills the buffers of a ring registered to the kernel, and one sendmsg in flight per connection.
+	// the loop enters the kernel once a round, to submit all it has queued and wait for completions
+	class UringNetWorker : public NetWorkerBase
+	{
+		NewDelOperaDeclaration;
+	public:
+		UringNetWorker(int worker_idx, int worker_num);
+		virtual ~UringNetWorker();
+		// the ring is set up here, so a kernel refusing it fails Start and not the loop
+		virtual bool Start();
+		// whether the kernel has io_uring with multishot accept and recv and buffer rings, checked once
+		static bool IsSupported();
+
+	protected:
+		virtual void Loop();
+		static const int MAX_SEND_IOVECS = 64;
+		struct UringCnnData : public NetConnectionData
+		{
+			NewDelOperaDeclaration;
+			UringCnnData(UringNetWorker *_networker, NetId _netid, int _fd, std::weak_ptr<INetworkHandler> _handler)
+				: NetConnectionData(_networker, _netid, _fd, _handler) {}
+			virtual ~UringCnnData();
+			evbuffer *input = nullptr;
+			bool is_read_enable = false;
+			bool is_recv_armed = false;
+			bool is_accept_armed = false;
+			bool is_sending = false; // the kernel reads the front of output through send_iovs until the send completes
+			bool is_closing = false; // out of the tables, freed when op_num gets to 0
+			int op_num = 0; // submitted and not finished for good
+			iovec send_iovs[MAX_SEND_IOVECS];
+			msghdr send_msg;
+		};
+		virtual NetConnectionData * NewCnnData(NetId netid, int fd, std::weak_ptr<INetworkHandler> handler);
+		virtual bool OpenCnn(NetConnectionData *cnn_data, bool is_read);
+		virtual void CloseCnn(NetConnectionData *cnn_data);
+		virtual void EnableRead(NetConnectionData *cnn_data, bool is_enable);
+		virtual void WriteCnn(NetConnectionData *cnn_data, evbuffer *buffer);
+
+		// the low bits of the user_data of a submission, the rest is its UringCnnData
+		enum EUringOp
+		{
+			EUringOp_Wakeup = 1,
+			EUringOp_Recv = 2,
+			EUringOp_Send = 3,
+			EUringOp_Accept = 4,
+			EUringOp_Cancel = 5,
+		};
+		static const uint64_t URING_OP_MASK = 7;
+		bool ArmRecv(UringCnnData *cnn_data);
+		bool ArmAccept(UringCnnData *cnn_data);
+		bool ArmWakeup();
+		bool SubmitSend(UringCnnData *cnn_data);
+		void HandleCqes();
+		void HandleCqe(const io_uring_cqe &cqe);
+		void OnRecvDone(UringCnnData *cnn_data, const io_uring_cqe &cqe);
+		void OnSendDone(UringCnnData *cnn_data, const io_uring_cqe &cqe);
+		void OnAcceptDone(UringCnnData *cnn_data, const io_uring_cqe &cqe);
+		int m_closing_cnn_num = 0;
+		uint64_t m_wakeup_count = 0;
+
+	protected:
+		// the rings shared with the kernel, only the loop thread touches them once it runs
+		bool SetupRing();
+		bool EnableRing();
+		void FreeRing();
+		io_uring_sqe * GetSqe();
+		void SubmitAndWait(int timeout_ms);
+		int m_ring_fd = -1;
+		void *m_sq_ring_ptr = nullptr;
+		size_t m_sq_ring_size = 0;
+		void *m_cq_ring_ptr = nullptr;
+		size_t m_cq_ring_size = 0;
+		io_uring_sqe *m_sqes = nullptr;
+		size_t m_sqes_size = 0;
+		unsigned *m_sq_head = nullptr;
+		unsigned *m_sq_tail = nullptr;
+		unsigned m_sq_mask = 0;
+		unsigned m_sq_entries = 0;
+		unsigned m_sq_local_tail = 0; // filled up to here, handed to the kernel by the next enter
+		unsigned *m_cq_head = nullptr;
+		unsigned *m_cq_tail = nullptr;
+		unsigned m_cq_mask = 0;
+		io_uring_cqe *m_cqes = nullptr;
+		static const unsigned SQ_ENTRIES = 4096;
+		static const unsigned CQ_ENTRIES = 16384;
+		static const int SHUTDOWN_WAIT_ROUNDS = 100;
+
+		// recv picks its buffer from here, the bytes are copied into the connection input and the buffer goes back at once
+		void RecycleBuffer(uint16_t bid);
+		io_uring_buf_ring *m_buf_ring = nullptr;
+		char *m_bufs = nullptr;
+		uint16_t m_buf_tail = 0;
+		static const uint16_t BUF_GROUP_ID = 0;
+		static const uint32_t BUF_NUM = 2048;
+		static const uint32_t BUF_SIZE = 8192;
+	};
+}
+
+#endif
@@ -5,7 +5,7 @@
 #include "CommonModules/Log/LogModule.h"
 #include "Common/Utils/MemoryUtil.h"
 
-TimerModule::TimerModule(ModuleMgr *module_mgr) : ITimerModule(module_mgr)
+TimerModule::TimerModule(ModuleMgr *module_mgr) : ITimerModule(module_mgr), m_rbtree_node_pool("srv_rbtree_node_t", false)
 {
 
 }
@@ -96,7 +96,7 @@ EModuleRetCode TimerModule::Update()
 		srv_rbtree_node_t *node = srv_rbtree_min(m_rbtree_timer_items->root, m_rbtree_timer_items->sentinel);
 		if (m_rbtree_timer_items->sentinel == node)
 			break;
-		if (node->key > m_now_ms)
+		if (node->key > (srv_rbtree_key_t)m_now_ms)
 			break;
 		srv_rbtree_delete(m_rbtree_timer_items, node);
 		this->TryExecuteNode(node);
@@ -126,7 +126,7 @@ EModuleRetCode TimerModule::Release()
 			node_queue.push(node->right);
 		if (nullptr != node->data)
 			delete (TimerItem *)node->data;
-		delete node;
+		m_rbtree_node_pool.Free(node, sizeof(srv_rbtree_node_t));
 	}
 	delete m_rbtree_sentinel_node; m_rbtree_sentinel_node = nullptr;
 	delete m_rbtree_timer_items; m_rbtree_timer_items = nullptr;
@@ -180,7 +180,7 @@ long long TimerModule::Add(TimerAction action, long start_ts_ms, long long execu
 	timer_item->is_firm = execute_times == EXECUTE_UNLIMIT_TIMES;
 	timer_item->action = action;
 	timer_item->execute_ms = (start_ts_ms >= m_now_ms) ? start_ts_ms : m_now_ms;
-	srv_rbtree_node_t *node = (srv_rbtree_node_t *)Malloc(sizeof(srv_rbtree_node_t));
+	srv_rbtree_node_t *node = (srv_rbtree_node_t *)m_rbtree_node_pool.Malloc(sizeof(srv_rbtree_node_t));
 	memset(node, 0, sizeof(srv_rbtree_node_t));
 	node->key = timer_item->execute_ms;
 	node->data = timer_item;
@@ -234,7 +234,7 @@ void TimerModule::ChekRemoveNodes()
 		if (node->parent)
 			srv_rbtree_delete(m_rbtree_timer_items, node);
 		delete (TimerItem *)node->data;
-		Free(node);
+		m_rbtree_node_pool.Free(node, sizeof(srv_rbtree_node_t));
 		m_id_to_timer_node.erase(it);
 		++ m_remove_times;
 	}
@@ -249,4 +249,4 @@ void TimerModule::UpdateTime()
 	m_delta_ms = m_now_ms - old_ms;
 }
 
-NewDelOperaImplement(TimerModule::TimerItem);
\ No newline at end of file
+ObjectPoolOperaImplement(TimerModule::TimerItem, false);
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <map>
 #include <set>
 #include "Common/Macro/MemoryPoolMacro.h"
+#include "Common/Macro/ObjectPoolMacro.h"
 #include "MemoryPool/StlAllocator.h"
 
 class TimerModule : public ITimerModule
@@ -31,7 +32,7 @@ public:
 private:
 	struct TimerItem
 	{
-		NewDelOperaDeclaration;
+		ObjectPoolOperaDeclaration(TimerItem);
 		long long id = INVALID_TIMER_ID;
 		bool is_firm = false;
 		long long execute_ms = 0;
@@ -41,6 +42,7 @@ private:
 	};
 
 	srv_rbtree_node_t *m_rbtree_sentinel_node;
+	ObjectPool<srv_rbtree_node_t> m_rbtree_node_pool;
 	srv_rbtree_t *m_rbtree_timer_items;
 
 	void UpdateTime();
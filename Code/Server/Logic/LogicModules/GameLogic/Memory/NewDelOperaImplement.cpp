@@ -8,3 +8,6 @@ NewDelOperaImplement(GameLogicModule);
 NewDelOperaImplement(GameLogic::Player);
 #include "GameLogic/Player/PlayerMgr.h"
 NewDelOperaImplement(GameLogic::PlayerMgr);
+
+#include "GameLogic/Scene/ViewMgr/ViewUnit.h"
+ObjectPoolOperaImplement(GameLogic::ViewUnit, false);
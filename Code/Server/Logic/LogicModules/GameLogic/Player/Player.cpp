@@ -18,6 +18,7 @@ namespace GameLogic
 		virtual ~PlayerCnnHandler();
 		virtual void OnClose(int err_num);
 		virtual void OnOpen(int err_num);
+		virtual void OnSendWatermark(bool is_high);
 
 	protected:
 		virtual void OnParseSuccess(char *data, uint32_t len);
@@ -28,7 +29,7 @@ namespace GameLogic
 	NewDelOperaImplement(PlayerCnnHandler);
 
 	PlayerCnnHandler::PlayerCnnHandler(NetId netid, GameLogic::Player *player)
-		: LenCtxNetStreamCnnHandler(Net::PROTOCOL_MAX_SIZE), m_player(player)
+		: LenCtxNetStreamCnnHandler(Net::PROTOCOL_MAX_SIZE, true), m_player(player)
 	{
 		this->SetNetId(netid);
 	}
@@ -48,9 +49,14 @@ namespace GameLogic
 		m_player->OnNetOpen(err_num);
 	}
 
+	void PlayerCnnHandler::OnSendWatermark(bool is_high)
+	{
+		m_player->OnNetSendWatermark(is_high);
+	}
+
 	void PlayerCnnHandler::OnParseSuccess(char *data, uint32_t len)
 	{
-		m_player->OnNetRecv(m_parser.Content(), m_parser.ContentLen());
+		m_player->OnNetRecv(data, len);
 	}
 
 	void PlayerCnnHandler::OnParseFail()
@@ -119,6 +125,12 @@ namespace GameLogic
 		m_player_mgr->OnCnnRecv(data, len, this);
 	}
 
+	void Player::OnNetSendWatermark(bool is_high)
+	{
+		m_is_send_congested = is_high;
+		m_player_mgr->OnCnnSendWatermark(is_high, this);
+	}
+
 	void Player::SetHero(std::shared_ptr<Hero> hero)
 	{
 		if (!m_hero.expired())
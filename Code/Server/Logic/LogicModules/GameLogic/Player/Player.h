@@ -39,15 +39,19 @@ namespace GameLogic
 		void OnNetClose(int err_num);
 		void OnNetOpen(int err_num);
 		void OnNetRecv(char *data, uint32_t len);
+		void OnNetSendWatermark(bool is_high);
 
 	public:
 		std::weak_ptr<Hero> GetHero() { return m_hero; }
 		void SetHero(std::shared_ptr<Hero> hero);
 		bool CanRecvSceneMsg() { return m_can_recv_scene_msg; }
 		void SetCanRecvSceneMsg(bool value) { m_can_recv_scene_msg = value; }
+		// the client reads slower than it is sent to, see PlayerMgr::IsSendCongested
+		bool IsSendCongested() { return m_is_send_congested; }
 
 	protected:
 		std::weak_ptr<Hero> m_hero;
 		bool m_can_recv_scene_msg = false;
+		bool m_is_send_congested = false;
 	};
 }
\ No newline at end of file
@@ -7,6 +7,9 @@
 #include "Common/Macro/ServerLogicMacro.h"
 #include "ServerLogics/ServerLogic.h"
 #include "Network/Utils/NetworkAgent.h"
+#include "GameLogic/Scene/Scene.h"
+#include "GameLogic/Scene/SceneObject/Hero.h"
+#include "Network/Protobuf/ProtoId.pb.h"
 
 namespace GameLogic
 {
@@ -51,7 +54,24 @@ namespace GameLogic
 
 	bool PlayerMgr::Awake(std::string ip, uint16_t port)
 	{
-		NetId netid = GlobalServerLogic->GetNetworkModule()->Listen(ip, port, nullptr, m_net_listen_handler);
+		// login storms are accepted by all the net workers at once
+		NetListenOpt listen_opt;
+		listen_opt.is_shard_on_workers = true;
+		NetId netid = GlobalServerLogic->GetNetworkModule()->Listen(ip, port, &listen_opt, m_net_listen_handler);
+
+		// a player over high only misses state updates, one far behind is kicked instead of buffered without end
+		NetSendWatermarkOpt watermark_opt;
+		watermark_opt.cnn_high_bytes = 256 * 1024;
+		watermark_opt.cnn_low_bytes = 64 * 1024;
+		watermark_opt.cnn_close_bytes = 4 * 1024 * 1024;
+		watermark_opt.global_high_bytes = 256 * 1024 * 1024;
+		watermark_opt.global_low_bytes = 128 * 1024 * 1024;
+		watermark_opt.on_global_watermark = std::bind(&PlayerMgr::OnGlobalSendWatermark, this, std::placeholders::_1, std::placeholders::_2);
+		GlobalServerLogic->GetNetworkModule()->SetSendWatermark(watermark_opt);
+
+		// the scene syncs of joining, ViewAllGrids above all, go compressed to the clients that sent their net option
+		GlobalServerLogic->GetNetAgent()->SetCompressMinLen(512);
+		GlobalServerLogic->GetNetAgent()->SetRttProtocol(NetProto::PID_Ping, NetProto::PID_Pong);
 		return netid > 0;
 	}
 
@@ -63,6 +83,16 @@ namespace GameLogic
 				delete player;
 			m_to_remove_players.clear();
 		}
+		if (now_ms - m_last_ping_ms >= PING_SPAN_MS)
+			this->PingPlayers(now_ms);
+	}
+
+	void PlayerMgr::PingPlayers(long long now_ms)
+	{
+		m_last_ping_ms = now_ms;
+		NetworkAgent *net_agent = GlobalServerLogic->GetNetAgent();
+		for (auto kv_pair : m_players)
+			net_agent->SendPing(kv_pair.first);
 	}
 
 	void PlayerMgr::OnCnnClose(int err_num, Player *player)
@@ -76,6 +106,8 @@ namespace GameLogic
 
 	void PlayerMgr::OnCnnRecv(char *data, uint32_t len, Player *player)
 	{
+		if (!GlobalServerLogic->GetNetAgent()->OnRecv(player->GetNetId(), data, len))
+			return;
 		m_logic_module->HandlePlayerMsg(data, len, player);
 	}
 
@@ -91,6 +123,40 @@ namespace GameLogic
 		}
 	}
 
+	void PlayerMgr::OnCnnSendWatermark(bool is_high, Player *player)
+	{
+		if (!is_high && !m_is_global_send_congested)
+			this->ResyncSceneState(player);
+	}
+
+	bool PlayerMgr::IsSendCongested(Player *player)
+	{
+		return m_is_global_send_congested || player->IsSendCongested();
+	}
+
+	void PlayerMgr::OnGlobalSendWatermark(bool is_high, uint64_t send_bytes)
+	{
+		m_is_global_send_congested = is_high;
+		if (is_high)
+			return;
+		for (auto kv_pair : m_players)
+		{
+			if (!kv_pair.second->IsSendCongested())
+				this->ResyncSceneState(kv_pair.second);
+		}
+	}
+
+	void PlayerMgr::ResyncSceneState(Player *player)
+	{
+		// makes up for the mutable states skipped while congested
+		if (!player->CanRecvSceneMsg())
+			return;
+		std::shared_ptr<Hero> hero = player->GetHero().lock();
+		if (nullptr == hero || nullptr == hero->GetScene())
+			return;
+		hero->GetScene()->SyncAllSceneObjectState(player, SCMF_ForMutable);
+	}
+
 	void PlayerMgr::OnListenClose(int err_num)
 	{
 
@@ -106,7 +172,7 @@ namespace GameLogic
 		auto it = m_players.find(netid);
 		if (m_players.end() != it)
 		{
-			GlobalServerLogic->GetNetworkModule()->Close(netid);
+			GlobalServerLogic->GetNetAgent()->Close(netid);
 			m_to_remove_players.insert(it->second);
 			m_players.erase(it);
 			it = m_players.end();
@@ -121,11 +187,14 @@ namespace GameLogic
 		}
 		else
 		{
+			m_broadcast_netids.clear();
 			for (auto kv_pair : m_players)
 			{
 				// if (kv_pair.second->CanRecvSceneMsg())
-					GlobalServerLogic->GetNetAgent()->Send(kv_pair.first, protocol_id, msg, msg_len);
+					m_broadcast_netids.push_back(kv_pair.first);
 			}
+			if (!m_broadcast_netids.empty())
+				GlobalServerLogic->GetNetAgent()->Multicast(m_broadcast_netids.data(), (uint32_t)m_broadcast_netids.size(), protocol_id, msg, msg_len);
 		}
 	}
 
@@ -137,14 +206,23 @@ namespace GameLogic
 		}
 		else
 		{
+			m_broadcast_netids.clear();
 			for (auto kv_pair : m_players)
 			{
 				if (kv_pair.second->CanRecvSceneMsg())
-					GlobalServerLogic->GetNetAgent()->Send(kv_pair.first, protocol_id, msg);
+					m_broadcast_netids.push_back(kv_pair.first);
 			}
+			this->Multicast(m_broadcast_netids, protocol_id, msg);
 		}
 	}
 
+	void PlayerMgr::Multicast(std::vector<NetId> &netids, int protocol_id, google::protobuf::Message * msg)
+	{
+		if (netids.empty())
+			return;
+		GlobalServerLogic->GetNetAgent()->Multicast(netids.data(), (uint32_t)netids.size(), protocol_id, msg);
+	}
+
 	void PlayerMgr::Close(NetId netid)
 	{
 		GlobalServerLogic->GetNetAgent()->Close(netid);
@@ -3,6 +3,7 @@
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 #include "Common/Define/NetworkDefine.h"
 #include "Common/Macro/MemoryPoolMacro.h"
 #include "MemoryPool/StlAllocator.h"
@@ -32,9 +33,13 @@ namespace GameLogic
 		void OnCnnClose(int err_num, Player *player);
 		void OnCnnRecv(char *data, uint32_t len, Player *player);
 		void OnCnnOpen(int err_num, Player *player);
+		void OnCnnSendWatermark(bool is_high, Player *player);
+		// state updates which the next full sync makes up for are not sent to a congested player
+		bool IsSendCongested(Player *player);
 		void RemovePlayer(NetId netid);
 		void Send(NetId netid, int protocol_id, char *msg, uint32_t msg_len);
 		void Send(NetId netid, int protocol_id, google::protobuf::Message *msg);
+		void Multicast(std::vector<NetId> &netids, int protocol_id, google::protobuf::Message *msg);
 		void Close(NetId netid);
 
 	protected:
@@ -45,5 +50,16 @@ namespace GameLogic
 		void OnListenOpen(int err_num);
 
 		std::unordered_set<Player *, std::hash<Player *>, std::equal_to<Player *>, StlAllocator<Player *>> m_to_remove_players;
+		std::vector<NetId> m_broadcast_netids;
+
+		// the whole server sends more than its clients take
+		bool m_is_global_send_congested = false;
+		void OnGlobalSendWatermark(bool is_high, uint64_t send_bytes);
+		void ResyncSceneState(Player *player);
+
+		// every player is pinged now and then, the pongs give the round trip times of NetCnnStat
+		static const long long PING_SPAN_MS = 5000;
+		long long m_last_ping_ms = 0;
+		void PingPlayers(long long now_ms);
 	};
 }
\ No newline at end of file
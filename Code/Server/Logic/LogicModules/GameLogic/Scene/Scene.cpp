@@ -163,6 +163,7 @@ namespace GameLogic
 		}
 		this->CheckSceneObjectsCache();
 		m_protobuf_arena->Reset();
+		MemoryUtil::GetFrameArena()->Reset();
 	}
 
 	int64_t Scene::AddObject(std::shared_ptr<SceneObject> scene_obj)
@@ -218,7 +219,7 @@ namespace GameLogic
 		m_logic_module->GetPlayerMgr()->Send(netid, protocol_id, msg);
 	}
 
-	void Scene::SendClient(NetId netid, const std::vector<SyncClientMsg>& msgs)
+	void Scene::SendClient(NetId netid, const SyncClientMsgVec& msgs)
 	{
 		for (const SyncClientMsg & item : msgs)
 		{
@@ -228,21 +229,22 @@ namespace GameLogic
 
 	void Scene::SendViewCamp(EViewCamp view_camp, int protocol_id, google::protobuf::Message * msg)
 	{
-		for (auto kv_pair : m_scene_objs)
+		std::vector<NetId> &netids = this->CollectViewCampNetIds(view_camp);
+		m_logic_module->GetPlayerMgr()->Multicast(netids, protocol_id, msg);
+	}
+
+	void Scene::SendViewCamp(EViewCamp view_camp, const SyncClientMsgVec& msgs, bool is_droppable)
+	{
+		std::vector<NetId> &netids = this->CollectViewCampNetIds(view_camp, is_droppable);
+		for (const SyncClientMsg & item : msgs)
 		{
-			std::shared_ptr<SceneObject> sptr_so = kv_pair.second;
-			if (ESOT_Hero != sptr_so->GetObjectType() || sptr_so->GetViewCamp() != view_camp)
-				continue;
-			std::shared_ptr<Hero> sptr_hero = std::dynamic_pointer_cast<Hero>(sptr_so);
-			Player *player = sptr_hero->GetPlayer();
-			if (nullptr == player)
-				continue;
-			player->Send(protocol_id, msg);
+			m_logic_module->GetPlayerMgr()->Multicast(netids, item.protocol_id, item.msg);
 		}
 	}
 
-	void Scene::SendViewCamp(EViewCamp view_camp, const std::vector<SyncClientMsg>& msgs)
+	std::vector<NetId> & Scene::CollectViewCampNetIds(EViewCamp view_camp, bool is_skip_send_congested)
 	{
+		m_view_camp_netids.clear();
 		for (auto kv_pair : m_scene_objs)
 		{
 			std::shared_ptr<SceneObject> sptr_so = kv_pair.second;
@@ -252,11 +254,13 @@ namespace GameLogic
 			Player *player = sptr_hero->GetPlayer();
 			if (nullptr == player)
 				continue;
-			for (const SyncClientMsg & item : msgs)
-			{
-				player->Send(item.protocol_id, item.msg);
-			}
+			if (is_skip_send_congested && m_logic_module->GetPlayerMgr()->IsSendCongested(player))
+				continue;
+			NetId netid = player->GetNetId();
+			if (netid > 0)
+				m_view_camp_netids.push_back(netid);
 		}
+		return m_view_camp_netids;
 	}
 
 	void Scene::PullAllSceneInfo(Player * player)
@@ -349,7 +353,7 @@ namespace GameLogic
 						continue;
 					if (!sptr_so->NeedSyncMutableState())
 						continue;
-					this->SendViewCamp((EViewCamp)view_camp, sptr_so->ColllectSyncClientMsg(SCMF_ForMutable));
+					this->SendViewCamp((EViewCamp)view_camp, sptr_so->ColllectSyncClientMsg(SCMF_ForMutable), true);
 				}
 			}
 		}
@@ -3,6 +3,7 @@
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <google/protobuf/arena.h>
 #include "Common/Define/NetworkDefine.h"
@@ -71,14 +72,17 @@ namespace GameLogic
 			return google::protobuf::Arena::CreateMessage<T>(m_protobuf_arena);
 		}
 		void SendClient(NetId netid, int protocol_id, google::protobuf::Message *msg);
-		void SendClient(NetId netid, const std::vector<SyncClientMsg> &msgs);
+		void SendClient(NetId netid, const SyncClientMsgVec &msgs);
 		void SendViewCamp(EViewCamp view_camp, int protocol_id, google::protobuf::Message *msg);
-		void SendViewCamp(EViewCamp view_camp, const std::vector<SyncClientMsg> &msgs);
+		// is_droppable skips the players congested on sending, they get the states again when they recover
+		void SendViewCamp(EViewCamp view_camp, const SyncClientMsgVec &msgs, bool is_droppable = false);
 		void PullAllSceneInfo(Player *player);
 		void SyncAllSceneObjectState(Player *player, int filter_flag);
 
 
 	private:
 		void HandleViewChange();
+		std::vector<NetId> m_view_camp_netids;
+		std::vector<NetId> & CollectViewCampNetIds(EViewCamp view_camp, bool is_skip_send_congested = false);
 	};
 }
@@ -164,9 +164,9 @@ namespace GameLogic
 		return m_move_agent->GetMoveState();
 	}
 
-	std::vector<SyncClientMsg> MoveObject::ColllectSyncClientMsg(int filter_type)
+	SyncClientMsgVec MoveObject::ColllectSyncClientMsg(int filter_type)
 	{
-		std::vector<SyncClientMsg> msgs;
+		SyncClientMsgVec msgs;
 
 		if (filter_type & SCMF_ForInit)
 		{
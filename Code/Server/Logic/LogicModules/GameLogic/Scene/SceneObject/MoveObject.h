@@ -43,7 +43,7 @@ namespace GameLogic
 		const Vector3 & GetVelocity();
 		NetProto::EMoveAgentState GetMoveAgentState();
 		NetProto::EMoveState GetMoveState();
-		virtual std::vector<SyncClientMsg> ColllectSyncClientMsg(int filter_type) override;
+		virtual SyncClientMsgVec ColllectSyncClientMsg(int filter_type) override;
 
 	protected:
 		NetProto::MoveObjectState * GetPbMoveObjectState();
@@ -73,9 +73,9 @@ namespace GameLogic
 		return m_body_radius * m_body_scale;
 	}
 
-	std::vector<SyncClientMsg> SceneObject::ColllectSyncClientMsg(int filter_type)
+	SyncClientMsgVec SceneObject::ColllectSyncClientMsg(int filter_type)
 	{
-		std::vector<SyncClientMsg> client_msgs;
+		SyncClientMsgVec client_msgs;
 		if (filter_type & SCMF_ForInit)
 		{
 			client_msgs.push_back(SyncClientMsg(NetProto::PID_SceneObjectState, this->GetPbSceneObjectState()));
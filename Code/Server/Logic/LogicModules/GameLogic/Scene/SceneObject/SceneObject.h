@@ -33,6 +33,8 @@ namespace GameLogic
 		int protocol_id;
 		google::protobuf::Message *msg;
 	};
+	// collected and sent within one tick, the protobuf messages live in the scene arena
+	using SyncClientMsgVec = std::vector<SyncClientMsg, FrameAllocator<SyncClientMsg>>;
 
 	class SceneObject : public std::enable_shared_from_this<SceneObject>
 	{
@@ -97,7 +99,7 @@ namespace GameLogic
 		ViewUnit *m_view_unit = nullptr;
 
 	public:
-		virtual std::vector<SyncClientMsg> ColllectSyncClientMsg(int filter_type);
+		virtual SyncClientMsgVec ColllectSyncClientMsg(int filter_type);
 		bool NeedSyncMutableState() { return m_flag_sync_mutable_state; }
 		void SetSyncMutableState(bool val) { m_flag_sync_mutable_state = val; }
 	protected:
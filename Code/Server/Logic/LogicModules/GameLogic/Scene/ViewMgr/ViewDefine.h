@@ -6,6 +6,7 @@
 #include <memory>
 #include "stdint.h"
 #include "Common/Geometry/Vector2.h"
+#include "MemoryPool/FrameAllocator.h"
 
 namespace GameLogic
 {
@@ -17,6 +18,9 @@ namespace GameLogic
 	using ViewGridMap = std::unordered_map<int32_t, ViewGrid *>;
 	using ViewGridSet = std::unordered_set<ViewGrid *>;
 	using ViewGridVec = std::vector<ViewGrid *>;
+	// tick local containers, backed by the frame arena which is reset at the end of Scene::Update
+	using FrameViewGridSet = std::unordered_set<ViewGrid *, std::hash<ViewGrid *>, std::equal_to<ViewGrid *>, FrameAllocator<ViewGrid *>>;
+	using FrameViewGridVec = std::vector<ViewGrid *, FrameAllocator<ViewGrid *>>;
 
 	using ViewUnitMap = std::unordered_map<int64_t, ViewUnit *>;
 	using ViewUnitSet = std::unordered_set<ViewUnit *>;
@@ -209,10 +209,10 @@ namespace GameLogic
 		}
 	}
 
-	ViewGridVec ViewMgr::GetCircleCoverGrids(float center_x, float center_y, float radius)
+	FrameViewGridVec ViewMgr::GetCircleCoverGrids(float center_x, float center_y, float radius)
 	{
-		ViewGridVec possible_grids = this->GetAABBConverGrids(center_x - radius, center_y - radius, center_x + radius, center_y + radius);
-		ViewGridVec grids;
+		FrameViewGridVec possible_grids = this->GetAABBConverGrids(center_x - radius, center_y - radius, center_x + radius, center_y + radius);
+		FrameViewGridVec grids;
 		for (auto grid : possible_grids)
 		{
 			if (GeometryUtils::IsCirlceRectIntersect(
@@ -225,9 +225,9 @@ namespace GameLogic
 		return grids;
 	}
 
-	ViewGridVec ViewMgr::GetAABBConverGrids(float x1, float y1, float x2, float y2)
+	FrameViewGridVec ViewMgr::GetAABBConverGrids(float x1, float y1, float x2, float y2)
 	{
-		ViewGridVec grids;
+		FrameViewGridVec grids;
 		int row1 = InRowIdx(y1);
 		int col1 = InColIdx(x1);
 		int row2 = InRowIdx(y2);
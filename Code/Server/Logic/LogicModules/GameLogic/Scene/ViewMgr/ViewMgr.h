@@ -23,8 +23,8 @@ namespace GameLogic
 		bool LoadCfg(std::string file_path);
 		void Update();
 
-		ViewGridVec GetCircleCoverGrids(float center_x, float center_y, float radius);
-		ViewGridVec GetAABBConverGrids(float min_x, float min_y, float max_x, float max_y);
+		FrameViewGridVec GetCircleCoverGrids(float center_x, float center_y, float radius);
+		FrameViewGridVec GetAABBConverGrids(float min_x, float min_y, float max_x, float max_y);
 		int CalGridIdx(int row, int col);
 		bool CalRowCol(int grid_idx, int &row, int &col);
 		int InRowIdx(float y);
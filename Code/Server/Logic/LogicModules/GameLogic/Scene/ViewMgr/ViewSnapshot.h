@@ -4,15 +4,19 @@ namespace GameLogic
 {
 	struct ViewGrid;
 
+	using FrameSceneObjMap = std::unordered_map<uint64_t, std::weak_ptr<SceneObject>, std::hash<uint64_t>, std::equal_to<uint64_t>, 
+		FrameAllocator<std::pair<const uint64_t, std::weak_ptr<SceneObject>>>>;
+
+	// only lives within a tick, so all of its containers are frame arena backed
 	struct ViewSnapshotDifference
 	{
 		ViewSnapshotDifference();
 		void Reset();
 
-		std::unordered_map<uint64_t, std::weak_ptr<SceneObject>> miss_scene_objs;
-		std::unordered_map<uint64_t, std::weak_ptr<SceneObject>> more_scene_objs;
-		ViewGridVec miss_view_grids;
-		ViewGridVec more_view_grids;
+		FrameSceneObjMap miss_scene_objs;
+		FrameSceneObjMap more_scene_objs;
+		FrameViewGridVec miss_view_grids;
+		FrameViewGridVec more_view_grids;
 
 		void PrintLog();
 	};
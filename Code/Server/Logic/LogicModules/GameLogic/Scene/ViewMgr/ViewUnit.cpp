@@ -118,12 +118,12 @@ namespace GameLogic
 
 		if (m_has_body)
 		{
-			ViewGridVec cover_grids = m_view_mgr->GetCircleCoverGrids(locate_pos.x, locate_pos.y, so->GetBodyRadius());
+			FrameViewGridVec cover_grids = m_view_mgr->GetCircleCoverGrids(locate_pos.x, locate_pos.y, so->GetBodyRadius());
 			for (auto grid : m_body_cover_girds)
 			{
 				grid->body_units.erase(m_objid);
 			}
-			m_body_cover_girds = cover_grids;
+			m_body_cover_girds.assign(cover_grids.begin(), cover_grids.end());
 			for (auto grid : m_body_cover_girds)
 			{
 				grid->body_units.insert(std::make_pair(m_objid, this));
@@ -132,12 +132,12 @@ namespace GameLogic
 
 		if (m_has_view)
 		{
-			ViewGridSet cover_grids;
+			FrameViewGridSet cover_grids;
 			{
-				ViewGridVec tmp_grids = m_view_mgr->GetCircleCoverGrids(locate_pos.x, locate_pos.y, so->GetViewRadius());
+				FrameViewGridVec tmp_grids = m_view_mgr->GetCircleCoverGrids(locate_pos.x, locate_pos.y, so->GetViewRadius());
 				cover_grids.insert(tmp_grids.begin(), tmp_grids.end());
 				cover_grids.insert(locate_grid);
-				ViewGridSet blind_grids; ViewGridVec block_grids;
+				FrameViewGridSet blind_grids; FrameViewGridVec block_grids;
 				for (ViewGrid *grid : cover_grids)
 				{
 					if (grid == locate_grid) // ԼڵλñضɼҲ
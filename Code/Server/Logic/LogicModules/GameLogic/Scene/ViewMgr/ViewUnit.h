@@ -2,11 +2,13 @@
 
 #include "ViewDefine.h"
 #include "GameLogic/Scene/Defines/SceneDefine.h"
+#include "Common/Macro/ObjectPoolMacro.h"
 
 namespace GameLogic
 {
 	class ViewUnit
 	{
+		ObjectPoolOperaDeclaration(ViewUnit);
 	public:
 		ViewUnit();
 		~ViewUnit();
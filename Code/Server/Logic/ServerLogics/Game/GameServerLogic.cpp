@@ -26,6 +26,7 @@ void GameServerLogic::SetInitParams(void *params)
 
 	m_init_params[EMoudleName_Log] = log_param;
 	m_init_params[EMoudleName_GameLogic] = cfg_param;
+	m_thread_cfg_file = strs[1] + "/Server/ThreadConfig.csv";
 }
 
 void GameServerLogic::ClearInitParams()
@@ -7,6 +7,11 @@
 #include "CommonModules/Network/INetworkModule.h"
 #include "Network/Utils/NetworkAgent.h"
 #include "Common/Macro/ServerLogicMacro.h"
+#include "Common/Utils/MemoryUtil.h"
+#include "MemoryPool/ObjectPool.h"
+#include "Common/Define/ServerLogicDefine.h"
+#include "ThreadConfig.h"
+#include "Utils/ThreadUtil.h"
 
 ServerLogic *server_logic = nullptr;
 const int TRY_MAX_TIMES = 100000;
@@ -23,11 +28,65 @@ ServerLogic::~ServerLogic()
 	m_module_mgr = nullptr;
 }
 
+static bool CheckThreadCfg(ThreadConfigSet *cfg_set, std::string &err)
+{
+	int cpu_num = (int)std::thread::hardware_concurrency();
+	for (ThreadConfig *cfg : cfg_set->cfg_vec)
+	{
+		for (int cpu : cfg->cpus)
+		{
+			if (cpu < 0 || (cpu_num > 0 && cpu >= cpu_num))
+			{
+				err = "thread " + cfg->name + " has no cpu " + std::to_string(cpu);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool ServerLogic::SetupThreads()
+{
+	std::string logic_thread_name = "logic";
+	std::vector<int> logic_cpus;
+	if (!m_thread_cfg_file.empty())
+	{
+		m_thread_cfg_set = new ThreadConfigSet();
+		if (!m_thread_cfg_set->Load(m_thread_cfg_file, m_thread_cfg_err) || !CheckThreadCfg(m_thread_cfg_set, m_thread_cfg_err))
+		{
+			// a missing or bad table keeps the default thread counts, unpinned. the log module is not up yet, Init logs the error
+			delete m_thread_cfg_set;
+			m_thread_cfg_set = nullptr;
+		}
+	}
+	if (nullptr != m_thread_cfg_set)
+	{
+		// the net workers and connect threads are sized and placed by the network module
+		m_init_params[EMoudleName_Network] = m_thread_cfg_set;
+
+		ThreadConfig *logic_cfg = m_thread_cfg_set->Get(EThreadCfgId_Logic);
+		if (nullptr != logic_cfg)
+		{
+			if (!logic_cfg->name.empty())
+				logic_thread_name = logic_cfg->name;
+			logic_cpus = ThreadUtil::ChoseCpus(logic_cfg->cpus, 0);
+		}
+	}
+	// Loop runs every state on this thread, so the logic thread is the calling one
+	ThreadUtil::SetCurrentThreadName(logic_thread_name);
+	return ThreadUtil::SetCurrentThreadAffinity(logic_cpus);
+}
+
 bool ServerLogic::Init()
 {
 	if (EServerLogicState_Free != m_state)
 		return false;
 
+	if (!this->SetupThreads())
+	{
+		this->Quit();
+		return false;
+	}
 	this->SetupModules();
 
 	m_timer_module = m_module_mgr->GetModule<ITimerModule>();
@@ -46,6 +105,8 @@ bool ServerLogic::Init()
 	if (!ret) this->Quit();
 	else
 	{
+		if (!m_thread_cfg_err.empty())
+			this->GetLogModule()->Warn(LogModule::LOGGER_ID_STDOUT, "{0}, use the default threads", m_thread_cfg_err);
 		m_network_agent = new NetworkAgent(this->GetNetworkModule());
 	}
 	return ret;
@@ -68,6 +129,14 @@ bool ServerLogic::Awake()
 
 	bool ret = EModuleRetCode_Succ == retCode;
 	if (!ret) this->Quit();
+	else
+	{
+		if (m_memory_stat_log_span_ms > 0)
+		{
+			m_memory_stat_timer_id = m_timer_module->AddFirm(std::bind(&ServerLogic::LogMemoryStats, this),
+				m_memory_stat_log_span_ms, ITimerModule::EXECUTE_UNLIMIT_TIMES);
+		}
+	}
 	return ret;
 }
 
@@ -84,6 +153,8 @@ void ServerLogic::Update()
 		retCode = m_module_mgr->Update();
 		if (EModuleRetCode_Failed == retCode)
 			this->Quit();
+		// everything sent during the tick leaves here, one handoff per net worker
+		this->GetNetworkModule()->FlushSends();
 
 		long long consume_ms = m_timer_module->RealNowMs() - m_timer_module->NowMs();
 		// GlobalServerLogic->GetLogModule()->Debug(LogModule::LOGGER_ID_STDOUT, "ServerLogic consume time {0} ms", consume_ms);
@@ -96,6 +167,11 @@ void ServerLogic::Update()
 void ServerLogic::Realse()
 {
 	m_state = EServerLogicState_Release;
+	if (ITimerModule::INVALID_TIMER_ID != m_memory_stat_timer_id)
+	{
+		m_timer_module->Remove(m_memory_stat_timer_id);
+		m_memory_stat_timer_id = ITimerModule::INVALID_TIMER_ID;
+	}
 	int loop_times = 0;
 	EModuleRetCode retCode = EModuleRetCode_Succ;
 	do
@@ -125,6 +201,69 @@ void ServerLogic::Destroy()
 		m_network_agent = nullptr;
 	}
 	this->ClearInitParams();
+	m_init_params[EMoudleName_Network] = nullptr;
+	if (nullptr != m_thread_cfg_set)
+	{
+		delete m_thread_cfg_set;
+		m_thread_cfg_set = nullptr;
+	}
+}
+
+void ServerLogic::LogMemoryStats()
+{
+	std::vector<MemoryPoolMgrStat> pool_stats;
+	MemoryPoolMgrStat large_stat;
+	if (!MemoryUtil::GetStats(pool_stats, large_stat))
+		return;
+
+	LogModule *log_module = this->GetLogModule();
+	for (const MemoryPoolMgrStat &stat : pool_stats)
+	{
+		if (stat.malloc_num <= 0)
+			continue;
+		log_module->Info(LogModule::LOGGER_ID_STDOUT, 
+			"MemoryPool block_size {0}: malloc {1} free {2} live {3} peak {4} cached {5} block_set {6} alloc {7} freed {8} round_waste {9} header_waste {10}",
+			stat.block_size, stat.malloc_num, stat.free_num, stat.live_block_num, stat.peak_block_num, stat.cached_block_num,
+			stat.block_set_num, stat.block_set_alloc_num, stat.block_set_free_num, stat.round_waste_bytes, stat.header_waste_bytes);
+	}
+	log_module->Info(LogModule::LOGGER_ID_STDOUT, "MemoryPool large: malloc {0} free {1} live {2} live_bytes {3}",
+		large_stat.malloc_num, large_stat.free_num, large_stat.live_block_num, large_stat.live_bytes);
+
+	std::vector<ObjectPoolStat> object_pool_stats;
+	ObjectPoolBase::GetAllStats(object_pool_stats);
+	for (const ObjectPoolStat &stat : object_pool_stats)
+	{
+		log_module->Info(LogModule::LOGGER_ID_STDOUT, 
+			"ObjectPool {0} size {1}: live {2} peak {3} capacity {4} chunk {5} cached {6} fallback {7}",
+			stat.name, stat.object_size, stat.live_num, stat.peak_live_num, stat.capacity, stat.chunk_num, stat.cached_num, stat.fallback_num);
+	}
+
+	std::vector<NetQueueStat> net_queue_stats;
+	this->GetNetworkModule()->GetQueueStats(net_queue_stats);
+	for (size_t i = 0; i < net_queue_stats.size(); ++i)
+	{
+		const NetQueueStat &stat = net_queue_stats[i];
+		log_module->Info(LogModule::LOGGER_ID_STDOUT,
+			"NetWorker {0}: event depth {1} peak {2} capacity {3} full {4}, send depth {5} peak {6} capacity {7} full {8}",
+			i, stat.event_depth, stat.event_peak_depth, stat.event_capacity, stat.event_full_num,
+			stat.send_depth, stat.send_peak_depth, stat.send_capacity, stat.send_full_num);
+	}
+	NetSendStat net_send_stat;
+	this->GetNetworkModule()->GetSendStat(net_send_stat);
+	log_module->Info(LogModule::LOGGER_ID_STDOUT,
+		"NetSend: bytes {0}, connection high {1} low {2} close {3}, global high {4} low {5}",
+		net_send_stat.send_bytes, net_send_stat.cnn_high_num, net_send_stat.cnn_low_num, net_send_stat.cnn_close_num,
+		net_send_stat.global_high_num, net_send_stat.global_low_num);
+
+	std::vector<NetWorkerStat> net_worker_stats;
+	this->GetNetworkModule()->GetWorkerStats(net_worker_stats);
+	for (const NetWorkerStat &stat : net_worker_stats)
+	{
+		log_module->Info(LogModule::LOGGER_ID_STDOUT,
+			"NetWorker {0}: connections {1}, recv bytes {2} msgs {3} reads {4}, send bytes {5} msgs {6}, send queue {7} peak {8}, rtt avg {9} us max {10} us netid {11}",
+			stat.worker_idx, stat.cnn_num, stat.recv_bytes, stat.recv_msg_num, stat.read_num, stat.send_bytes, stat.send_msg_num,
+			stat.send_queue_bytes, stat.send_queue_peak_bytes, stat.rtt_avg_us, stat.rtt_max_us, stat.rtt_max_netid);
+	}
 }
 
 void ServerLogic::Loop()
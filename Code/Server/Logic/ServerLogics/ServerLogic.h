@@ -1,11 +1,13 @@
 #pragma once
 
+#include <string>
 #include "ModuleDef/ModuleMgr.h"
 
 class ITimerModule;
 class INetworkModule;
 class LogModule;
 class NetworkAgent;
+struct ThreadConfigSet;
 
 enum EServerLogicState
 {
@@ -39,16 +41,23 @@ public:
 protected:
 	virtual void SetupModules() = 0;
 	virtual void ClearInitParams() = 0;
+	bool SetupThreads();
 	bool Init();
 	bool Awake();
 	void Update();
 	void Realse();
 	void Destroy();
+	void LogMemoryStats();
 
 	EServerLogicState m_state = EServerLogicState_Free;
 	ModuleMgr *m_module_mgr = nullptr;
 	int m_loop_span_ms = 50;
+	long long m_memory_stat_log_span_ms = 60 * 1000; // <= 0 means never dump memory pool stats
+	long long m_memory_stat_timer_id = 0;
 	void * m_init_params[EMoudleName_Max];
+	std::string m_thread_cfg_file; // Server/ThreadConfig.csv, empty or not loadable means default thread counts and no thread pinned
+	std::string m_thread_cfg_err; // logged once the log module is up
+	ThreadConfigSet *m_thread_cfg_set = nullptr;
 
 	ITimerModule *m_timer_module;
 	NetworkAgent *m_network_agent = nullptr;
@@ -0,0 +1,96 @@
+#include "ThreadConfig.h"
+#include <fstream>
+#include "Utils/ConfigUtil.h"
+
+static const int THREAD_CFG_FIELD_NUM = 5; // id,name,thread_num,cpus,impl
+
+static void TrimStr(std::string &s)
+{
+	size_t begin = s.find_first_not_of(" \t\r");
+	size_t end = s.find_last_not_of(" \t\r");
+	s = std::string::npos == begin ? "" : s.substr(begin, end - begin + 1);
+}
+
+// unlike ConfigUtil::SplitStr, the empty fields are kept
+static std::vector<std::string> SplitFields(const std::string &line)
+{
+	std::vector<std::string> fields;
+	size_t begin = 0;
+	while (true)
+	{
+		size_t end = line.find(',', begin);
+		fields.push_back(line.substr(begin, std::string::npos == end ? std::string::npos : end - begin));
+		TrimStr(fields.back());
+		if (std::string::npos == end)
+			break;
+		begin = end + 1;
+	}
+	return fields;
+}
+
+ThreadConfigSet::~ThreadConfigSet()
+{
+	for (auto cfg : cfg_vec)
+	{
+		delete cfg;
+	}
+}
+
+bool ThreadConfigSet::Load(const std::string &file_path, std::string &err)
+{
+	std::ifstream fs(file_path);
+	if (!fs.is_open())
+	{
+		err = "can not open " + file_path;
+		return false;
+	}
+	std::string line;
+	int row = 0;
+	while (std::getline(fs, line))
+	{
+		// the first row is the header
+		if (++row <= 1)
+			continue;
+		TrimStr(line);
+		if (line.empty())
+			continue;
+		std::vector<std::string> fields = SplitFields(line);
+		int id = 0;
+		int thread_num = 0;
+		std::vector<int> cpus;
+		if (fields.size() < THREAD_CFG_FIELD_NUM
+			|| !ConfigUtil::Str2BaseValue(fields[0], id)
+			|| !ConfigUtil::Str2BaseValue(fields[2], thread_num)
+			|| !ConfigUtil::Str2Vec(fields[3], cpus))
+		{
+			err = file_path + " bad row " + std::to_string(row);
+			return false;
+		}
+		if (nullptr != this->Get(id))
+		{
+			err = file_path + " repeated id " + std::to_string(id);
+			return false;
+		}
+		ThreadConfig *cfg = this->Add(id, fields[1], thread_num, fields[4]);
+		cfg->cpus = cpus;
+	}
+	return true;
+}
+
+ThreadConfig * ThreadConfigSet::Add(int id, const std::string &name, int thread_num, const std::string &impl)
+{
+	ThreadConfig *cfg = new ThreadConfig();
+	cfg->id = id;
+	cfg->name = name;
+	cfg->thread_num = thread_num;
+	cfg->impl = impl;
+	cfg_vec.push_back(cfg);
+	id_to_cfg[id] = cfg;
+	return cfg;
+}
+
+ThreadConfig * ThreadConfigSet::Get(int id)
+{
+	auto it = id_to_cfg.find(id);
+	return id_to_cfg.end() == it ? nullptr : it->second;
+}
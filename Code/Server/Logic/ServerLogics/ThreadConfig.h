@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+
+// a row of Config/Server/ThreadConfig.csv, id is EThreadCfgId
+struct ThreadConfig
+{
+	int id = 0;
+	std::string name;
+	int thread_num = 0;
+	std::vector<int> cpus; // like 0;2, empty means not pinned
+	std::string impl;
+};
+
+// the threads of the server. it is server only, so it is read here but not generated by the excel tool
+struct ThreadConfigSet
+{
+	~ThreadConfigSet();
+	// false and err is set when the file can not be read or a row is bad
+	bool Load(const std::string &file_path, std::string &err);
+	ThreadConfig * Add(int id, const std::string &name, int thread_num, const std::string &impl);
+	ThreadConfig * Get(int id);
+
+	std::vector<ThreadConfig *> cfg_vec;
+	std::map<int, ThreadConfig *> id_to_cfg;
+};
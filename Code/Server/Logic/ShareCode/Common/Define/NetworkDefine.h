@@ -9,4 +9,12 @@ namespace Net
 	static const int PROTOCOL_LEN_DESCRIPT_SIZE = sizeof(uint32_t);
 	static const int PROTOCOL_CONTENT_MAX_SIZE = 4096;
 	static const int PROTOCOL_MAX_SIZE = PROTOCOL_LEN_DESCRIPT_SIZE + PROTOCOL_CONTENT_MAX_SIZE;
+
+	// the high bit of the protocol id in the head marks a compressed msg: the raw length as uint32, then the FastLZ block of the msg
+	static const uint32_t PROTOCOL_ID_COMPRESS_FLAG = 0x80000000;
+	// sent by NetworkAgent to tell the peer what it can take, the msg is a uint32 of NET_OPTION_* bits. above every game protocol id
+	static const int PROTOCOL_ID_NET_OPTION = 0x7fff0001;
+	static const uint32_t NET_OPTION_DECOMPRESS = 1;
+	// the most a compressed msg may inflate to
+	static const uint32_t COMPRESS_RAW_MAX_SIZE = 4 * 1024 * 1024;
 }
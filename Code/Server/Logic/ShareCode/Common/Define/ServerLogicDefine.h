@@ -0,0 +1,9 @@
+#pragma once
+
+// ids of the rows in Server/ThreadConfig.csv
+enum EThreadCfgId
+{
+	EThreadCfgId_Logic = 1,
+	EThreadCfgId_NetWorker = 2,
+	EThreadCfgId_CnnTask = 3,
+};
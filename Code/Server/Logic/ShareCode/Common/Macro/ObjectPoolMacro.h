@@ -0,0 +1,16 @@
+#pragma once
+
+#include "MemoryPool/ObjectPool.h"
+
+// like NewDelOperaDeclaration, but new/delete of the class are served by a freelist pool of its own
+#define ObjectPoolOperaDeclaration(class_name)			\
+public:													\
+	void * operator new(size_t size);					\
+	void operator delete(void *ptr, size_t size);		\
+	static ObjectPool<class_name> & GetObjectPool()
+
+// the pool is never destroyed, so objects deleted during static destruction are still safe
+#define ObjectPoolOperaImplement(class_name, is_thread_safe) \
+ObjectPool<class_name> & class_name::GetObjectPool() { static ObjectPool<class_name> *pool = new ObjectPool<class_name>(#class_name, is_thread_safe); return *pool; } \
+void * class_name::operator new(size_t size) { return class_name::GetObjectPool().Malloc(size); } \
+void class_name::operator delete(void *ptr, size_t size) { class_name::GetObjectPool().Free(ptr, size); }
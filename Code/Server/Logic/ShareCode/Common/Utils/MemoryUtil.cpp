@@ -1,7 +1,9 @@
 #include "MemoryUtil.h"
+#include "MemoryPool/FrameArena.h"
 #include <algorithm>
 
 static MemoryPoolMgr *memory_pool_mgr = nullptr;
+static thread_local FrameArena frame_arena(64 * 1024);
 
 void WrapFree(void *ptr, size_t size)
 {
@@ -21,12 +23,10 @@ bool MemoryUtil::Init()
 	if (nullptr != memory_pool_mgr)
 		return false;
 
+	// header-free blocks, every block greater than 8 bytes is 16 bytes aligned
 	std::vector<uint32_t> block_sizes;
-	for (int i = 0 + 8; i <= 128; i = i + 8) // (0, 128]
-	{
-		block_sizes.push_back(i);
-	}
-	for (int i = 128 + 16; i <= 512; i = i + 16) // (128, 512]
+	block_sizes.push_back(8);
+	for (int i = 0 + 16; i <= 512; i = i + 16) // (8, 512]
 	{
 		block_sizes.push_back(i);
 	}
@@ -35,7 +35,8 @@ bool MemoryUtil::Init()
 		block_sizes.push_back(i);
 	}
 
-	memory_pool_mgr = new MemoryPoolMgr(block_sizes, 4 * 1024, 8, 64);
+	// 64KB spans carved from 2MB chunks, which may be backed by one huge page each
+	memory_pool_mgr = new MemoryPoolMgr(block_sizes, 4 * 1024, 8, 64, 64 * 1024, 2 * 1024 * 1024, true);
 	return nullptr != memory_pool_mgr;
 }
 
@@ -57,16 +58,7 @@ void MemoryUtil::Free(void * ptr)
 
 void * MemoryUtil::Realloc(void * ptr, size_t size)
 {
-	void *new_ptr = memory_pool_mgr->Malloc(size);
-	if (nullptr != ptr)
-	{
-		void *real_ptr = (char *)ptr - MemoryPoolMgr::BLOCK_SIZE_DESCRIPT_LEN;
-		uint32_t old_size = *(uint32_t *)real_ptr;
-		uint32_t copy_size = std::min(old_size, size);
-		memcpy(new_ptr, ptr, copy_size);
-		memory_pool_mgr->Free(ptr);
-	}
-	return new_ptr;
+	return memory_pool_mgr->Realloc(ptr, size);
 }
 
 google::protobuf::Arena * MemoryUtil::NewArena()
@@ -77,6 +69,19 @@ google::protobuf::Arena * MemoryUtil::NewArena()
 	return new google::protobuf::Arena(option);
 }
 
+FrameArena * MemoryUtil::GetFrameArena()
+{
+	return &frame_arena;
+}
+
+bool MemoryUtil::GetStats(std::vector<MemoryPoolMgrStat> &pool_stats, MemoryPoolMgrStat &large_stat)
+{
+	if (nullptr == memory_pool_mgr)
+		return false;
+	memory_pool_mgr->GetStats(pool_stats, large_stat);
+	return true;
+}
+
 void * Malloc(size_t size)
 {
 	return MemoryUtil::Malloc(size);
@@ -3,6 +3,8 @@
 #include "MemoryPool/MemoryPoolMgr.h"
 #include "google/protobuf/arena.h"
 
+class FrameArena;
+
 class MemoryUtil
 {
 public:
@@ -14,6 +16,9 @@ public:
 	static void Free(void *ptr);
 	static void * Realloc(void *ptr, size_t size);
 	static google::protobuf::Arena * NewArena();
+	// arena of the calling thread for memory living within one tick, the thread owner calls Reset once per tick
+	static FrameArena * GetFrameArena();
+	static bool GetStats(std::vector<MemoryPoolMgrStat> &pool_stats, MemoryPoolMgrStat &large_stat);
 };
 
 void * Malloc(size_t size);
@@ -1,14 +1,20 @@
 #pragma once
 #include "CommonModules/Network/INetworkHandler.h"
 #include "Network/Utils/LenCtxStreamParserEx.h"
+#include "Network/Utils/LenCtxNetFramer.h"
 #include "Common/Macro/MemoryPoolMacro.h"
 
 class LenCtxNetStreamCnnHandler : public INetConnectHander
 {
 	NewDelOperaDeclaration;
 public:
-	LenCtxNetStreamCnnHandler(uint32_t max_per_ctx_len) 
-		: m_parser(max_per_ctx_len) {}
+	// is_frame_on_net_worker moves the parsing to the net worker thread, messages then come by OnRecvMsg
+	LenCtxNetStreamCnnHandler(uint32_t max_per_ctx_len, bool is_frame_on_net_worker = false) 
+		: m_parser(max_per_ctx_len) 
+	{
+		if (is_frame_on_net_worker)
+			m_framer = std::make_shared<FramerType>(max_per_ctx_len);
+	}
 	virtual ~LenCtxNetStreamCnnHandler() {}
 	virtual void OnClose(int err_num) = 0;
 	virtual void OnOpen(int err_num) = 0;
@@ -22,9 +28,14 @@ public:
 				this->OnParseFail();
 		}
 	}
+	virtual std::shared_ptr<INetFramer> GetFramer() { return m_framer; }
+	virtual void OnRecvMsg(char *data, uint32_t len) { this->OnParseSuccess(data, len); }
+	virtual void OnFrameFail() { this->OnParseFail(); }
 
 protected:
 	virtual void OnParseSuccess(char *data, uint32_t len) = 0;
 	virtual void OnParseFail() = 0;
 	LenCtxStreamParserEx<uint32_t, NetSteamLenPraser<uint32_t, sizeof(uint32_t)>> m_parser;
+	using FramerType = LenCtxNetFramer<uint32_t, NetSteamLenPraser<uint32_t, sizeof(uint32_t)>>;
+	std::shared_ptr<FramerType> m_framer;
 };
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "CommonModules/Network/INetFramer.h"
+#include "Network/Utils/LenCtxStreamParserEx.h"
+
+// the framing rule of LenCtxStreamParserEx, for connections whose stream is split on the net worker thread
+template <typename T, typename LenParseType = StreamLenPraser<T, sizeof(T)>>
+class LenCtxNetFramer : public INetFramer
+{
+	static_assert(LenParseType::LEN_DESCRIPT_SIZE <= INetFramer::MAX_LEN_DESCRIPT_SIZE, "LEN_DESCRIPT_SIZE is too big");
+public:
+	LenCtxNetFramer(uint32_t max_buffer_size) : m_max_buffer_size(max_buffer_size) {}
+	virtual ~LenCtxNetFramer() {}
+
+	virtual uint32_t LenDescriptSize() { return LenParseType::LEN_DESCRIPT_SIZE; }
+
+	virtual uint32_t ParseContentLen(char *head)
+	{
+		uint32_t ctx_len = LenParseType::Prase(head, LenParseType::LEN_DESCRIPT_SIZE);
+		// same limit as LenCtxStreamParserEx, whose buffer holds the head too
+		if (ctx_len <= 0 || ctx_len > m_max_buffer_size - LenParseType::LEN_DESCRIPT_SIZE)
+			return 0;
+		return ctx_len;
+	}
+
+protected:
+	uint32_t m_max_buffer_size = 0;
+};
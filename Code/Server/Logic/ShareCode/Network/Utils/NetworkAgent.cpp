@@ -2,6 +2,13 @@
 #include "CommonModules/Network/INetworkModule.h"
 #include "Common/Utils/MemoryUtil.h"
 #include "Utils/PlatformCompat.h"
+#include "Utils/FastLZ.h"
+#include <chrono>
+
+static int64_t NowUs()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 // field-size	       4                       4                   4	
 // field		     ctx_len			   protocol_id		      msg
@@ -12,52 +19,248 @@ bool NetworkAgent::Send(NetId netid, int protocol_id, char *msg, uint32_t msg_le
 		return false;
 	if (msg_len > 0 && nullptr == msg)
 		return false;
+	if (this->IsCompressTo(netid, msg_len))
+		return this->SendCompressed(netid, protocol_id, msg, msg_len);
 
-	uint32_t ctx_len = sizeof(protocol_id) + msg_len;
-	*(uint32_t *)m_send_help_buffer = (uint32_t)htonl(ctx_len);
-	*(int *)(m_send_help_buffer + Net::PROTOCOL_LEN_DESCRIPT_SIZE) = htonl(protocol_id);
-	bool ret = m_network->Send(netid, m_send_help_buffer, sizeof(m_send_help_buffer));
-	if (nullptr != msg && msg_len > 0)
-		ret = ret && m_network->Send(netid, msg, msg_len);
-	return ret;
+	char *buffer = this->ReserveSend(netid, protocol_id, msg_len);
+	if (nullptr == buffer)
+		return false;
+	if (msg_len > 0)
+		memcpy(buffer + SEND_HEAD_LEN, msg, msg_len);
+	return m_network->CommitSend(netid, SEND_HEAD_LEN + msg_len);
 }
 
 bool NetworkAgent::Send(NetId netid, int protocol_id, google::protobuf::Message *msg)
 {
+	if (netid <= 0 || nullptr == msg)
+		return false;
+
+	// serialize straight behind the head, no staging buffer and no second copy
+	uint32_t msg_len = msg->ByteSize();
+	if (this->IsCompressTo(netid, msg_len))
+		return this->SendCompressed(netid, protocol_id, this->SerializeToCompress(msg, msg_len), msg_len);
+	char *buffer = this->ReserveSend(netid, protocol_id, msg_len);
+	if (nullptr == buffer)
+		return false;
+	if (msg_len > 0)
+		msg->SerializePartialToArray(buffer + SEND_HEAD_LEN, msg_len);
+	return m_network->CommitSend(netid, SEND_HEAD_LEN + msg_len);
+}
+
+bool NetworkAgent::Multicast(NetId *netids, uint32_t netid_num, int protocol_id, char *msg, uint32_t msg_len)
+{
+	if (nullptr == netids || netid_num <= 0)
+		return false;
+	if (msg_len > 0 && nullptr == msg)
+		return false;
+	if (this->IsCompressToAll(netids, netid_num, msg_len))
+		return this->MulticastCompressed(netids, netid_num, protocol_id, msg, msg_len);
+
+	char *buffer = this->ReserveMulticast(protocol_id, msg_len);
+	if (nullptr == buffer)
+		return false;
+	if (msg_len > 0)
+		memcpy(buffer + SEND_HEAD_LEN, msg, msg_len);
+	return m_network->CommitMulticast(netids, netid_num, SEND_HEAD_LEN + msg_len);
+}
+
+bool NetworkAgent::Multicast(NetId *netids, uint32_t netid_num, int protocol_id, google::protobuf::Message *msg)
+{
+	if (nullptr == netids || netid_num <= 0 || nullptr == msg)
+		return false;
+
 	uint32_t msg_len = msg->ByteSize();
-	if (!this->CheckExpendBuffer(msg_len))
+	if (this->IsCompressToAll(netids, netid_num, msg_len))
+		return this->MulticastCompressed(netids, netid_num, protocol_id, this->SerializeToCompress(msg, msg_len), msg_len);
+	char *buffer = this->ReserveMulticast(protocol_id, msg_len);
+	if (nullptr == buffer)
 		return false;
-	msg->SerializePartialToArray(m_buffer, msg_len);
-	return this->Send(netid, protocol_id, m_buffer, msg_len);
+	if (msg_len > 0)
+		msg->SerializePartialToArray(buffer + SEND_HEAD_LEN, msg_len);
+	return m_network->CommitMulticast(netids, netid_num, SEND_HEAD_LEN + msg_len);
 }
 
 void NetworkAgent::Close(NetId netid)
 {
 	m_network->Close(netid);
+	m_peer_opts.erase(netid);
 }
 
-bool NetworkAgent::CheckExpendBuffer(uint32_t lower_limit)
+bool NetworkAgent::SendNetOption(NetId netid)
 {
-	if (m_buffer_capacity >= lower_limit)
+	uint32_t option = htonl(Net::NET_OPTION_DECOMPRESS);
+	if (!this->Send(netid, Net::PROTOCOL_ID_NET_OPTION, (char *)&option, sizeof(option)))
+		return false;
+	m_peer_opts[netid].is_option_sent = true;
+	return true;
+}
+
+bool NetworkAgent::OnRecv(NetId netid, char *&data, uint32_t &len)
+{
+	if (nullptr == data || len < sizeof(int))
 		return true;
-	if (m_buffer_capacity <= 0) m_buffer_capacity = BUFFER_INIT_SIZE;
-	while (m_buffer_capacity < lower_limit)
-		m_buffer_capacity += BUFFER_INCREASE_STEP;
-	if (nullptr == m_buffer)
-		m_buffer = (char *)Malloc(m_buffer_capacity);
-	else
-		m_buffer = (char *)Realloc(m_buffer, m_buffer_capacity);
-	assert(m_buffer);
-	return NULL != m_buffer;
+	uint32_t protocol_id = ntohl(*(uint32_t *)data);
+	if (Net::PROTOCOL_ID_NET_OPTION == (int)protocol_id)
+	{
+		uint32_t option = 0;
+		if (len >= sizeof(int) + sizeof(option))
+			option = ntohl(*(uint32_t *)(data + sizeof(int)));
+		PeerOpt &peer_opt = m_peer_opts[netid];
+		peer_opt.can_decompress = 0 != (option & Net::NET_OPTION_DECOMPRESS);
+		// answered once, so both ends know each other whichever starts
+		if (!peer_opt.is_option_sent)
+			this->SendNetOption(netid);
+		return false;
+	}
+	if (0 != m_pong_protocol_id && m_pong_protocol_id == (int)(protocol_id & ~Net::PROTOCOL_ID_COMPRESS_FLAG))
+		this->CheckPong(netid);
+	if (0 == (protocol_id & Net::PROTOCOL_ID_COMPRESS_FLAG))
+		return true;
+
+	// protocol id | flag, raw len, FastLZ block
+	static const uint32_t ZIP_HEAD_LEN = sizeof(int) + sizeof(uint32_t);
+	uint32_t raw_len = len >= ZIP_HEAD_LEN ? ntohl(*(uint32_t *)(data + sizeof(int))) : 0;
+	bool is_ok = raw_len > 0 && raw_len <= Net::COMPRESS_RAW_MAX_SIZE;
+	if (is_ok)
+	{
+		if (m_inflate_buf.size() < sizeof(int) + raw_len)
+			m_inflate_buf.resize(sizeof(int) + raw_len);
+		*(uint32_t *)m_inflate_buf.data() = htonl(protocol_id & ~Net::PROTOCOL_ID_COMPRESS_FLAG);
+		is_ok = raw_len == FastLZ::Decompress(data + ZIP_HEAD_LEN, len - ZIP_HEAD_LEN, m_inflate_buf.data() + sizeof(int), raw_len);
+	}
+	if (!is_ok)
+	{
+		this->Close(netid);
+		return false;
+	}
+	data = m_inflate_buf.data();
+	len = sizeof(int) + raw_len;
+	return true;
 }
 
-NetworkAgent::~NetworkAgent()
+void NetworkAgent::OnClose(NetId netid)
+{
+	m_peer_opts.erase(netid);
+}
+
+void NetworkAgent::SetRttProtocol(int ping_protocol_id, int pong_protocol_id)
+{
+	m_ping_protocol_id = ping_protocol_id;
+	m_pong_protocol_id = pong_protocol_id;
+}
+
+bool NetworkAgent::SendPing(NetId netid)
 {
-	if (nullptr != m_buffer)
+	if (0 == m_ping_protocol_id || !this->Send(netid, m_ping_protocol_id, nullptr, 0))
+		return false;
+	// a ping still unanswered keeps its time, so a lost pong shows up as one long round trip
+	PeerOpt &peer_opt = m_peer_opts[netid];
+	if (0 == peer_opt.ping_us)
+		peer_opt.ping_us = NowUs();
+	return true;
+}
+
+void NetworkAgent::CheckPong(NetId netid)
+{
+	auto it = m_peer_opts.find(netid);
+	if (m_peer_opts.end() == it || 0 == it->second.ping_us)
+		return;
+	int64_t rtt_us = NowUs() - it->second.ping_us;
+	it->second.ping_us = 0;
+	m_network->AddRttSample(netid, rtt_us > 0 ? (uint32_t)rtt_us : 0);
+}
+
+char * NetworkAgent::ReserveSend(NetId netid, int protocol_id, uint32_t msg_len)
+{
+	char *buffer = m_network->ReserveSend(netid, SEND_HEAD_LEN + msg_len);
+	if (nullptr == buffer)
+		return nullptr;
+	WriteSendHead(buffer, protocol_id, msg_len);
+	return buffer;
+}
+
+char * NetworkAgent::ReserveMulticast(int protocol_id, uint32_t msg_len)
+{
+	char *buffer = m_network->ReserveMulticast(SEND_HEAD_LEN + msg_len);
+	if (nullptr == buffer)
+		return nullptr;
+	WriteSendHead(buffer, protocol_id, msg_len);
+	return buffer;
+}
+
+void NetworkAgent::WriteSendHead(char *buffer, int protocol_id, uint32_t msg_len)
+{
+	uint32_t ctx_len = sizeof(protocol_id) + msg_len;
+	*(uint32_t *)buffer = (uint32_t)htonl(ctx_len);
+	*(int *)(buffer + Net::PROTOCOL_LEN_DESCRIPT_SIZE) = htonl(protocol_id);
+}
+
+bool NetworkAgent::IsCompressTo(NetId netid, uint32_t msg_len)
+{
+	if (0 == m_compress_min_len || msg_len < m_compress_min_len)
+		return false;
+	auto it = m_peer_opts.find(netid);
+	return m_peer_opts.end() != it && it->second.can_decompress;
+}
+
+bool NetworkAgent::IsCompressToAll(NetId *netids, uint32_t netid_num, uint32_t msg_len)
+{
+	// the buffer is shared, so it is compressed only when every receiver decompresses
+	if (0 == m_compress_min_len || msg_len < m_compress_min_len)
+		return false;
+	for (uint32_t i = 0; i < netid_num; ++i)
 	{
-		Free(m_buffer);
-		m_buffer = nullptr;
+		if (netids[i] > 0 && !this->IsCompressTo(netids[i], msg_len))
+			return false;
 	}
+	return true;
+}
+
+char * NetworkAgent::SerializeToCompress(google::protobuf::Message *msg, uint32_t msg_len)
+{
+	if (m_serialize_buf.size() < msg_len)
+		m_serialize_buf.resize(msg_len);
+	msg->SerializePartialToArray(m_serialize_buf.data(), msg_len);
+	return m_serialize_buf.data();
+}
+
+bool NetworkAgent::SendCompressed(NetId netid, int protocol_id, const char *msg, uint32_t msg_len)
+{
+	char *buffer = m_network->ReserveSend(netid, SEND_HEAD_LEN + sizeof(uint32_t) + FastLZ::MaxCompressedLen(msg_len));
+	if (nullptr == buffer)
+		return false;
+	return m_network->CommitSend(netid, WriteCompressed(buffer, protocol_id, msg, msg_len));
+}
+
+bool NetworkAgent::MulticastCompressed(NetId *netids, uint32_t netid_num, int protocol_id, const char *msg, uint32_t msg_len)
+{
+	char *buffer = m_network->ReserveMulticast(SEND_HEAD_LEN + sizeof(uint32_t) + FastLZ::MaxCompressedLen(msg_len));
+	if (nullptr == buffer)
+		return false;
+	return m_network->CommitMulticast(netids, netid_num, WriteCompressed(buffer, protocol_id, msg, msg_len));
+}
+
+// field-size	       4                       4                        4                   
+// field		     ctx_len			   protocol_id		         raw_len           block
+// field value  8+block_len	    val(protocol_id)|flag	      msg_len         FastLZ(msg)
+uint32_t NetworkAgent::WriteCompressed(char *buffer, int protocol_id, const char *msg, uint32_t msg_len)
+{
+	char *block = buffer + SEND_HEAD_LEN + sizeof(uint32_t);
+	uint32_t block_len = FastLZ::Compress(msg, msg_len, block);
+	if (sizeof(uint32_t) + block_len >= msg_len)
+	{
+		// the reserved space holds the raw msg as well
+		WriteSendHead(buffer, protocol_id, msg_len);
+		memcpy(buffer + SEND_HEAD_LEN, msg, msg_len);
+		return SEND_HEAD_LEN + msg_len;
+	}
+	WriteSendHead(buffer, (int)((uint32_t)protocol_id | Net::PROTOCOL_ID_COMPRESS_FLAG), sizeof(uint32_t) + block_len);
+	*(uint32_t *)(buffer + SEND_HEAD_LEN) = htonl(msg_len);
+	return SEND_HEAD_LEN + sizeof(uint32_t) + block_len;
+}
+
+NetworkAgent::~NetworkAgent()
+{
 }
 #include "Common/Utils/MemoryUtil.h"
-NewDelOperaImplement(NetworkAgent);
\ No newline at end of file
+NewDelOperaImplement(NetworkAgent);
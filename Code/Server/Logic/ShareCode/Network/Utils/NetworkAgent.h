@@ -5,6 +5,8 @@ class INetworkModule;
 #include "Common/Define/NetworkDefine.h"
 #include "Common/Macro/MemoryPoolMacro.h"
 #include <google/protobuf/message.h>
+#include <unordered_map>
+#include <vector>
 
 class NetworkAgent
 {
@@ -15,14 +17,53 @@ public:
 
 	bool Send(NetId netid, int protocol_id, char *msg, uint32_t msg_len);
 	bool Send(NetId netid, int protocol_id, google::protobuf::Message *msg);
+	// the msg is built once and shared by all the netids
+	bool Multicast(NetId *netids, uint32_t netid_num, int protocol_id, char *msg, uint32_t msg_len);
+	bool Multicast(NetId *netids, uint32_t netid_num, int protocol_id, google::protobuf::Message *msg);
 	void Close(NetId netid);
 
+	// msgs of at least min_len bytes are sent compressed to the peers that said they can decompress, 0 turns it off
+	void SetCompressMinLen(uint32_t min_len) { m_compress_min_len = min_len; }
+	// tells the peer that this side decompresses, a peer that sends its option first is answered by OnRecv
+	bool SendNetOption(NetId netid);
+	// takes what a LenCtx handler parsed, the protocol id and the msg. a compressed msg is inflated into a buffer of the agent,
+	// data and len then point at it until the next call. false when there is nothing for the caller: a net option of the peer,
+	// or a broken compressed msg, whose connection is closed
+	bool OnRecv(NetId netid, char *&data, uint32_t &len);
+	// forgets the options of the peer, called when its connection is gone
+	void OnClose(NetId netid);
+
+	// the ping the peer answers with the pong, 0 turns the timing off. the first pong after SendPing gives INetworkModule::AddRttSample
+	// a round trip as the logic thread sees it, from the send to the tick handling the pong. the pong still goes on to the caller
+	void SetRttProtocol(int ping_protocol_id, int pong_protocol_id);
+	bool SendPing(NetId netid);
+
 private:
 	INetworkModule *m_network = nullptr;
-	char m_send_help_buffer[Net::PROTOCOL_LEN_DESCRIPT_SIZE + sizeof(int)];
-	char *m_buffer = nullptr;
-	uint32_t m_buffer_capacity = 0;
-	static const int BUFFER_INIT_SIZE = 64;
-	static const int BUFFER_INCREASE_STEP = 16;
-	bool CheckExpendBuffer(uint32_t lower_limit);
+	static const uint32_t SEND_HEAD_LEN = Net::PROTOCOL_LEN_DESCRIPT_SIZE + sizeof(int);
+	// reserves head and msg in the send buffer of the tick and writes the head, the msg goes right after it
+	char * ReserveSend(NetId netid, int protocol_id, uint32_t msg_len);
+	char * ReserveMulticast(int protocol_id, uint32_t msg_len);
+	static void WriteSendHead(char *buffer, int protocol_id, uint32_t msg_len);
+
+	struct PeerOpt
+	{
+		bool is_option_sent = false;
+		bool can_decompress = false;
+		int64_t ping_us = 0; // when the ping waiting for its pong was sent, 0 if none
+	};
+	std::unordered_map<NetId, PeerOpt> m_peer_opts;
+	uint32_t m_compress_min_len = 0;
+	int m_ping_protocol_id = 0;
+	int m_pong_protocol_id = 0;
+	void CheckPong(NetId netid);
+	std::vector<char> m_serialize_buf; // a msg to compress is serialized here first
+	std::vector<char> m_inflate_buf; // protocol id and the inflated msg, handed out by OnRecv
+	bool IsCompressTo(NetId netid, uint32_t msg_len);
+	bool IsCompressToAll(NetId *netids, uint32_t netid_num, uint32_t msg_len);
+	char * SerializeToCompress(google::protobuf::Message *msg, uint32_t msg_len);
+	// the msg goes as it is when compressing does not make it smaller
+	bool SendCompressed(NetId netid, int protocol_id, const char *msg, uint32_t msg_len);
+	bool MulticastCompressed(NetId *netids, uint32_t netid_num, int protocol_id, const char *msg, uint32_t msg_len);
+	static uint32_t WriteCompressed(char *buffer, int protocol_id, const char *msg, uint32_t msg_len);
 };
\ No newline at end of file
@@ -0,0 +1,332 @@
+#include "AllocTrace.h"
+#include <random>
+#include <algorithm>
+
+namespace
+{
+	// hands out slots and keeps the live byte count of the trace under construction
+	class TraceBuilder
+	{
+	public:
+		TraceBuilder(AllocTrace &trace, const char *name, bool is_frame_scoped) : m_trace(trace)
+		{
+			m_trace.name = name;
+			m_trace.is_frame_scoped = is_frame_scoped;
+			m_trace.slot_num = 0;
+			m_trace.op_num = 0;
+			m_trace.peak_live_bytes = 0;
+			m_trace.ops.clear();
+		}
+
+		~TraceBuilder()
+		{
+			this->FreeAll();
+			m_trace.slot_num = (uint32_t)m_sizes.size();
+		}
+
+		uint32_t Malloc(uint32_t size)
+		{
+			uint32_t slot = 0;
+			if (!m_free_slots.empty())
+			{
+				slot = m_free_slots.back();
+				m_free_slots.pop_back();
+			}
+			else
+			{
+				slot = (uint32_t)m_sizes.size();
+				m_sizes.push_back(0);
+			}
+			m_sizes[slot] = size;
+			this->AddLiveBytes(size, 0);
+			this->PushOp(TraceOp::MALLOC, slot, size);
+			return slot;
+		}
+
+		void Free(uint32_t slot)
+		{
+			this->AddLiveBytes(0, m_sizes[slot]);
+			m_sizes[slot] = 0;
+			m_free_slots.push_back(slot);
+			this->PushOp(TraceOp::FREE, slot, 0);
+		}
+
+		void Realloc(uint32_t slot, uint32_t size)
+		{
+			this->AddLiveBytes(size, m_sizes[slot]);
+			m_sizes[slot] = size;
+			this->PushOp(TraceOp::REALLOC, slot, size);
+		}
+
+		void Tick()
+		{
+			TraceOp op;
+			op.type = TraceOp::TICK;
+			m_trace.ops.push_back(op);
+		}
+
+		void FreeAll()
+		{
+			for (uint32_t slot = 0; slot < m_sizes.size(); ++slot)
+			{
+				if (m_sizes[slot] > 0)
+					this->Free(slot);
+			}
+		}
+
+	private:
+		AllocTrace &m_trace;
+		std::vector<uint32_t> m_sizes; // 0 for free slots
+		std::vector<uint32_t> m_free_slots;
+		uint64_t m_live_bytes = 0;
+
+		void PushOp(uint8_t type, uint32_t slot, uint32_t size)
+		{
+			TraceOp op;
+			op.type = type;
+			op.slot = slot;
+			op.size = size;
+			m_trace.ops.push_back(op);
+			++m_trace.op_num;
+		}
+
+		void AddLiveBytes(uint64_t add_bytes, uint64_t sub_bytes)
+		{
+			m_live_bytes = m_live_bytes + add_bytes - sub_bytes;
+			if (m_live_bytes > m_trace.peak_live_bytes)
+				m_trace.peak_live_bytes = m_live_bytes;
+		}
+	};
+
+	uint32_t ScaleTickNum(uint32_t tick_num, double scale)
+	{
+		uint32_t ret = (uint32_t)(tick_num * scale);
+		return ret > 0 ? ret : 1;
+	}
+
+	uint32_t RandRange(std::mt19937 &rng, uint32_t min_val, uint32_t max_val)
+	{
+		return min_val + rng() % (max_val - min_val + 1);
+	}
+
+	// mostly small with a long tail, as packets and serialized messages are
+	uint32_t RandSkewedSize(std::mt19937 &rng, uint32_t min_size, uint32_t max_shift)
+	{
+		uint32_t base = min_size << (rng() % (rng() % (max_shift + 1) + 1));
+		return base + rng() % base;
+	}
+}
+
+void AllocTraceFactory::MakeConnectionChurn(AllocTrace &trace, double scale, uint32_t seed)
+{
+	// sizes follow NetConnectionData, ConnectionHandler, MsgParser buffer, bufferevent and the logic side agent
+	const uint32_t CNN_OBJ_SIZES[] = { 96, 160, 256, 400, 128 };
+	const uint32_t CNN_OBJ_NUM = sizeof(CNN_OBJ_SIZES) / sizeof(CNN_OBJ_SIZES[0]);
+	const uint32_t PARSER_BUFFER_IDX = 2;
+	const uint32_t MAX_CNN_NUM = 2000;
+	const uint32_t MAX_PARSER_BUFFER_SIZE = 64 * 1024;
+	const uint32_t NET_WORK_DATA_SIZE = 48;
+
+	struct Cnn
+	{
+		uint32_t slots[CNN_OBJ_NUM];
+		uint32_t parser_buffer_size;
+	};
+
+	std::mt19937 rng(seed);
+	TraceBuilder builder(trace, "connection_churn", false);
+	std::vector<Cnn> cnns;
+	std::vector<uint32_t> last_tick_recv_slots;
+	std::vector<uint32_t> recv_slots;
+	uint32_t tick_num = ScaleTickNum(2000, scale);
+	for (uint32_t tick = 0; tick < tick_num; ++tick)
+	{
+		// buffers handed to the logic thread last tick are consumed now
+		for (uint32_t slot : last_tick_recv_slots)
+			builder.Free(slot);
+		last_tick_recv_slots.clear();
+
+		uint32_t connect_num = RandRange(rng, 0, 20);
+		for (uint32_t i = 0; i < connect_num && cnns.size() < MAX_CNN_NUM; ++i)
+		{
+			Cnn cnn;
+			for (uint32_t k = 0; k < CNN_OBJ_NUM; ++k)
+				cnn.slots[k] = builder.Malloc(CNN_OBJ_SIZES[k]);
+			cnn.parser_buffer_size = CNN_OBJ_SIZES[PARSER_BUFFER_IDX];
+			cnns.push_back(cnn);
+		}
+
+		for (Cnn &cnn : cnns)
+		{
+			if (rng() % 10 >= 3)
+				continue;
+			uint32_t recv_size = RandSkewedSize(rng, 32, 6);
+			recv_slots.push_back(builder.Malloc(recv_size));
+			recv_slots.push_back(builder.Malloc(NET_WORK_DATA_SIZE));
+			if (recv_size > cnn.parser_buffer_size && cnn.parser_buffer_size < MAX_PARSER_BUFFER_SIZE)
+			{
+				cnn.parser_buffer_size *= 2;
+				builder.Realloc(cnn.slots[PARSER_BUFFER_IDX], cnn.parser_buffer_size);
+			}
+		}
+		last_tick_recv_slots.swap(recv_slots);
+
+		uint32_t disconnect_num = RandRange(rng, 0, 20);
+		for (uint32_t i = 0; i < disconnect_num && !cnns.empty(); ++i)
+		{
+			uint32_t idx = rng() % cnns.size();
+			for (uint32_t k = 0; k < CNN_OBJ_NUM; ++k)
+				builder.Free(cnns[idx].slots[k]);
+			cnns[idx] = cnns.back();
+			cnns.pop_back();
+		}
+		builder.Tick();
+	}
+}
+
+void AllocTraceFactory::MakeSceneContainers(AllocTrace &trace, double scale, uint32_t seed)
+{
+	const uint32_t UNIT_NUM = 200;
+	const uint32_t GRID_ID_SIZE = 4;
+	const uint32_t HASH_NODE_SIZE = 24;
+	const uint32_t SYNC_MSG_SIZE = 32;
+
+	std::mt19937 rng(seed);
+	TraceBuilder builder(trace, "scene_containers", true);
+	std::vector<uint32_t> tick_slots;
+	uint32_t tick_num = ScaleTickNum(300, scale);
+	for (uint32_t tick = 0; tick < tick_num; ++tick)
+	{
+		for (uint32_t unit = 0; unit < UNIT_NUM; ++unit)
+		{
+			// grid vector growing by doubling, as std::vector does
+			uint32_t grid_num = RandRange(rng, 4, 40);
+			uint32_t grid_vec = builder.Malloc(GRID_ID_SIZE);
+			for (uint32_t capacity = 2; capacity / 2 < grid_num; capacity *= 2)
+				builder.Realloc(grid_vec, capacity * GRID_ID_SIZE);
+			tick_slots.push_back(grid_vec);
+
+			// grid set of the view diff: bucket array, one node per grid and a rehash
+			tick_slots.push_back(builder.Malloc(13 * sizeof(void *)));
+			uint32_t node_num = RandRange(rng, 5, 30);
+			for (uint32_t i = 0; i < node_num; ++i)
+			{
+				tick_slots.push_back(builder.Malloc(HASH_NODE_SIZE));
+				if (13 == i)
+					tick_slots.push_back(builder.Malloc(29 * sizeof(void *)));
+			}
+
+			// sync messages of the unit
+			uint32_t msg_num = RandRange(rng, 0, 16);
+			if (msg_num > 0)
+			{
+				uint32_t msg_vec = builder.Malloc(SYNC_MSG_SIZE);
+				for (uint32_t capacity = 2; capacity / 2 < msg_num; capacity *= 2)
+					builder.Realloc(msg_vec, capacity * SYNC_MSG_SIZE);
+				tick_slots.push_back(msg_vec);
+			}
+		}
+
+		// containers die in the reverse order of their construction
+		for (auto it = tick_slots.rbegin(); it != tick_slots.rend(); ++it)
+			builder.Free(*it);
+		tick_slots.clear();
+		builder.Tick();
+	}
+}
+
+void AllocTraceFactory::MakeProtobufArenaBlocks(AllocTrace &trace, double scale, uint32_t seed)
+{
+	// google::protobuf::Arena defaults: first block 256 bytes, doubling up to 8KB, bigger messages get a block of their own
+	const uint32_t SCENE_NUM = 16;
+	const uint32_t START_BLOCK_SIZE = 256;
+	const uint32_t MAX_BLOCK_SIZE = 8 * 1024;
+
+	std::mt19937 rng(seed);
+	TraceBuilder builder(trace, "protobuf_arena_blocks", true);
+	std::vector<uint32_t> tick_slots;
+	uint32_t tick_num = ScaleTickNum(2000, scale);
+	for (uint32_t tick = 0; tick < tick_num; ++tick)
+	{
+		for (uint32_t scene = 0; scene < SCENE_NUM; ++scene)
+		{
+			uint32_t msg_num = RandRange(rng, 8, 64);
+			uint32_t block_size = START_BLOCK_SIZE;
+			uint32_t block_left = 0;
+			for (uint32_t i = 0; i < msg_num; ++i)
+			{
+				uint32_t msg_size = RandSkewedSize(rng, 64, 7);
+				if (msg_size > MAX_BLOCK_SIZE)
+				{
+					tick_slots.push_back(builder.Malloc(msg_size));
+					continue;
+				}
+				if (msg_size > block_left)
+				{
+					while (block_size < msg_size)
+						block_size *= 2;
+					tick_slots.push_back(builder.Malloc(block_size));
+					block_left = block_size;
+					if (block_size < MAX_BLOCK_SIZE)
+						block_size *= 2;
+				}
+				block_left -= msg_size;
+			}
+		}
+
+		// Arena::Reset of every scene
+		for (uint32_t slot : tick_slots)
+			builder.Free(slot);
+		tick_slots.clear();
+		builder.Tick();
+	}
+}
+
+void AllocTraceFactory::MakeTimerAddRemove(AllocTrace &trace, double scale, uint32_t seed)
+{
+	const uint32_t TIMER_ITEM_SIZE = 64;
+	const uint32_t RBTREE_NODE_SIZE = 48;
+	const uint32_t STEADY_TIMER_NUM = 20000;
+	const uint32_t CHANGE_NUM_PER_TICK = 500;
+
+	struct Timer
+	{
+		uint32_t item_slot;
+		uint32_t node_slot;
+	};
+
+	std::mt19937 rng(seed);
+	TraceBuilder builder(trace, "timer_add_remove", false);
+	std::vector<Timer> timers;
+	for (uint32_t i = 0; i < STEADY_TIMER_NUM; ++i)
+	{
+		Timer timer;
+		timer.item_slot = builder.Malloc(TIMER_ITEM_SIZE);
+		timer.node_slot = builder.Malloc(RBTREE_NODE_SIZE);
+		timers.push_back(timer);
+	}
+	builder.Tick();
+
+	uint32_t tick_num = ScaleTickNum(2000, scale);
+	for (uint32_t tick = 0; tick < tick_num; ++tick)
+	{
+		// fired or removed timers leave from random positions of the tree, new ones take their place
+		uint32_t remove_num = RandRange(rng, CHANGE_NUM_PER_TICK / 2, CHANGE_NUM_PER_TICK * 3 / 2);
+		for (uint32_t i = 0; i < remove_num && !timers.empty(); ++i)
+		{
+			uint32_t idx = rng() % timers.size();
+			builder.Free(timers[idx].node_slot);
+			builder.Free(timers[idx].item_slot);
+			timers[idx] = timers.back();
+			timers.pop_back();
+		}
+		while (timers.size() < STEADY_TIMER_NUM)
+		{
+			Timer timer;
+			timer.item_slot = builder.Malloc(TIMER_ITEM_SIZE);
+			timer.node_slot = builder.Malloc(RBTREE_NODE_SIZE);
+			timers.push_back(timer);
+		}
+		builder.Tick();
+	}
+}
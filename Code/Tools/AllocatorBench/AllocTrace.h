@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// one step of an allocation pattern, slot names the live pointer the op works on
+struct TraceOp
+{
+	enum EType
+	{
+		MALLOC = 0,
+		FREE,
+		REALLOC,
+		TICK, // end of a server tick
+	};
+
+	uint8_t type = MALLOC;
+	uint32_t slot = 0;
+	uint32_t size = 0;
+};
+
+// a recorded sequence of ops, generated ahead of the run so every allocator replays exactly the same thing
+struct AllocTrace
+{
+	std::string name;
+	bool is_frame_scoped = false; // nothing outlives a TICK, so a bump allocator may reset there
+	uint32_t slot_num = 0;
+	uint64_t op_num = 0; // MALLOC, FREE and REALLOC ops, ticks excluded
+	uint64_t peak_live_bytes = 0; // peak of requested bytes alive at once
+	std::vector<TraceOp> ops;
+};
+
+// generators of the allocation patterns of the server, scale multiplies the tick number of each of them
+namespace AllocTraceFactory
+{
+	// NetWorker and GameLogic objects of connections coming and going, plus recv buffers living for one tick
+	void MakeConnectionChurn(AllocTrace &trace, double scale, uint32_t seed);
+	// vectors and hash sets built by view and sync code every tick and dropped at its end
+	void MakeSceneContainers(AllocTrace &trace, double scale, uint32_t seed);
+	// doubling blocks of the protobuf arenas of scenes, all freed by the per tick arena reset
+	void MakeProtobufArenaBlocks(AllocTrace &trace, double scale, uint32_t seed);
+	// TimerItem and rbtree node pairs added, fired and removed around a steady timer population
+	void MakeTimerAddRemove(AllocTrace &trace, double scale, uint32_t seed);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "MemoryPool/MemoryPoolMgr.h"
+#include "MemoryPool/FrameArena.h"
+
+// the allocators a trace is replayed against. sizes are passed to Free and Realloc because the bump allocator needs them
+class BenchAllocator
+{
+public:
+	virtual ~BenchAllocator() {}
+	virtual const char * Name() = 0;
+	virtual void * Malloc(uint32_t size) = 0;
+	virtual void Free(void *ptr, uint32_t size) = 0;
+	virtual void * Realloc(void *ptr, uint32_t old_size, uint32_t size) = 0;
+	virtual void OnTick(bool is_frame_scoped) {}
+	virtual bool IsThreadSafe() { return true; }
+};
+
+// MemoryPoolMgr configured as MemoryUtil::Init does, span_size 0 gives the legacy header mode
+class PoolBenchAllocator : public BenchAllocator
+{
+public:
+	PoolBenchAllocator(bool is_span_mode)
+	{
+		// same size classes as MemoryUtil::Init
+		std::vector<uint32_t> block_sizes;
+		block_sizes.push_back(8);
+		for (int i = 0 + 16; i <= 512; i = i + 16)
+			block_sizes.push_back(i);
+		for (int i = 512 + 32; i <= 4096; i = i + 64)
+			block_sizes.push_back(i);
+
+		if (is_span_mode)
+			m_memory_pool_mgr = new MemoryPoolMgr(block_sizes, 4 * 1024, 8, 64, 64 * 1024, 2 * 1024 * 1024, true);
+		else
+			m_memory_pool_mgr = new MemoryPoolMgr(block_sizes, 4 * 1024, 8, 64);
+		m_name = is_span_mode ? "pool" : "pool_legacy";
+	}
+	virtual ~PoolBenchAllocator() { delete m_memory_pool_mgr; m_memory_pool_mgr = nullptr; }
+
+	virtual const char * Name() { return m_name; }
+	virtual void * Malloc(uint32_t size) { return m_memory_pool_mgr->Malloc(size); }
+	virtual void Free(void *ptr, uint32_t size) { m_memory_pool_mgr->Free(ptr); }
+	virtual void * Realloc(void *ptr, uint32_t old_size, uint32_t size) { return m_memory_pool_mgr->Realloc(ptr, size); }
+
+private:
+	MemoryPoolMgr *m_memory_pool_mgr = nullptr;
+	const char *m_name = nullptr;
+};
+
+class MallocBenchAllocator : public BenchAllocator
+{
+public:
+	virtual const char * Name() { return "malloc"; }
+	virtual void * Malloc(uint32_t size) { return malloc(size); }
+	virtual void Free(void *ptr, uint32_t size) { free(ptr); }
+	virtual void * Realloc(void *ptr, uint32_t old_size, uint32_t size) { return realloc(ptr, size); }
+};
+
+// FrameArena as the lower bound of what an allocator can cost, only meaningful for frame scoped traces
+class BumpBenchAllocator : public BenchAllocator
+{
+public:
+	BumpBenchAllocator() : m_frame_arena(64 * 1024) {}
+
+	virtual const char * Name() { return "bump"; }
+	virtual void * Malloc(uint32_t size) { return m_frame_arena.Malloc(size); }
+	virtual void Free(void *ptr, uint32_t size) { m_frame_arena.Free(ptr, size); }
+	virtual void * Realloc(void *ptr, uint32_t old_size, uint32_t size)
+	{
+		void *ret_ptr = m_frame_arena.Malloc(size);
+		if (nullptr != ret_ptr && nullptr != ptr)
+			memcpy(ret_ptr, ptr, old_size < size ? old_size : size);
+		return ret_ptr;
+	}
+	virtual void OnTick(bool is_frame_scoped)
+	{
+		if (is_frame_scoped)
+			m_frame_arena.Reset();
+	}
+	virtual bool IsThreadSafe() { return false; }
+
+private:
+	FrameArena m_frame_arena;
+};
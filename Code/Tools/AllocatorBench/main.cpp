@@ -0,0 +1,474 @@
+#include "AllocTrace.h"
+#include "BenchAllocator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#ifndef WIN32
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#endif
+
+// replays the allocation traces of the server against MemoryPoolMgr, malloc and a bump allocator.
+// usage: AllocatorBench [scale], scale multiplies the tick number of every trace (default 1.0)
+// dTLB misses are counted by perf events on linux and shown as n/a where they are not permitted
+
+enum EBenchAllocator
+{
+	BENCH_ALLOCATOR_POOL = 0,
+	BENCH_ALLOCATOR_POOL_LEGACY,
+	BENCH_ALLOCATOR_MALLOC,
+	BENCH_ALLOCATOR_BUMP,
+	BENCH_ALLOCATOR_NUM,
+};
+
+// plain data, so a forked run can write it back through a pipe
+struct BenchResult
+{
+	bool is_ok = false;
+	double seconds = 0; // untimed replay, for throughput
+	uint64_t op_num = 0;
+	uint64_t p50_ns = 0;
+	uint64_t p99_ns = 0;
+	uint64_t base_rss_kb = 0;
+	uint64_t peak_rss_kb = 0;
+	bool has_dtlb_miss = false; // false where perf events are not supported or not permitted
+	uint64_t dtlb_miss_num = 0; // dTLB load misses of the untimed replay
+};
+
+static BenchAllocator * NewBenchAllocator(int allocator_id)
+{
+	switch (allocator_id)
+	{
+	case BENCH_ALLOCATOR_POOL: return new PoolBenchAllocator(true);
+	case BENCH_ALLOCATOR_POOL_LEGACY: return new PoolBenchAllocator(false);
+	case BENCH_ALLOCATOR_MALLOC: return new MallocBenchAllocator();
+	case BENCH_ALLOCATOR_BUMP: return new BumpBenchAllocator();
+	}
+	return nullptr;
+}
+
+static uint64_t NowNs()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// a field of /proc/self/status in KB, 0 where it is not available
+static uint64_t ReadProcStatusKB(const char *key)
+{
+	uint64_t ret = 0;
+#ifndef WIN32
+	FILE *fp = fopen("/proc/self/status", "r");
+	if (nullptr == fp)
+		return 0;
+	char line[256];
+	size_t key_len = strlen(key);
+	while (nullptr != fgets(line, sizeof(line), fp))
+	{
+		if (0 == strncmp(line, key, key_len) && ':' == line[key_len])
+		{
+			ret = strtoull(line + key_len + 1, nullptr, 10);
+			break;
+		}
+	}
+	fclose(fp);
+#endif
+	return ret;
+}
+
+// dTLB load misses of the calling thread in user space, read from the perf events of the kernel.
+// Open fails without perf support, in containers without the permission, or when perf_event_paranoid forbids it
+class DtlbMissCounter
+{
+public:
+	~DtlbMissCounter()
+	{
+#ifdef __linux__
+		if (m_fd >= 0)
+			close(m_fd);
+#endif
+	}
+	bool Open()
+	{
+#ifdef __linux__
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		m_fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+		return m_fd >= 0;
+#else
+		return false;
+#endif
+	}
+	void Start()
+	{
+#ifdef __linux__
+		ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+	}
+	bool Stop(uint64_t &miss_num)
+	{
+#ifdef __linux__
+		ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+		return sizeof(miss_num) == read(m_fd, &miss_num, sizeof(miss_num));
+#else
+		return false;
+#endif
+	}
+
+private:
+	int m_fd = -1;
+};
+
+// runs bench_fn in a child process, so every run starts with a fresh heap and its own peak rss
+static BenchResult RunIsolated(std::function<void(BenchResult &)> bench_fn)
+{
+	BenchResult result;
+#ifdef WIN32
+	bench_fn(result);
+#else
+	int fds[2];
+	if (0 != pipe(fds))
+		return result;
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		close(fds[0]);
+		close(fds[1]);
+		return result;
+	}
+	if (0 == pid)
+	{
+		close(fds[0]);
+		bench_fn(result);
+		ssize_t write_len = write(fds[1], &result, sizeof(result));
+		close(fds[1]);
+		_exit(sizeof(result) == write_len ? 0 : 1);
+	}
+	close(fds[1]);
+	ssize_t read_len = read(fds[0], &result, sizeof(result));
+	close(fds[0]);
+	waitpid(pid, nullptr, 0);
+	if (sizeof(result) != read_len)
+		result = BenchResult();
+#endif
+	return result;
+}
+
+// writes one byte per page, so the memory shows up in rss as it does for real objects
+static inline void TouchMemory(void *ptr, uint32_t size)
+{
+	char *mem = (char *)ptr;
+	for (uint32_t offset = 0; offset < size; offset += 4096)
+		mem[offset] = (char)offset;
+	mem[size - 1] = 0;
+}
+
+// latencies is null for the throughput pass, otherwise it gets the ns of every op
+static void ReplayTrace(const AllocTrace &trace, BenchAllocator *allocator, void **ptrs, uint32_t *sizes, uint32_t *latencies)
+{
+	uint64_t op_idx = 0;
+	for (const TraceOp &op : trace.ops)
+	{
+		if (TraceOp::TICK == op.type)
+		{
+			allocator->OnTick(trace.is_frame_scoped);
+			continue;
+		}
+
+		uint64_t begin_ns = nullptr != latencies ? NowNs() : 0;
+		void *ptr = nullptr;
+		switch (op.type)
+		{
+		case TraceOp::MALLOC:
+			ptr = allocator->Malloc(op.size);
+			break;
+		case TraceOp::FREE:
+			allocator->Free(ptrs[op.slot], sizes[op.slot]);
+			break;
+		case TraceOp::REALLOC:
+			ptr = allocator->Realloc(ptrs[op.slot], sizes[op.slot], op.size);
+			break;
+		}
+		if (nullptr != latencies)
+			latencies[op_idx] = (uint32_t)(NowNs() - begin_ns);
+		++op_idx;
+
+		if (TraceOp::FREE != op.type)
+		{
+			TouchMemory(ptr, op.size);
+			ptrs[op.slot] = ptr;
+			sizes[op.slot] = op.size;
+		}
+	}
+}
+
+static uint64_t Percentile(std::vector<uint32_t> &values, double percent)
+{
+	if (values.empty())
+		return 0;
+	size_t idx = (size_t)(values.size() * percent / 100.0);
+	if (idx >= values.size())
+		idx = values.size() - 1;
+	std::nth_element(values.begin(), values.begin() + idx, values.end());
+	return values[idx];
+}
+
+static void BenchTrace(const AllocTrace &trace, int allocator_id, BenchResult &result)
+{
+	// every buffer of the run is touched before the baseline, so rss growth is the allocator's alone
+	std::vector<void *> ptrs(trace.slot_num, nullptr);
+	std::vector<uint32_t> sizes(trace.slot_num, 0);
+	std::vector<uint32_t> latencies(trace.op_num, 0);
+	result.base_rss_kb = ReadProcStatusKB("VmRSS");
+
+	BenchAllocator *allocator = NewBenchAllocator(allocator_id);
+	DtlbMissCounter dtlb_counter;
+	bool has_dtlb_counter = dtlb_counter.Open();
+	if (has_dtlb_counter)
+		dtlb_counter.Start();
+	uint64_t begin_ns = NowNs();
+	ReplayTrace(trace, allocator, ptrs.data(), sizes.data(), nullptr);
+	result.seconds = (NowNs() - begin_ns) / 1e9;
+	if (has_dtlb_counter)
+		result.has_dtlb_miss = dtlb_counter.Stop(result.dtlb_miss_num);
+	ReplayTrace(trace, allocator, ptrs.data(), sizes.data(), latencies.data());
+	result.peak_rss_kb = ReadProcStatusKB("VmHWM");
+	delete allocator;
+
+	result.op_num = trace.op_num;
+	result.p50_ns = Percentile(latencies, 50);
+	result.p99_ns = Percentile(latencies, 99);
+	result.is_ok = true;
+}
+
+// cost of the clock itself, it is part of every latency sample
+static uint64_t MeasureClockOverheadNs()
+{
+	const uint32_t SAMPLE_NUM = 100000;
+	std::vector<uint32_t> samples(SAMPLE_NUM, 0);
+	for (uint32_t i = 0; i < SAMPLE_NUM; ++i)
+	{
+		uint64_t begin_ns = NowNs();
+		samples[i] = (uint32_t)(NowNs() - begin_ns);
+	}
+	return Percentile(samples, 50);
+}
+
+static void PrintTraceBench(const AllocTrace &trace)
+{
+	printf("\n== %s: %llu ops, peak live %.1f MB%s\n", trace.name.c_str(), (unsigned long long)trace.op_num,
+		trace.peak_live_bytes / 1048576.0, trace.is_frame_scoped ? ", frame scoped" : "");
+	printf("%-12s %10s %8s %8s %12s %8s %14s\n", "allocator", "Mops/s", "p50 ns", "p99 ns", "peak rss MB", "frag %", "dTLB miss/Kop");
+	for (int allocator_id = 0; allocator_id < BENCH_ALLOCATOR_NUM; ++allocator_id)
+	{
+		BenchAllocator *allocator = NewBenchAllocator(allocator_id);
+		const char *name = allocator->Name();
+		delete allocator;
+
+		// a bump allocator never gives back long lived objects, it would just grow for the whole trace
+		if (BENCH_ALLOCATOR_BUMP == allocator_id && !trace.is_frame_scoped)
+		{
+			printf("%-12s %10s\n", name, "n/a");
+			continue;
+		}
+
+		BenchResult result = RunIsolated([&trace, allocator_id](BenchResult &result) { BenchTrace(trace, allocator_id, result); });
+		if (!result.is_ok)
+		{
+			printf("%-12s %10s\n", name, "failed");
+			continue;
+		}
+
+		// fragmentation: share of the rss growth which never held live data at the peak
+		double rss_mb = 0;
+		double frag_percent = 0;
+		if (result.peak_rss_kb > result.base_rss_kb)
+		{
+			double rss_bytes = (result.peak_rss_kb - result.base_rss_kb) * 1024.0;
+			rss_mb = rss_bytes / 1048576.0;
+			if (rss_bytes > trace.peak_live_bytes)
+				frag_percent = (1.0 - trace.peak_live_bytes / rss_bytes) * 100.0;
+		}
+		char dtlb_miss[32] = "n/a";
+		if (result.has_dtlb_miss)
+			snprintf(dtlb_miss, sizeof(dtlb_miss), "%.2f", result.dtlb_miss_num * 1000.0 / result.op_num);
+		printf("%-12s %10.2f %8llu %8llu %12.1f %8.1f %14s\n", name, result.op_num / result.seconds / 1e6,
+			(unsigned long long)result.p50_ns, (unsigned long long)result.p99_ns, rss_mb, frag_percent, dtlb_miss);
+	}
+}
+
+// every thread replays the trace on its own, all of them share one allocator
+static void BenchReplayThreads(const AllocTrace &trace, int allocator_id, uint32_t thread_num, BenchResult &result)
+{
+	BenchAllocator *allocator = NewBenchAllocator(allocator_id);
+	std::vector<std::thread> threads;
+	uint64_t begin_ns = NowNs();
+	for (uint32_t i = 0; i < thread_num; ++i)
+	{
+		threads.push_back(std::thread([&trace, allocator]() {
+			std::vector<void *> ptrs(trace.slot_num, nullptr);
+			std::vector<uint32_t> sizes(trace.slot_num, 0);
+			ReplayTrace(trace, allocator, ptrs.data(), sizes.data(), nullptr);
+		}));
+	}
+	for (std::thread &thread : threads)
+		thread.join();
+	result.seconds = (NowNs() - begin_ns) / 1e9;
+	result.op_num = trace.op_num * thread_num;
+	result.peak_rss_kb = ReadProcStatusKB("VmHWM");
+	delete allocator;
+	result.is_ok = true;
+}
+
+// bounded single producer single consumer ring, it carries blocks from the malloc thread to the free thread
+class HandoffRing
+{
+public:
+	bool Push(void *ptr)
+	{
+		uint32_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) >= RING_SIZE)
+			return false;
+		m_items[tail % RING_SIZE] = ptr;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+	void * Pop()
+	{
+		uint32_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire))
+			return nullptr;
+		void *ptr = m_items[head % RING_SIZE];
+		m_head.store(head + 1, std::memory_order_release);
+		return ptr;
+	}
+
+	const static uint32_t RING_SIZE = 1024;
+
+private:
+	void *m_items[RING_SIZE];
+	std::atomic<uint32_t> m_head{ 0 };
+	std::atomic<uint32_t> m_tail{ 0 };
+};
+
+// pair_num io thread like producers malloc recv buffers which their logic thread like consumers free
+static void BenchHandoffPairs(int allocator_id, uint32_t pair_num, BenchResult &result)
+{
+	const uint32_t BLOCK_NUM_PER_PAIR = 1000000;
+
+	BenchAllocator *allocator = NewBenchAllocator(allocator_id);
+	std::vector<HandoffRing> rings(pair_num);
+	std::vector<std::thread> threads;
+	uint64_t begin_ns = NowNs();
+	for (uint32_t i = 0; i < pair_num; ++i)
+	{
+		HandoffRing *ring = &rings[i];
+		threads.push_back(std::thread([ring, allocator, i]() {
+			uint32_t seed = 2166136261u ^ i;
+			for (uint32_t k = 0; k < BLOCK_NUM_PER_PAIR; ++k)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				uint32_t size = 32 + (seed >> 8) % 2048;
+				void *ptr = allocator->Malloc(size);
+				TouchMemory(ptr, size);
+				while (!ring->Push(ptr))
+					std::this_thread::yield();
+			}
+		}));
+		threads.push_back(std::thread([ring, allocator]() {
+			for (uint32_t k = 0; k < BLOCK_NUM_PER_PAIR; )
+			{
+				void *ptr = ring->Pop();
+				if (nullptr == ptr)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+				allocator->Free(ptr, 0);
+				++k;
+			}
+		}));
+	}
+	for (std::thread &thread : threads)
+		thread.join();
+	result.seconds = (NowNs() - begin_ns) / 1e9;
+	result.op_num = (uint64_t)BLOCK_NUM_PER_PAIR * pair_num * 2;
+	result.peak_rss_kb = ReadProcStatusKB("VmHWM");
+	delete allocator;
+	result.is_ok = true;
+}
+
+static void PrintThreadSweep(const AllocTrace &trace)
+{
+	const uint32_t THREAD_NUMS[] = { 1, 2, 4, 8 };
+
+	printf("\n== thread sweep: %s replayed by every thread, and malloc/free handoff between thread pairs\n", trace.name.c_str());
+	printf("%-12s %8s %14s %14s %16s\n", "allocator", "threads", "replay Mops/s", "handoff pairs", "handoff Mops/s");
+	for (int allocator_id = 0; allocator_id < BENCH_ALLOCATOR_NUM; ++allocator_id)
+	{
+		BenchAllocator *allocator = NewBenchAllocator(allocator_id);
+		const char *name = allocator->Name();
+		bool is_thread_safe = allocator->IsThreadSafe();
+		delete allocator;
+		if (!is_thread_safe)
+			continue;
+
+		for (uint32_t thread_num : THREAD_NUMS)
+		{
+			BenchResult replay_result = RunIsolated([&trace, allocator_id, thread_num](BenchResult &result) {
+				BenchReplayThreads(trace, allocator_id, thread_num, result); });
+			uint32_t pair_num = thread_num / 2 > 0 ? thread_num / 2 : 1;
+			BenchResult handoff_result = RunIsolated([allocator_id, pair_num](BenchResult &result) {
+				BenchHandoffPairs(allocator_id, pair_num, result); });
+			printf("%-12s %8u %14.2f %14u %16.2f\n", name, thread_num,
+				replay_result.is_ok ? replay_result.op_num / replay_result.seconds / 1e6 : 0.0, pair_num,
+				handoff_result.is_ok ? handoff_result.op_num / handoff_result.seconds / 1e6 : 0.0);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	double scale = 1.0;
+	if (argc > 1)
+		scale = atof(argv[1]);
+	if (scale <= 0)
+	{
+		printf("usage: %s [scale]\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<std::function<void(AllocTrace &)>> makers;
+	makers.push_back([scale](AllocTrace &trace) { AllocTraceFactory::MakeConnectionChurn(trace, scale, 1); });
+	makers.push_back([scale](AllocTrace &trace) { AllocTraceFactory::MakeSceneContainers(trace, scale, 2); });
+	makers.push_back([scale](AllocTrace &trace) { AllocTraceFactory::MakeProtobufArenaBlocks(trace, scale, 3); });
+	makers.push_back([scale](AllocTrace &trace) { AllocTraceFactory::MakeTimerAddRemove(trace, scale, 4); });
+
+	printf("clock overhead %llu ns, included in every latency sample\n", (unsigned long long)MeasureClockOverheadNs());
+	for (auto &maker : makers)
+	{
+		AllocTrace trace;
+		maker(trace);
+		PrintTraceBench(trace);
+	}
+
+	AllocTrace churn_trace;
+	AllocTraceFactory::MakeConnectionChurn(churn_trace, scale / 4, 1);
+	PrintThreadSweep(churn_trace);
+	return 0;
+}
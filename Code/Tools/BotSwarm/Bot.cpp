@@ -0,0 +1,257 @@
+#include "Bot.h"
+#include "BotSwarmModule.h"
+#include "CommonModules/Network/INetworkModule.h"
+#include "Network/Handlers/LenCtxNetStreamCnnHandler.h"
+#include "Network/Utils/NetworkAgent.h"
+#include "Network/Protobuf/ProtoId.pb.h"
+#include "Network/Protobuf/Battle.pb.h"
+#include "Network/Protobuf/BattleEnum.pb.h"
+#include "Network/Protobuf/Common.pb.h"
+#include "Common/Macro/ServerLogicMacro.h"
+#include "Common/Utils/MemoryUtil.h"
+#include "Utils/PlatformCompat.h"
+#include <chrono>
+
+static uint64_t NowNs()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the server does not cut what it sends at Net::PROTOCOL_MAX_SIZE, ViewAllGrids of the whole map is bigger
+static const uint32_t BOT_PROTOCOL_MAX_SIZE = 256 * 1024;
+
+// frames on the net workers as the PlayerCnnHandler of the game server does
+class BotCnnHandler : public LenCtxNetStreamCnnHandler
+{
+	NewDelOperaDeclaration;
+public:
+	BotCnnHandler(Bot *bot) : LenCtxNetStreamCnnHandler(BOT_PROTOCOL_MAX_SIZE, true), m_bot(bot) {}
+	virtual ~BotCnnHandler() { m_bot = nullptr; }
+	virtual void OnClose(int err_num) { if (nullptr != m_bot) m_bot->OnClose(err_num); }
+	virtual void OnOpen(int err_num) {}
+	// the bot is freed before its handler, which may still be held by the net workers
+	void Detach() { m_bot = nullptr; }
+
+protected:
+	virtual void OnParseSuccess(char *data, uint32_t len) { if (nullptr != m_bot) m_bot->OnRecv(data, len); }
+	virtual void OnParseFail() { if (nullptr != m_bot) m_bot->OnParseFail(); }
+	Bot *m_bot;
+};
+
+// what a bot does in battle, moves are the most of it as with a player
+static const NetProto::EBattleOperation BOT_OPERAS[] = {
+	NetProto::EBO_Move, NetProto::EBO_Move, NetProto::EBO_Move, NetProto::EBO_Move,
+	NetProto::EBO_Stop, NetProto::EBO_CastSkill_Q, NetProto::EBO_CastSkill_W, NetProto::EBO_CastSkill_E,
+};
+static const float BOT_MAP_SIZE = 100.0f;
+static const uint64_t BOT_PING_SPAN_NS = 1000000000ull;
+
+Bot::Bot(BotSwarmModule *module, uint32_t idx, uint32_t seed) : m_module(module), m_rand(seed + idx)
+{
+}
+
+Bot::~Bot()
+{
+	// the connections are gone with NetworkModule by now
+	if (nullptr != m_cnn_handler)
+		m_cnn_handler->Detach();
+	m_cnn_handler = nullptr;
+	m_module = nullptr;
+}
+
+bool Bot::Connect(const std::string &ip, uint16_t port)
+{
+	m_cnn_handler = std::make_shared<BotCnnHandler>(this);
+	m_netid = GlobalServerLogic->GetNetworkModule()->Connect(ip, port, nullptr, m_cnn_handler);
+	if (m_netid <= 0)
+	{
+		m_netid = 0;
+		m_state = EBotState_Closed;
+		return false;
+	}
+	m_cnn_handler->SetNetId(m_netid);
+	// the big scene syncs then come compressed, as they would to a client that decompresses
+	if (m_module->GetOpt().is_decompress)
+		GlobalServerLogic->GetNetAgent()->SendNetOption(m_netid);
+	this->SendReq(EBotReq_QueryFreeHero, NetProto::PID_QueryFreeHero, nullptr);
+	m_state = EBotState_QueryHero;
+	return true;
+}
+
+void Bot::Tick(uint64_t now_ns)
+{
+	if (EBotState_Battle != m_state)
+		return;
+	if (now_ns >= m_next_opera_ns)
+	{
+		this->SendBattleOpera();
+		m_next_opera_ns = now_ns + this->NextOperaSpanNs();
+	}
+	if (now_ns >= m_next_ping_ns)
+	{
+		this->SendReq(EBotReq_Ping, NetProto::PID_Ping, nullptr);
+		m_next_ping_ns = now_ns + BOT_PING_SPAN_NS;
+	}
+}
+
+void Bot::Close()
+{
+	if (m_netid > 0)
+		GlobalServerLogic->GetNetAgent()->Close(m_netid);
+	m_netid = 0;
+	m_state = EBotState_Closed;
+}
+
+uint64_t Bot::OldestPendingNs()
+{
+	uint64_t oldest_ns = 0;
+	for (int i = 0; i < EBotReq_Max; ++i)
+	{
+		if (!m_pending_ns[i].empty() && (0 == oldest_ns || m_pending_ns[i].front() < oldest_ns))
+			oldest_ns = m_pending_ns[i].front();
+	}
+	return oldest_ns;
+}
+
+void Bot::OnRecv(char *data, uint32_t len)
+{
+	// data is the protocol id and the msg
+	if (len < sizeof(int) || EBotState_Closed == m_state)
+		return;
+	// counted as it came on the wire, handled as it was sent
+	m_module->OnRecv(ntohl(*(int *)data) & ~Net::PROTOCOL_ID_COMPRESS_FLAG, Net::PROTOCOL_LEN_DESCRIPT_SIZE + len);
+	if (!GlobalServerLogic->GetNetAgent()->OnRecv(m_netid, data, len))
+		return;
+	int protocol_id = ntohl(*(int *)data);
+	char *msg_data = data + sizeof(int);
+	int msg_len = (int)(len - sizeof(int));
+
+	switch (protocol_id)
+	{
+	case NetProto::PID_RspFreeHero:
+	{
+		if (!this->OnRsp(EBotReq_QueryFreeHero) || EBotState_QueryHero != m_state)
+			break;
+		NetProto::RspFreeHero rsp;
+		rsp.ParseFromArray(msg_data, msg_len);
+		// a free hero if there is one, else 0 and the server says no
+		uint64_t hero_id = rsp.red_hero_id();
+		if (0 == hero_id || (0 != rsp.blue_hero_id() && 0 == (m_rand() & 1)))
+			hero_id = 0 != rsp.blue_hero_id() ? rsp.blue_hero_id() : hero_id;
+		NetProto::SelectHeroReq req;
+		req.set_hero_id(hero_id);
+		this->SendReq(EBotReq_SelectHero, NetProto::PID_SelectHeroReq, &req);
+		m_state = EBotState_SelectHero;
+	}
+	break;
+	case NetProto::PID_SelectHeroRsp:
+	{
+		if (!this->OnRsp(EBotReq_SelectHero) || EBotState_SelectHero != m_state)
+			break;
+		NetProto::SelectHeroRsp rsp;
+		rsp.ParseFromArray(msg_data, msg_len);
+		m_has_hero = rsp.is_succ();
+		this->Send(NetProto::PID_LoadSceneComplete, nullptr);
+		this->SendReq(EBotReq_PullScene, NetProto::PID_PullAllSceneInfo, nullptr);
+		m_state = EBotState_PullScene;
+	}
+	break;
+	case NetProto::PID_ViewAllGrids:
+	{
+		if (!this->OnRsp(EBotReq_PullScene) || EBotState_PullScene != m_state)
+			break;
+		uint64_t now_ns = NowNs();
+		m_next_opera_ns = now_ns + this->NextOperaSpanNs();
+		m_next_ping_ns = now_ns + m_rand() % BOT_PING_SPAN_NS;
+		m_state = EBotState_Battle;
+	}
+	break;
+	case NetProto::PID_Pong:
+	{
+		this->OnRsp(EBotReq_Ping);
+	}
+	break;
+	case NetProto::PID_Ping:
+	{
+		// the server times its round trips with these
+		this->Send(NetProto::PID_Pong, nullptr);
+	}
+	break;
+	default:
+		break;
+	}
+}
+
+void Bot::OnClose(int err_num)
+{
+	if (EBotState_Closed == m_state)
+		return;
+	GlobalServerLogic->GetNetAgent()->OnClose(m_netid);
+	m_netid = 0;
+	m_state = EBotState_Closed;
+	m_module->OnBotClose(this, err_num);
+}
+
+void Bot::OnParseFail()
+{
+	if (EBotState_Closed == m_state)
+		return;
+	this->Close();
+	m_module->OnBotClose(this, -1);
+}
+
+void Bot::Send(int protocol_id, google::protobuf::Message *msg)
+{
+	uint32_t msg_len = 0;
+	if (nullptr != msg)
+	{
+		msg_len = (uint32_t)msg->ByteSize();
+		GlobalServerLogic->GetNetAgent()->Send(m_netid, protocol_id, msg);
+	}
+	else
+	{
+		GlobalServerLogic->GetNetAgent()->Send(m_netid, protocol_id, nullptr, 0);
+	}
+	// the frame on the wire, length and protocol id heads included
+	m_module->OnSend(protocol_id, Net::PROTOCOL_LEN_DESCRIPT_SIZE + sizeof(int) + msg_len);
+}
+
+void Bot::SendReq(EBotReq req, int protocol_id, google::protobuf::Message *msg)
+{
+	m_pending_ns[req].push_back(NowNs());
+	this->Send(protocol_id, msg);
+}
+
+bool Bot::OnRsp(EBotReq req)
+{
+	if (m_pending_ns[req].empty())
+		return false;
+	m_module->OnRspLatency(req, NowNs() - m_pending_ns[req].front());
+	m_pending_ns[req].pop_front();
+	return true;
+}
+
+void Bot::SendBattleOpera()
+{
+	std::uniform_real_distribution<float> pos_dist(0, BOT_MAP_SIZE);
+	std::uniform_real_distribution<float> dir_dist(0, 360);
+	NetProto::BattleOperation opera;
+	opera.set_opera(BOT_OPERAS[m_rand() % (sizeof(BOT_OPERAS) / sizeof(BOT_OPERAS[0]))]);
+	opera.set_dir(dir_dist(m_rand));
+	opera.mutable_pos()->set_x(pos_dist(m_rand));
+	opera.mutable_pos()->set_y(pos_dist(m_rand));
+	this->Send(NetProto::PID_BattleOperaReq, &opera);
+}
+
+uint64_t Bot::NextOperaSpanNs()
+{
+	// evenly spread around the mean span, the bots do not fire in step
+	const BotSwarmOpt &opt = m_module->GetOpt();
+	if (opt.opera_per_sec <= 0)
+		return UINT64_MAX / 2;
+	std::uniform_real_distribution<double> span_dist(0.5, 1.5);
+	return (uint64_t)(span_dist(m_rand) * 1e9 / opt.opera_per_sec);
+}
+
+NewDelOperaImplement(Bot);
+NewDelOperaImplement(BotCnnHandler);
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Common/Define/NetworkDefine.h"
+#include "Common/Macro/MemoryPoolMacro.h"
+#include <stdint.h>
+#include <memory>
+#include <deque>
+#include <random>
+#include <string>
+
+class BotSwarmModule;
+class BotCnnHandler;
+namespace google { namespace protobuf { class Message; } }
+
+// the requests of the flow that the server answers, their latency is timed from the send to the answer
+enum EBotReq
+{
+	EBotReq_QueryFreeHero = 0, // PID_QueryFreeHero -> PID_RspFreeHero
+	EBotReq_SelectHero, // PID_SelectHeroReq -> PID_SelectHeroRsp
+	EBotReq_PullScene, // PID_PullAllSceneInfo -> PID_ViewAllGrids
+	EBotReq_Ping, // PID_Ping -> PID_Pong, every second in battle
+	EBotReq_Max,
+};
+
+// one simulated player, it walks the flow of the client: QueryFreeHero, SelectHeroReq, LoadSceneComplete, PullAllSceneInfo,
+// then random battle operations until the swarm stops. a bot that gets no free hero goes on without one, as the client can
+class Bot
+{
+	NewDelOperaDeclaration;
+public:
+	enum EBotState
+	{
+		EBotState_Connecting,
+		EBotState_QueryHero,
+		EBotState_SelectHero,
+		EBotState_PullScene,
+		EBotState_Battle,
+		EBotState_Closed,
+	};
+
+	Bot(BotSwarmModule *module, uint32_t idx, uint32_t seed);
+	~Bot();
+	bool Connect(const std::string &ip, uint16_t port);
+	void Tick(uint64_t now_ns);
+	void Close();
+	EBotState GetState() { return m_state; }
+	bool HasHero() { return m_has_hero; }
+	// the oldest request still waiting for its answer, 0 for none
+	uint64_t OldestPendingNs();
+
+	// called by the handler on the logic thread
+	void OnRecv(char *data, uint32_t len);
+	void OnClose(int err_num);
+	void OnParseFail();
+
+protected:
+	BotSwarmModule *m_module = nullptr;
+	EBotState m_state = EBotState_Connecting;
+	std::shared_ptr<BotCnnHandler> m_cnn_handler;
+	NetId m_netid = 0;
+	bool m_has_hero = false;
+	std::mt19937 m_rand;
+
+	// send times of the requests in flight, the server answers each connection in order
+	std::deque<uint64_t> m_pending_ns[EBotReq_Max];
+	uint64_t m_next_opera_ns = 0;
+	uint64_t m_next_ping_ns = 0;
+
+	void Send(int protocol_id, google::protobuf::Message *msg);
+	void SendReq(EBotReq req, int protocol_id, google::protobuf::Message *msg);
+	bool OnRsp(EBotReq req);
+	void SendBattleOpera();
+	uint64_t NextOperaSpanNs();
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "ServerLogics/ServerLogic.h"
+
+struct BotSwarmOpt;
+
+// param of SetInitParams
+struct BotServerParam
+{
+	std::string log_cfg_file;
+	BotSwarmOpt *opt = nullptr;
+};
+
+// the modules of the game server with BotSwarmModule in the game logic slot, the bots connect as clients through NetworkModule
+class BotServerLogic : public ServerLogic
+{
+public:
+	BotServerLogic();
+	virtual ~BotServerLogic();
+	virtual void SetInitParams(void *params);
+
+protected:
+	virtual void SetupModules();
+	virtual void ClearInitParams();
+};
@@ -0,0 +1,241 @@
+#include "BotSwarmModule.h"
+#include "ModuleDef/ModuleMgr.h"
+#include "Network/Protobuf/ProtoId.pb.h"
+#include "Common/Utils/MemoryUtil.h"
+#include <stdio.h>
+#include <signal.h>
+#include <chrono>
+#include <algorithm>
+
+static const char *BOT_REQ_NAMES[EBotReq_Max] = { "query", "select", "pull", "ping" };
+static volatile sig_atomic_t bot_swarm_stop = 0;
+
+static uint64_t NowNs()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t Percentile(std::vector<uint32_t> &values, double percent)
+{
+	if (values.empty())
+		return 0;
+	size_t idx = (size_t)(values.size() * percent / 100.0);
+	if (idx >= values.size())
+		idx = values.size() - 1;
+	std::nth_element(values.begin(), values.begin() + idx, values.end());
+	return values[idx];
+}
+
+void BotSwarmModule::MsgStat::Add(const MsgStat &other)
+{
+	send_num += other.send_num;
+	send_bytes += other.send_bytes;
+	recv_num += other.recv_num;
+	recv_bytes += other.recv_bytes;
+}
+
+BotSwarmModule::BotSwarmModule(ModuleMgr *module_mgr) : IGameLogicModule(module_mgr)
+{
+}
+
+BotSwarmModule::~BotSwarmModule()
+{
+	m_opt = nullptr;
+}
+
+EModuleRetCode BotSwarmModule::Init(void *param)
+{
+	m_opt = (BotSwarmOpt *)param;
+	if (nullptr == m_opt || 0 == m_opt->bot_num || m_opt->seconds <= 0)
+		return EModuleRetCode_Failed;
+	m_pid_msgs.resize(NetProto::PID_Max);
+	return EModuleRetCode_Succ;
+}
+
+EModuleRetCode BotSwarmModule::Awake()
+{
+	m_bots.reserve(m_opt->bot_num);
+	m_start_ns = NowNs();
+	m_last_report_ns = m_start_ns;
+	return EModuleRetCode_Succ;
+}
+
+EModuleRetCode BotSwarmModule::Update()
+{
+	if (m_is_done)
+		return EModuleRetCode_Succ;
+	uint64_t now_ns = NowNs();
+	this->ConnectBots(now_ns);
+	for (Bot *bot : m_bots)
+		bot->Tick(now_ns);
+	if (now_ns - m_last_report_ns >= 1000000000ull)
+		this->Report(now_ns);
+
+	bool is_all_closed = m_bots.size() >= m_opt->bot_num;
+	for (Bot *bot : m_bots)
+	{
+		if (Bot::EBotState_Closed != bot->GetState())
+		{
+			is_all_closed = false;
+			break;
+		}
+	}
+	if (bot_swarm_stop || is_all_closed || now_ns - m_start_ns >= (uint64_t)(m_opt->seconds * 1e9))
+		this->Finish();
+	return EModuleRetCode_Succ;
+}
+
+EModuleRetCode BotSwarmModule::Release()
+{
+	return EModuleRetCode_Succ;
+}
+
+EModuleRetCode BotSwarmModule::Destroy()
+{
+	// the net workers are stopped by now, NetworkModule comes first
+	for (Bot *bot : m_bots)
+		delete bot;
+	m_bots.clear();
+	return EModuleRetCode_Succ;
+}
+
+void BotSwarmModule::RequestStop()
+{
+	bot_swarm_stop = 1;
+}
+
+void BotSwarmModule::ConnectBots(uint64_t now_ns)
+{
+	if (m_bots.size() >= m_opt->bot_num)
+		return;
+	uint64_t ramp_num = (uint64_t)((now_ns - m_start_ns) / 1e9 * m_opt->ramp_per_sec) + 1;
+	for (uint32_t i = 0; i < CONNECT_BATCH && m_bots.size() < m_opt->bot_num && m_bots.size() < ramp_num; ++i)
+	{
+		Bot *bot = new Bot(this, (uint32_t)m_bots.size(), m_opt->seed);
+		m_bots.push_back(bot);
+		if (!bot->Connect(m_opt->ip, m_opt->port))
+			++m_connect_fail_num;
+	}
+	if (m_bots.size() >= m_opt->bot_num)
+		m_ramp_end_ns = NowNs();
+}
+
+void BotSwarmModule::Finish()
+{
+	m_is_done = true;
+	uint64_t now_ns = NowNs();
+	this->Report(now_ns);
+	this->PrintSummary(now_ns);
+	fflush(stdout);
+	for (Bot *bot : m_bots)
+		bot->Close();
+	m_module_mgr->Quit();
+}
+
+void BotSwarmModule::OnSend(int protocol_id, uint32_t len)
+{
+	++m_interval_msg.send_num;
+	m_interval_msg.send_bytes += len;
+	if (protocol_id > 0 && protocol_id < (int)m_pid_msgs.size())
+	{
+		++m_pid_msgs[protocol_id].send_num;
+		m_pid_msgs[protocol_id].send_bytes += len;
+	}
+}
+
+void BotSwarmModule::OnRecv(int protocol_id, uint32_t len)
+{
+	++m_interval_msg.recv_num;
+	m_interval_msg.recv_bytes += len;
+	if (protocol_id > 0 && protocol_id < (int)m_pid_msgs.size())
+	{
+		++m_pid_msgs[protocol_id].recv_num;
+		m_pid_msgs[protocol_id].recv_bytes += len;
+	}
+}
+
+void BotSwarmModule::OnRspLatency(EBotReq req, uint64_t latency_ns)
+{
+	m_interval_latency_us[req].push_back((uint32_t)(latency_ns / 1000));
+}
+
+void BotSwarmModule::OnBotClose(Bot *bot, int err_num)
+{
+	// the first few tell why, the rest are counted by Report
+	if (++m_close_num <= CLOSE_PRINT_NUM)
+		printf("a bot is closed in state %d, err_num %d\n", (int)bot->GetState(), err_num);
+}
+
+void BotSwarmModule::Report(uint64_t now_ns)
+{
+	double span_sec = (now_ns - m_last_report_ns) / 1e9;
+	if (span_sec <= 0)
+		return;
+	uint32_t battle_num = 0, hero_num = 0, closed_num = 0, stalled_num = 0;
+	for (Bot *bot : m_bots)
+	{
+		if (Bot::EBotState_Battle == bot->GetState())
+			++battle_num;
+		if (Bot::EBotState_Closed == bot->GetState())
+			++closed_num;
+		else if (bot->HasHero())
+			++hero_num;
+		uint64_t pending_ns = bot->OldestPendingNs();
+		if (pending_ns > 0 && now_ns - pending_ns > REQ_TIMEOUT_SEC * 1000000000ull)
+			++stalled_num;
+	}
+	printf("[%5.1fs] bots %u battle %u hero %u closed %u stalled %u | send %.0f/s %.2f MB/s recv %.0f/s %.2f MB/s |",
+		(now_ns - m_start_ns) / 1e9, (uint32_t)m_bots.size(), battle_num, hero_num, closed_num, stalled_num,
+		m_interval_msg.send_num / span_sec, m_interval_msg.send_bytes / span_sec / 1048576.0,
+		m_interval_msg.recv_num / span_sec, m_interval_msg.recv_bytes / span_sec / 1048576.0);
+	for (int i = 0; i < EBotReq_Max; ++i)
+	{
+		std::vector<uint32_t> &latency_us = m_interval_latency_us[i];
+		if (latency_us.empty())
+		{
+			printf(" %s -", BOT_REQ_NAMES[i]);
+			continue;
+		}
+		m_total_latency_us[i].insert(m_total_latency_us[i].end(), latency_us.begin(), latency_us.end());
+		uint64_t p50_us = Percentile(latency_us, 50);
+		uint64_t p99_us = Percentile(latency_us, 99);
+		printf(" %s %llu/%llu us", BOT_REQ_NAMES[i], (unsigned long long)p50_us, (unsigned long long)p99_us);
+		latency_us.clear();
+	}
+	printf("\n");
+	fflush(stdout);
+	m_total_msg.Add(m_interval_msg);
+	m_interval_msg = MsgStat();
+	m_last_report_ns = now_ns;
+}
+
+void BotSwarmModule::PrintSummary(uint64_t now_ns)
+{
+	double run_sec = (now_ns - m_start_ns) / 1e9;
+	printf("\n%u bots against %s:%u for %.1f s, ramp %.1f s, connect fail %u, %.1f battle operations per bot per s\n",
+		(uint32_t)m_bots.size(), m_opt->ip.c_str(), m_opt->port, run_sec, m_ramp_end_ns > 0 ? (m_ramp_end_ns - m_start_ns) / 1e9 : run_sec,
+		m_connect_fail_num, m_opt->opera_per_sec);
+	printf("%-8s %9s %9s %9s %9s %9s\n", "request", "answered", "p50 us", "p90 us", "p99 us", "max us");
+	for (int i = 0; i < EBotReq_Max; ++i)
+	{
+		std::vector<uint32_t> &latency_us = m_total_latency_us[i];
+		uint64_t max_us = latency_us.empty() ? 0 : *std::max_element(latency_us.begin(), latency_us.end());
+		printf("%-8s %9llu %9llu %9llu %9llu %9llu\n", BOT_REQ_NAMES[i], (unsigned long long)latency_us.size(),
+			(unsigned long long)Percentile(latency_us, 50), (unsigned long long)Percentile(latency_us, 90),
+			(unsigned long long)Percentile(latency_us, 99), (unsigned long long)max_us);
+	}
+	printf("%-28s %10s %10s %10s %10s\n", "protocol", "sent", "sent MB", "received", "recv MB");
+	for (int pid = 0; pid < (int)m_pid_msgs.size(); ++pid)
+	{
+		const MsgStat &stat = m_pid_msgs[pid];
+		if (0 == stat.send_num && 0 == stat.recv_num)
+			continue;
+		std::string name = NetProto::ProtoId_IsValid(pid) ? NetProto::ProtoId_Name((NetProto::ProtoId)pid) : std::to_string(pid);
+		printf("%-28s %10llu %10.2f %10llu %10.2f\n", name.c_str(), (unsigned long long)stat.send_num, stat.send_bytes / 1048576.0,
+			(unsigned long long)stat.recv_num, stat.recv_bytes / 1048576.0);
+	}
+	printf("%-28s %10.0f %10.2f %10.0f %10.2f   per s\n", "all", m_total_msg.send_num / run_sec, m_total_msg.send_bytes / run_sec / 1048576.0,
+		m_total_msg.recv_num / run_sec, m_total_msg.recv_bytes / run_sec / 1048576.0);
+}
+
+NewDelOperaImplement(BotSwarmModule);
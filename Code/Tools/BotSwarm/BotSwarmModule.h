@@ -0,0 +1,82 @@
+#pragma once
+
+#include "LogicModules/GameLogic/IGameLogicModule.h"
+#include "Common/Macro/MemoryPoolMacro.h"
+#include "Bot.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct BotSwarmOpt
+{
+	std::string ip = "127.0.0.1";
+	uint16_t port = 10240;
+	uint32_t bot_num = 1000;
+	double seconds = 60; // from the first connect, the ramp included
+	double opera_per_sec = 5; // battle operations of every bot
+	uint32_t ramp_per_sec = 1000; // new connections per second
+	int worker_num = 2;
+	std::string impl = "libevent";
+	int loop_span_ms = 1;
+	uint32_t seed = 1;
+	bool is_decompress = true; // sends the net option, so the server compresses its big msgs
+};
+
+// takes the game logic slot of the bot server. Update ramps the bots up, ticks them and prints a line every second,
+// the run ends with a summary by quitting the server logic
+class BotSwarmModule : public IGameLogicModule
+{
+	NewDelOperaDeclaration;
+public:
+	BotSwarmModule(ModuleMgr *module_mgr);
+	virtual ~BotSwarmModule();
+	virtual EModuleRetCode Init(void *param);
+	virtual EModuleRetCode Awake();
+	virtual EModuleRetCode Update();
+	virtual EModuleRetCode Release();
+	virtual EModuleRetCode Destroy();
+
+	// safe from a signal handler, the summary is printed on the next tick
+	static void RequestStop();
+	const BotSwarmOpt & GetOpt() { return *m_opt; }
+
+	// called by the bots on the logic thread
+	void OnSend(int protocol_id, uint32_t len);
+	void OnRecv(int protocol_id, uint32_t len);
+	void OnRspLatency(EBotReq req, uint64_t latency_ns);
+	void OnBotClose(Bot *bot, int err_num);
+
+protected:
+	BotSwarmOpt *m_opt = nullptr;
+	std::vector<Bot *> m_bots;
+	uint64_t m_start_ns = 0;
+	uint64_t m_ramp_end_ns = 0;
+	uint32_t m_connect_fail_num = 0;
+	uint32_t m_close_num = 0;
+	bool m_is_done = false;
+	static const uint32_t CONNECT_BATCH = 32; // per tick, the connects block the logic thread
+	static const uint32_t CLOSE_PRINT_NUM = 10;
+	static const int REQ_TIMEOUT_SEC = 5; // a request waiting longer is reported as stalled
+	void ConnectBots(uint64_t now_ns);
+	void Finish();
+
+	// traffic of the bots, by protocol id
+	struct MsgStat
+	{
+		uint64_t send_num = 0;
+		uint64_t send_bytes = 0;
+		uint64_t recv_num = 0;
+		uint64_t recv_bytes = 0;
+		void Add(const MsgStat &other);
+	};
+	MsgStat m_interval_msg;
+	MsgStat m_total_msg;
+	std::vector<MsgStat> m_pid_msgs;
+
+	// latency in us of the answered requests, the interval ones are cleared by every report
+	std::vector<uint32_t> m_interval_latency_us[EBotReq_Max];
+	std::vector<uint32_t> m_total_latency_us[EBotReq_Max];
+	uint64_t m_last_report_ns = 0;
+	void Report(uint64_t now_ns);
+	void PrintSummary(uint64_t now_ns);
+};
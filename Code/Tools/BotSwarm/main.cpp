@@ -0,0 +1,92 @@
+#include "BotServerLogic.h"
+#include "BotSwarmModule.h"
+#include "Common/Utils/MemoryUtil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <string>
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+
+// a swarm of headless players against a running game server. every bot is a connection of the NetworkModule of this process,
+// it selects a hero, loads the scene and then sends random battle operations like the client does, while the answers of the
+// server are timed. a line is printed every second and a summary at the end, ctrl-c ends the run early.
+// usage: BotSwarm log_cfg_file [ip] [port] [bot_num] [seconds] [opera_per_sec] [ramp_per_sec] [worker_num] [impl] [decompress]
+//        defaults 127.0.0.1 10240 1000 60 5 1000 2 libevent 1
+
+extern ServerLogic *server_logic;
+
+static void OnStopSignal(int sig)
+{
+	BotSwarmModule::RequestStop();
+}
+
+int main(int argc, char **argv)
+{
+	const char *usage = "usage: %s log_cfg_file [ip] [port] [bot_num] [seconds] [opera_per_sec] [ramp_per_sec] [worker_num] [impl] [decompress]\n";
+	if (argc <= 1)
+	{
+		printf(usage, argv[0]);
+		return 1;
+	}
+	BotSwarmOpt opt;
+	if (argc > 2)
+		opt.ip = argv[2];
+	if (argc > 3)
+		opt.port = (uint16_t)atoi(argv[3]);
+	if (argc > 4)
+		opt.bot_num = (uint32_t)atoi(argv[4]);
+	if (argc > 5)
+		opt.seconds = atof(argv[5]);
+	if (argc > 6)
+		opt.opera_per_sec = atof(argv[6]);
+	if (argc > 7)
+		opt.ramp_per_sec = (uint32_t)atoi(argv[7]);
+	if (argc > 8)
+		opt.worker_num = atoi(argv[8]);
+	if (argc > 9)
+		opt.impl = argv[9];
+	if (argc > 10)
+		opt.is_decompress = 0 != atoi(argv[10]);
+	if (0 == opt.port || 0 == opt.bot_num || opt.seconds <= 0 || opt.opera_per_sec < 0 || 0 == opt.ramp_per_sec || opt.worker_num <= 0)
+	{
+		printf(usage, argv[0]);
+		return 1;
+	}
+
+	MemoryUtil::Init();
+#ifdef WIN32
+	WSADATA wsa_data;
+	WSAStartup(0x0201, &wsa_data);
+#else
+	signal(SIGPIPE, SIG_IGN);
+	rlimit fd_limit;
+	if (0 == getrlimit(RLIMIT_NOFILE, &fd_limit) && fd_limit.rlim_cur < fd_limit.rlim_max)
+	{
+		fd_limit.rlim_cur = fd_limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &fd_limit);
+	}
+	if (0 == getrlimit(RLIMIT_NOFILE, &fd_limit) && opt.bot_num + 64 > fd_limit.rlim_cur)
+		printf("%u bots need more fds than the limit %llu, the last ones will fail to connect\n", opt.bot_num, (unsigned long long)fd_limit.rlim_cur);
+#endif
+	signal(SIGINT, OnStopSignal);
+	signal(SIGTERM, OnStopSignal);
+
+	printf("%u bots against %s:%u, %.1f s, %.1f battle operations per bot per s, ramp %u bots per s, %d %s net workers, %s\n",
+		opt.bot_num, opt.ip.c_str(), opt.port, opt.seconds, opt.opera_per_sec, opt.ramp_per_sec, opt.worker_num, opt.impl.c_str(),
+		opt.is_decompress ? "decompress" : "no decompress");
+	printf("latency is p50/p99 of the answers of the last second: query RspFreeHero, select SelectHeroRsp, pull ViewAllGrids, ping Pong\n");
+	fflush(stdout);
+
+	BotServerParam param;
+	param.log_cfg_file = argv[1];
+	param.opt = &opt;
+	server_logic = new BotServerLogic();
+	server_logic->SetInitParams(&param);
+	server_logic->Loop();
+	delete server_logic;
+	server_logic = nullptr;
+	MemoryUtil::Destroy();
+	return 0;
+}
@@ -0,0 +1,580 @@
+#include "CommonModules/Network/Impl/NetWorker.h"
+#include "CommonModules/Network/Impl/EpollNetWorker.h"
+#include "CommonModules/Network/Impl/UringNetWorker.h"
+#include "Common/Utils/MemoryUtil.h"
+#include "event2/buffer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+#ifndef WIN32
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#endif
+
+// echoes on loopback through every net worker implementation, the load comes from a forked client process.
+// every client connection keeps one message in flight and sends the next when the whole echo is back.
+// usage: NetBench [conn_num] [seconds] [msg_size] [worker_num], defaults 10000 5 64 1
+
+#ifndef WIN32
+
+enum EBenchImpl
+{
+	BENCH_IMPL_LIBEVENT = 0,
+	BENCH_IMPL_EPOLL,
+	BENCH_IMPL_URING,
+	BENCH_IMPL_NUM,
+};
+
+static const char *BENCH_IMPL_NAMES[BENCH_IMPL_NUM] = { "libevent", "epoll", "io_uring" };
+
+struct BenchOpt
+{
+	uint32_t conn_num = 10000;
+	double seconds = 5;
+	uint32_t msg_size = 64;
+	uint32_t worker_num = 1;
+};
+
+// plain data, so the forked processes can write it back through a pipe
+struct BenchResult
+{
+	bool is_ok = false;
+	uint32_t conn_num = 0; // connected and echoed once before the timed run
+	double connect_seconds = 0;
+	double seconds = 0;
+	uint64_t round_trip_num = 0;
+	uint64_t p50_us = 0;
+	uint64_t p99_us = 0;
+	uint64_t p999_us = 0;
+	double server_cpu_seconds = 0; // all threads of the server process during the timed run
+};
+
+static uint64_t NowNs()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double ProcessCpuSeconds()
+{
+	rusage usage;
+	if (0 != getrusage(RUSAGE_SELF, &usage))
+		return 0;
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static uint64_t Percentile(std::vector<uint32_t> &values, double percent)
+{
+	if (values.empty())
+		return 0;
+	size_t idx = (size_t)(values.size() * percent / 100.0);
+	if (idx >= values.size())
+		idx = values.size() - 1;
+	std::nth_element(values.begin(), values.begin() + idx, values.end());
+	return values[idx];
+}
+
+static bool ReadAll(int fd, void *data, size_t len)
+{
+	char *ptr = (char *)data;
+	while (len > 0)
+	{
+		ssize_t ret = read(fd, ptr, len);
+		if (ret <= 0)
+			return false;
+		ptr += ret;
+		len -= ret;
+	}
+	return true;
+}
+
+// runs bench_fn in a child process, so every implementation starts with fresh fds and its own cpu time
+static BenchResult RunIsolated(std::function<void(BenchResult &)> bench_fn)
+{
+	BenchResult result;
+	int fds[2];
+	if (0 != pipe(fds))
+		return result;
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		close(fds[0]);
+		close(fds[1]);
+		return result;
+	}
+	if (0 == pid)
+	{
+		close(fds[0]);
+		bench_fn(result);
+		ssize_t write_len = write(fds[1], &result, sizeof(result));
+		close(fds[1]);
+		_exit(sizeof(result) == write_len ? 0 : 1);
+	}
+	close(fds[1]);
+	if (!ReadAll(fds[0], &result, sizeof(result)))
+		result = BenchResult();
+	close(fds[0]);
+	waitpid(pid, nullptr, 0);
+	return result;
+}
+
+// the listen sockets of the shards share one port, the first one picks it
+static bool OpenListenShards(uint32_t shard_num, std::vector<int> &fds, uint16_t &port)
+{
+	port = 0;
+	for (uint32_t i = 0; i < shard_num; ++i)
+	{
+		int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (fd < 0)
+			return false;
+		fds.push_back(fd);
+		int opt = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+		setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(port);
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if (0 != bind(fd, (sockaddr *)&addr, sizeof(addr)) || 0 != listen(fd, SOMAXCONN))
+			return false;
+		socklen_t addr_len = sizeof(addr);
+		if (0 != getsockname(fd, (sockaddr *)&addr, &addr_len))
+			return false;
+		port = ntohs(addr.sin_port);
+	}
+	return true;
+}
+
+static Net::NetWorkerBase * NewNetWorker(int impl, int worker_idx, int worker_num)
+{
+	switch (impl)
+	{
+	case BENCH_IMPL_LIBEVENT: return new Net::NetWorker(worker_idx, worker_num);
+	case BENCH_IMPL_EPOLL: return new Net::EpollNetWorker(worker_idx, worker_num);
+#ifdef NET_WORKER_URING
+	case BENCH_IMPL_URING: return Net::UringNetWorker::IsSupported() ? new Net::UringNetWorker(worker_idx, worker_num) : nullptr;
+#endif
+	}
+	return nullptr;
+}
+
+class EchoCnnHandler : public INetConnectHander
+{
+public:
+	virtual void OnClose(int err_num) {}
+	virtual void OnOpen(int err_num) {}
+	virtual void OnRecvData(char *data, uint32_t len) {}
+};
+
+class EchoListenHandler : public INetListenHander
+{
+public:
+	EchoListenHandler() : m_cnn_handler(std::make_shared<EchoCnnHandler>()) {}
+	virtual void OnClose(int err_num) {}
+	virtual void OnOpen(int err_num) {}
+	// the echo keeps no state, one handler serves every connection
+	virtual std::shared_ptr<INetConnectHander> GenConnectorHandler(NetId netid) { return m_cnn_handler; }
+
+private:
+	std::shared_ptr<INetConnectHander> m_cnn_handler;
+};
+
+// one message in flight per connection, its echo may come back in pieces
+struct ClientCnn
+{
+	int fd = -1;
+	uint32_t recv_len = 0;
+	uint64_t send_ns = 0;
+	bool is_connected = false;
+};
+
+static bool ClientSend(ClientCnn &cnn, const std::vector<char> &msg)
+{
+	// a message this small always fits the empty socket buffer
+	cnn.recv_len = 0;
+	cnn.send_ns = NowNs();
+	return write(cnn.fd, msg.data(), msg.size()) == (ssize_t)msg.size();
+}
+
+// reads what is there, returns false on eof or error. round_trip_ns is set when the whole echo is back
+static bool ClientRecv(ClientCnn &cnn, uint32_t msg_size, uint64_t &round_trip_ns)
+{
+	char buf[4096];
+	round_trip_ns = 0;
+	while (true)
+	{
+		ssize_t ret = read(cnn.fd, buf, sizeof(buf));
+		if (ret > 0)
+		{
+			cnn.recv_len += (uint32_t)ret;
+			continue;
+		}
+		if (0 == ret)
+			return false;
+		if (EINTR == errno)
+			continue;
+		if (EAGAIN != errno && EWOULDBLOCK != errno)
+			return false;
+		break;
+	}
+	if (cnn.recv_len >= msg_size)
+		round_trip_ns = NowNs() - cnn.send_ns;
+	return true;
+}
+
+// the client process. connects in batches which fit the accept queue of a 64 backlog, every connection echoes once,
+// then all of them ping pong for opt.seconds. writes one byte to ready_fd when the timed run starts
+static void RunClient(const BenchOpt &opt, uint16_t port, int ready_fd, BenchResult &result)
+{
+	const uint32_t CONNECT_BATCH = 64;
+	const int MAX_EVENTS = 1024;
+
+	std::vector<char> msg(opt.msg_size, 'x');
+	std::vector<ClientCnn> cnns(opt.conn_num);
+	int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	std::vector<epoll_event> events(MAX_EVENTS);
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	uint64_t begin_ns = NowNs();
+	uint32_t echoed_num = 0;
+	for (uint32_t batch_begin = 0; batch_begin < opt.conn_num; batch_begin += CONNECT_BATCH)
+	{
+		uint32_t batch_end = std::min(batch_begin + CONNECT_BATCH, opt.conn_num);
+		uint32_t wait_num = 0;
+		for (uint32_t i = batch_begin; i < batch_end; ++i)
+		{
+			int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+			if (fd < 0)
+				break;
+			int no_delay = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+			if (0 != connect(fd, (sockaddr *)&addr, sizeof(addr)) && EINPROGRESS != errno)
+			{
+				close(fd);
+				break;
+			}
+			cnns[i].fd = fd;
+			epoll_event ev;
+			memset(&ev, 0, sizeof(ev));
+			ev.events = EPOLLIN | EPOLLOUT;
+			ev.data.u32 = i;
+			epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+			++wait_num;
+		}
+		uint64_t batch_begin_ns = NowNs();
+		while (wait_num > 0 && NowNs() - batch_begin_ns < 10000000000ull)
+		{
+			int event_num = epoll_wait(epoll_fd, events.data(), MAX_EVENTS, 100);
+			for (int k = 0; k < event_num; ++k)
+			{
+				ClientCnn &cnn = cnns[events[k].data.u32];
+				if (!cnn.is_connected && (events[k].events & EPOLLOUT))
+				{
+					cnn.is_connected = true;
+					epoll_event ev;
+					memset(&ev, 0, sizeof(ev));
+					ev.events = EPOLLIN;
+					ev.data.u32 = events[k].data.u32;
+					epoll_ctl(epoll_fd, EPOLL_CTL_MOD, cnn.fd, &ev);
+					ClientSend(cnn, msg);
+					continue;
+				}
+				uint64_t round_trip_ns = 0;
+				if (!ClientRecv(cnn, opt.msg_size, round_trip_ns) || round_trip_ns > 0)
+					--wait_num;
+				if (round_trip_ns > 0)
+					++echoed_num;
+			}
+		}
+	}
+	result.conn_num = echoed_num;
+	result.connect_seconds = (NowNs() - begin_ns) / 1e9;
+
+	char ready = 1;
+	if (write(ready_fd, &ready, 1) != 1)
+		return;
+	std::vector<uint32_t> round_trip_us;
+	round_trip_us.reserve(1 << 20);
+	begin_ns = NowNs();
+	uint64_t end_ns = begin_ns + (uint64_t)(opt.seconds * 1e9);
+	for (ClientCnn &cnn : cnns)
+	{
+		if (cnn.is_connected && cnn.recv_len >= opt.msg_size)
+			ClientSend(cnn, msg);
+	}
+	while (NowNs() < end_ns)
+	{
+		int event_num = epoll_wait(epoll_fd, events.data(), MAX_EVENTS, 10);
+		for (int k = 0; k < event_num; ++k)
+		{
+			ClientCnn &cnn = cnns[events[k].data.u32];
+			uint64_t round_trip_ns = 0;
+			if (!ClientRecv(cnn, opt.msg_size, round_trip_ns))
+			{
+				epoll_ctl(epoll_fd, EPOLL_CTL_DEL, cnn.fd, nullptr);
+				continue;
+			}
+			if (round_trip_ns > 0)
+			{
+				round_trip_us.push_back((uint32_t)(round_trip_ns / 1000));
+				ClientSend(cnn, msg);
+			}
+		}
+	}
+	result.seconds = (NowNs() - begin_ns) / 1e9;
+	result.round_trip_num = round_trip_us.size();
+	result.p50_us = Percentile(round_trip_us, 50);
+	result.p99_us = Percentile(round_trip_us, 99);
+	result.p999_us = Percentile(round_trip_us, 99.9);
+	result.is_ok = true;
+
+	for (ClientCnn &cnn : cnns)
+	{
+		if (cnn.fd >= 0)
+			close(cnn.fd);
+	}
+	close(epoll_fd);
+}
+
+// the server process: the net workers of impl and a logic loop on this thread which sends every read back
+static void RunServer(const BenchOpt &opt, int impl, BenchResult &result)
+{
+	// the client is forked before any thread starts, the connections wait in the accept queue meanwhile
+	std::vector<int> listen_fds;
+	uint16_t port = 0;
+	int fds[2] = { -1, -1 };
+	pid_t pid = -1;
+	if (OpenListenShards(opt.worker_num, listen_fds, port) && 0 == pipe(fds))
+		pid = fork();
+	if (0 == pid)
+	{
+		close(fds[0]);
+		for (int fd : listen_fds)
+			close(fd);
+		BenchResult client_result;
+		RunClient(opt, port, fds[1], client_result);
+		ssize_t write_len = write(fds[1], &client_result, sizeof(client_result));
+		_exit(sizeof(client_result) == write_len ? 0 : 1);
+	}
+
+	std::vector<Net::NetWorkerBase *> net_workers;
+	for (uint32_t i = 0; pid > 0 && i < opt.worker_num; ++i)
+	{
+		Net::NetWorkerBase *net_worker = NewNetWorker(impl, i, opt.worker_num);
+		if (nullptr == net_worker || !net_worker->Start())
+		{
+			delete net_worker;
+			break;
+		}
+		net_workers.push_back(net_worker);
+	}
+	std::shared_ptr<EchoListenHandler> listen_handler = std::make_shared<EchoListenHandler>();
+	std::vector<NetId> listen_netids;
+	bool is_ready = pid > 0 && net_workers.size() == opt.worker_num;
+	for (uint32_t i = 0; is_ready && i < opt.worker_num; ++i)
+	{
+		NetId netid = net_workers[i]->GenNetId();
+		is_ready = net_workers[i]->AddListenShard(netid, listen_fds[i], listen_handler);
+		listen_netids.push_back(netid);
+	}
+	if (pid > 0 && !is_ready)
+	{
+		kill(pid, SIGKILL);
+		waitpid(pid, nullptr, 0);
+		close(fds[0]);
+		close(fds[1]);
+		pid = -1;
+	}
+
+	if (pid > 0)
+	{
+		close(fds[1]);
+		fds[1] = -1;
+		double begin_cpu_seconds = 0;
+		bool is_timing = false;
+		std::vector<NetSendBuffer> send_bufs;
+		std::vector<NetSendBuffer> send_swap_bufs;
+		while (true)
+		{
+			// the client writes one byte when the timed run starts and its result when it ends
+			pollfd pfd = { fds[0], POLLIN, 0 };
+			if (poll(&pfd, 1, 0) > 0)
+			{
+				if (!is_timing)
+				{
+					char ready = 0;
+					if (read(fds[0], &ready, 1) != 1)
+						break;
+					begin_cpu_seconds = ProcessCpuSeconds();
+					is_timing = true;
+				}
+				else
+				{
+					result.server_cpu_seconds = ProcessCpuSeconds() - begin_cpu_seconds;
+					BenchResult client_result;
+					if (ReadAll(fds[0], &client_result, sizeof(client_result)))
+					{
+						client_result.server_cpu_seconds = result.server_cpu_seconds;
+						result = client_result;
+					}
+					break;
+				}
+			}
+
+			uint32_t data_num = 0;
+			for (uint32_t i = 0; i < net_workers.size(); ++i)
+			{
+				Net::NetWorkerBase *net_worker = net_workers[i];
+				NetWorkData data;
+				uint32_t num = net_worker->NetDataNum();
+				data_num += num;
+				for (uint32_t k = 0; k < num && net_worker->PopNetData(data); ++k)
+				{
+					std::shared_ptr<INetworkHandler> handler = data.handler.lock();
+					if (nullptr == handler || ENetWorkDataAction_Close == data.action)
+						net_worker->RemoveCnn(data.netid);
+					else if (ENetworkHandler_Listen == handler->HandlerType() && ENetWorkDataAction_Accept == data.action)
+						net_worker->BindCnn(data.netid, static_cast<INetListenHander *>(handler.get())->GenConnectorHandler(data.netid));
+					else if (ENetWorkDataAction_Read == data.action && nullptr != data.recv_buffer)
+					{
+						NetSendBuffer send_buf;
+						send_buf.netid = data.netid;
+						send_buf.buffer = data.recv_buffer;
+						send_buf.msg_num = data.msg_num;
+						send_bufs.push_back(send_buf);
+						data.recv_buffer = nullptr;
+					}
+					if (nullptr != data.recv_buffer)
+					{
+						evbuffer_free(data.recv_buffer);
+						data.recv_buffer = nullptr;
+					}
+					data.handler.reset();
+				}
+			}
+			// a full send ring keeps the rest for the next round, as NetworkModule does
+			for (size_t i = 0; i < send_bufs.size(); )
+			{
+				size_t end = i;
+				Net::NetWorkerBase *net_worker = net_workers[send_bufs[i].netid % net_workers.size()];
+				while (end < send_bufs.size() && send_bufs[end].netid % net_workers.size() == send_bufs[i].netid % net_workers.size())
+					++end;
+				uint32_t taken_num = net_worker->SendBuffers(send_bufs.data() + i, (uint32_t)(end - i));
+				send_swap_bufs.insert(send_swap_bufs.end(), send_bufs.begin() + i + taken_num, send_bufs.begin() + end);
+				i = end;
+			}
+			send_bufs.swap(send_swap_bufs);
+			send_swap_bufs.clear();
+			// a logic thread ticks, it does not spin on an idle ring
+			if (0 == data_num)
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+		close(fds[0]);
+		waitpid(pid, nullptr, 0);
+		for (auto &send_buf : send_bufs)
+			evbuffer_free(send_buf.buffer);
+	}
+
+	for (uint32_t i = 0; i < listen_netids.size(); ++i)
+		net_workers[i]->RemoveCnn(listen_netids[i]);
+	for (Net::NetWorkerBase *net_worker : net_workers)
+	{
+		net_worker->Stop();
+		delete net_worker;
+	}
+	// the shards the workers never took over are still ours
+	for (size_t i = listen_netids.size(); i < listen_fds.size(); ++i)
+		close(listen_fds[i]);
+}
+
+int main(int argc, char **argv)
+{
+	BenchOpt opt;
+	if (argc > 1)
+		opt.conn_num = (uint32_t)atoi(argv[1]);
+	if (argc > 2)
+		opt.seconds = atof(argv[2]);
+	if (argc > 3)
+		opt.msg_size = (uint32_t)atoi(argv[3]);
+	if (argc > 4)
+		opt.worker_num = (uint32_t)atoi(argv[4]);
+	if (opt.conn_num <= 0 || opt.seconds <= 0 || opt.msg_size <= 0 || opt.msg_size > 4096 || opt.worker_num <= 0)
+	{
+		printf("usage: %s [conn_num] [seconds] [msg_size <= 4096] [worker_num]\n", argv[0]);
+		return 1;
+	}
+
+	// the server and the client process each hold one fd per connection
+	rlimit fd_limit;
+	if (0 == getrlimit(RLIMIT_NOFILE, &fd_limit) && fd_limit.rlim_cur < fd_limit.rlim_max)
+	{
+		fd_limit.rlim_cur = fd_limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &fd_limit);
+	}
+	if (0 == getrlimit(RLIMIT_NOFILE, &fd_limit) && fd_limit.rlim_cur < opt.conn_num + 64)
+		printf("warn: fd limit %llu is below %u connections\n", (unsigned long long)fd_limit.rlim_cur, opt.conn_num);
+
+	printf("echo on loopback: %u connections, %.1f s, %u byte messages, %u net workers, %u cpus\n",
+		opt.conn_num, opt.seconds, opt.msg_size, opt.worker_num, std::thread::hardware_concurrency());
+	printf("%-10s %8s %10s %12s %10s %8s %8s %9s %12s\n",
+		"impl", "conns", "connect s", "round trip/s", "MB/s", "p50 us", "p99 us", "p999 us", "cpu us/trip");
+	for (int impl = 0; impl < BENCH_IMPL_NUM; ++impl)
+	{
+		BenchResult result = RunIsolated([&opt, impl](BenchResult &result) { RunServer(opt, impl, result); });
+		if (!result.is_ok)
+		{
+			printf("%-10s %8s\n", BENCH_IMPL_NAMES[impl], "n/a");
+			continue;
+		}
+		// both directions, as the echo moves every byte twice
+		double round_trip_per_second = result.round_trip_num / result.seconds;
+		double mb_per_second = round_trip_per_second * opt.msg_size * 2 / 1048576.0;
+		double cpu_us_per_round_trip = result.round_trip_num > 0 ? result.server_cpu_seconds * 1e6 / result.round_trip_num : 0;
+		printf("%-10s %8u %10.2f %12.0f %10.2f %8llu %8llu %9llu %12.2f\n", BENCH_IMPL_NAMES[impl], result.conn_num,
+			result.connect_seconds, round_trip_per_second, mb_per_second, (unsigned long long)result.p50_us,
+			(unsigned long long)result.p99_us, (unsigned long long)result.p999_us, cpu_us_per_round_trip);
+	}
+	return 0;
+}
+
+#else
+
+int main(int argc, char **argv)
+{
+	printf("%s runs on linux only\n", argv[0]);
+	return 0;
+}
+
+#endif
+
+// the entry points the net workers and the libevent memory hooks link against, on plain malloc here
+void * MemoryUtil::Malloc(size_t size) { return malloc(size); }
+void MemoryUtil::Free(void *ptr) { free(ptr); }
+void * MemoryUtil::Realloc(void *ptr, size_t size) { return realloc(ptr, size); }
+void * Malloc(size_t size) { return malloc(size); }
+void Free(void *ptr) { free(ptr); }
+void * Realloc(void *ptr, size_t size) { return realloc(ptr, size); }
+
+NewDelOperaImplement(NetWorkData);
+NewDelOperaImplement(INetworkHandler);
+NewDelOperaImplement(INetConnectHander);
+NewDelOperaImplement(INetListenHander);
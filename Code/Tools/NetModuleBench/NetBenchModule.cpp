@@ -0,0 +1,352 @@
+#include "NetBenchModule.h"
+#include "ModuleDef/ModuleMgr.h"
+#include "CommonModules/Log/LogModule.h"
+#include "CommonModules/Network/INetworkModule.h"
+#include "Network/Handlers/LenCtxNetStreamCnnHandler.h"
+#include "Network/Utils/NetworkAgent.h"
+#include "Common/Macro/ServerLogicMacro.h"
+#include "Common/Utils/MemoryUtil.h"
+#include "Utils/PlatformCompat.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <algorithm>
+#ifdef __linux__
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+static const int NET_BENCH_PROTOCOL_ID = 1;
+static const uint32_t NET_BENCH_TS_LEN = sizeof(uint64_t); // the payload starts with the send time of the client
+
+static uint64_t NowNs()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t Percentile(std::vector<uint32_t> &values, double percent)
+{
+	if (values.empty())
+		return 0;
+	size_t idx = (size_t)(values.size() * percent / 100.0);
+	if (idx >= values.size())
+		idx = values.size() - 1;
+	std::nth_element(values.begin(), values.begin() + idx, values.end());
+	return values[idx];
+}
+
+// both ends frame on the net workers, as the players of the game server do
+class NetBenchServerHandler : public LenCtxNetStreamCnnHandler
+{
+	NewDelOperaDeclaration;
+public:
+	NetBenchServerHandler(NetId netid, NetBenchModule *module) : LenCtxNetStreamCnnHandler(Net::PROTOCOL_MAX_SIZE, true), m_module(module)
+	{
+		this->SetNetId(netid);
+	}
+	virtual ~NetBenchServerHandler() { m_module = nullptr; }
+	virtual void OnClose(int err_num) { m_module->OnCnnClose(err_num); }
+	virtual void OnOpen(int err_num) { m_module->OnServerOpen(err_num, this); }
+
+protected:
+	virtual void OnParseSuccess(char *data, uint32_t len) { m_module->OnServerRecv(data, len, this); }
+	virtual void OnParseFail() { m_module->OnCnnClose(-1); }
+	NetBenchModule *m_module;
+};
+
+class NetBenchClientHandler : public LenCtxNetStreamCnnHandler
+{
+	NewDelOperaDeclaration;
+public:
+	NetBenchClientHandler(NetBenchModule *module) : LenCtxNetStreamCnnHandler(Net::PROTOCOL_MAX_SIZE, true), m_module(module) {}
+	virtual ~NetBenchClientHandler() { m_module = nullptr; }
+	virtual void OnClose(int err_num) { m_module->OnCnnClose(err_num); }
+	virtual void OnOpen(int err_num) {}
+	bool is_warm = false;
+
+protected:
+	virtual void OnParseSuccess(char *data, uint32_t len) { m_module->OnClientRecv(data, len, this); }
+	virtual void OnParseFail() { m_module->OnCnnClose(-1); }
+	NetBenchModule *m_module;
+};
+
+class NetBenchListenHandler : public INetListenHander
+{
+public:
+	NetBenchListenHandler(NetBenchModule *module) : m_module(module) {}
+	virtual ~NetBenchListenHandler() { m_module = nullptr; }
+	virtual void OnClose(int err_num) {}
+	virtual void OnOpen(int err_num) {}
+	virtual std::shared_ptr<INetConnectHander> GenConnectorHandler(NetId netid) { return m_module->NewServerHandler(netid); }
+
+protected:
+	NetBenchModule *m_module;
+};
+
+NetBenchModule::NetBenchModule(ModuleMgr *module_mgr) : IGameLogicModule(module_mgr)
+{
+}
+
+NetBenchModule::~NetBenchModule()
+{
+	m_run = nullptr;
+}
+
+EModuleRetCode NetBenchModule::Init(void *param)
+{
+	m_run = (NetBenchRun *)param;
+	if (nullptr == m_run)
+		return EModuleRetCode_Failed;
+	const NetBenchOpt &opt = m_run->opt;
+	if (opt.msg_size < NET_BENCH_TS_LEN || opt.msg_size + sizeof(int) > Net::PROTOCOL_CONTENT_MAX_SIZE)
+		return EModuleRetCode_Failed;
+	m_send_buf.resize(opt.msg_size, 'x');
+	return EModuleRetCode_Succ;
+}
+
+EModuleRetCode NetBenchModule::Awake()
+{
+	m_listen_handler = std::make_shared<NetBenchListenHandler>(this);
+	NetListenOpt listen_opt;
+	listen_opt.is_shard_on_workers = true;
+	NetId netid = GlobalServerLogic->GetNetworkModule()->Listen("127.0.0.1", m_run->opt.port, &listen_opt, m_listen_handler);
+	if (netid <= 0)
+		return EModuleRetCode_Failed;
+	m_client_handlers.reserve(m_run->opt.conn_num);
+	m_server_handlers.reserve(m_run->opt.conn_num);
+	m_phase = EBenchPhase_Connect;
+	m_phase_start_ns = NowNs();
+	return EModuleRetCode_Succ;
+}
+
+EModuleRetCode NetBenchModule::Update()
+{
+	const NetBenchOpt &opt = m_run->opt;
+	uint64_t now_ns = NowNs();
+	switch (m_phase)
+	{
+	case EBenchPhase_Connect:
+	{
+		this->ConnectClients();
+		if (m_client_handlers.size() >= opt.conn_num && m_server_open_num >= opt.conn_num)
+		{
+			m_run->result.connect_seconds = (now_ns - m_phase_start_ns) / 1e9;
+			uint32_t window = ENetBenchWorkload_Bulk == opt.workload ? NET_BENCH_BULK_WINDOW : 1;
+			for (auto &handler : m_client_handlers)
+			{
+				for (uint32_t i = 0; i < window; ++i)
+					this->SendFromClient(handler.get());
+			}
+			m_phase = EBenchPhase_Warmup;
+			m_phase_start_ns = now_ns;
+		}
+		else if (now_ns - m_phase_start_ns > CONNECT_TIMEOUT_SEC * 1000000000ull)
+		{
+			this->Finish(false);
+		}
+	}
+	break;
+	case EBenchPhase_Warmup:
+	{
+		if (m_warm_client_num >= opt.conn_num)
+		{
+			m_msg_num = 0;
+			m_byte_num = 0;
+			m_rtt_us.clear();
+			ReadThreadTicks(m_start_ticks);
+			m_phase = EBenchPhase_Measure;
+			m_run_start_ns = NowNs();
+		}
+		else if (now_ns - m_phase_start_ns > CONNECT_TIMEOUT_SEC * 1000000000ull)
+		{
+			this->Finish(false);
+		}
+	}
+	break;
+	case EBenchPhase_Measure:
+	{
+		if (now_ns - m_run_start_ns >= (uint64_t)(opt.seconds * 1e9))
+			this->Finish(true);
+	}
+	break;
+	default:
+		break;
+	}
+	return EModuleRetCode_Succ;
+}
+
+EModuleRetCode NetBenchModule::Release()
+{
+	return EModuleRetCode_Succ;
+}
+
+EModuleRetCode NetBenchModule::Destroy()
+{
+	// the net workers are stopped by now, NetworkModule comes first
+	m_client_handlers.clear();
+	m_server_handlers.clear();
+	m_listen_handler = nullptr;
+	return EModuleRetCode_Succ;
+}
+
+void NetBenchModule::ConnectClients()
+{
+	INetworkModule *network = GlobalServerLogic->GetNetworkModule();
+	for (uint32_t i = 0; i < CONNECT_BATCH && m_client_handlers.size() < m_run->opt.conn_num; ++i)
+	{
+		std::shared_ptr<NetBenchClientHandler> handler = std::make_shared<NetBenchClientHandler>(this);
+		NetId netid = network->Connect("127.0.0.1", m_run->opt.port, nullptr, handler);
+		if (netid <= 0)
+		{
+			this->Finish(false);
+			return;
+		}
+		handler->SetNetId(netid);
+		m_client_handlers.push_back(handler);
+	}
+}
+
+void NetBenchModule::SendFromClient(NetBenchClientHandler *handler)
+{
+	uint64_t now_ns = NowNs();
+	memcpy(m_send_buf.data(), &now_ns, NET_BENCH_TS_LEN);
+	GlobalServerLogic->GetNetAgent()->Send(handler->GetNetId(), NET_BENCH_PROTOCOL_ID, m_send_buf.data(), (uint32_t)m_send_buf.size());
+}
+
+void NetBenchModule::Finish(bool is_ok)
+{
+	if (EBenchPhase_Done == m_phase)
+		return;
+	NetBenchResult &result = m_run->result;
+	result.is_ok = is_ok && 0 == result.close_num;
+	result.conn_num = (uint32_t)m_client_handlers.size();
+	if (EBenchPhase_Measure == m_phase)
+	{
+		result.seconds = (NowNs() - m_run_start_ns) / 1e9;
+		result.msg_num = m_msg_num;
+		result.byte_num = m_byte_num;
+		result.p50_us = Percentile(m_rtt_us, 50);
+		result.p99_us = Percentile(m_rtt_us, 99);
+		result.p999_us = Percentile(m_rtt_us, 99.9);
+
+		std::vector<ThreadTicks> end_ticks;
+		ReadThreadTicks(end_ticks);
+#ifdef __linux__
+		double tick_per_sec = (double)sysconf(_SC_CLK_TCK);
+#else
+		double tick_per_sec = 100;
+#endif
+		for (const ThreadTicks &end : end_ticks)
+		{
+			if (result.thread_num >= NET_BENCH_MAX_THREAD)
+				break;
+			uint64_t start_ticks = 0;
+			for (const ThreadTicks &start : m_start_ticks)
+			{
+				if (start.tid == end.tid)
+					start_ticks = start.ticks;
+			}
+			NetBenchThreadCpu &thread_cpu = result.threads[result.thread_num++];
+			strncpy(thread_cpu.name, end.name.c_str(), sizeof(thread_cpu.name) - 1);
+			thread_cpu.cpu_percent = (end.ticks - start_ticks) / tick_per_sec / result.seconds * 100;
+		}
+	}
+	m_phase = EBenchPhase_Done;
+	m_module_mgr->Quit();
+}
+
+std::shared_ptr<NetBenchServerHandler> NetBenchModule::NewServerHandler(NetId netid)
+{
+	std::shared_ptr<NetBenchServerHandler> handler = std::make_shared<NetBenchServerHandler>(netid, this);
+	m_server_handlers[netid] = handler;
+	return handler;
+}
+
+void NetBenchModule::OnServerOpen(int err_num, NetBenchServerHandler *handler)
+{
+	if (0 == err_num)
+		++m_server_open_num;
+	else
+		m_server_handlers.erase(handler->GetNetId());
+}
+
+void NetBenchModule::OnServerRecv(char *data, uint32_t len, NetBenchServerHandler *handler)
+{
+	// data is the protocol id and the msg, as NetworkAgent::Send wrote them
+	if (len < sizeof(int) + NET_BENCH_TS_LEN)
+		return;
+	if (EBenchPhase_Measure == m_phase)
+	{
+		++m_msg_num;
+		m_byte_num += Net::PROTOCOL_LEN_DESCRIPT_SIZE + len;
+	}
+	int protocol_id = ntohl(*(int *)data);
+	GlobalServerLogic->GetNetAgent()->Send(handler->GetNetId(), protocol_id, data + sizeof(int), len - sizeof(int));
+}
+
+void NetBenchModule::OnClientRecv(char *data, uint32_t len, NetBenchClientHandler *handler)
+{
+	if (len < sizeof(int) + NET_BENCH_TS_LEN || EBenchPhase_Done == m_phase)
+		return;
+	uint64_t send_ns = 0;
+	memcpy(&send_ns, data + sizeof(int), NET_BENCH_TS_LEN);
+	if (EBenchPhase_Measure == m_phase)
+		m_rtt_us.push_back((uint32_t)((NowNs() - send_ns) / 1000));
+	if (!handler->is_warm)
+	{
+		handler->is_warm = true;
+		++m_warm_client_num;
+	}
+	this->SendFromClient(handler);
+}
+
+void NetBenchModule::OnCnnClose(int err_num)
+{
+	if (EBenchPhase_Done == m_phase)
+		return;
+	++m_run->result.close_num;
+	this->Finish(false);
+}
+
+void NetBenchModule::ReadThreadTicks(std::vector<ThreadTicks> &out)
+{
+	out.clear();
+#ifdef __linux__
+	DIR *dir = opendir("/proc/self/task");
+	if (nullptr == dir)
+		return;
+	while (dirent *entry = readdir(dir))
+	{
+		if ('.' == entry->d_name[0])
+			continue;
+		std::string path = std::string("/proc/self/task/") + entry->d_name + "/stat";
+		FILE *file = fopen(path.c_str(), "r");
+		if (nullptr == file)
+			continue;
+		char line[1024] = { 0 };
+		size_t line_len = fread(line, 1, sizeof(line) - 1, file);
+		fclose(file);
+		line[line_len] = 0;
+		// pid (comm) state ..., the comm may hold spaces so the fields are counted from the last ')'
+		char *comm_begin = strchr(line, '(');
+		char *comm_end = strrchr(line, ')');
+		if (nullptr == comm_begin || nullptr == comm_end || comm_end < comm_begin)
+			continue;
+		ThreadTicks thread_ticks;
+		thread_ticks.tid = atoi(entry->d_name);
+		thread_ticks.name.assign(comm_begin + 1, comm_end);
+		unsigned long long utime = 0, stime = 0;
+		// state is field 3, utime and stime are fields 14 and 15
+		if (2 != sscanf(comm_end + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime))
+			continue;
+		thread_ticks.ticks = utime + stime;
+		out.push_back(thread_ticks);
+	}
+	closedir(dir);
+#endif
+}
+
+NewDelOperaImplement(NetBenchModule);
+NewDelOperaImplement(NetBenchServerHandler);
+NewDelOperaImplement(NetBenchClientHandler);
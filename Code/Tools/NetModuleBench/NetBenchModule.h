@@ -0,0 +1,128 @@
+#pragma once
+
+#include "LogicModules/GameLogic/IGameLogicModule.h"
+#include "Common/Define/NetworkDefine.h"
+#include "Common/Macro/MemoryPoolMacro.h"
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+class INetListenHander;
+class NetBenchClientHandler;
+class NetBenchServerHandler;
+
+enum ENetBenchWorkload
+{
+	ENetBenchWorkload_PingPong = 0, // one message in flight per connection, the next leaves when the echo is back
+	ENetBenchWorkload_Bulk, // NET_BENCH_BULK_WINDOW big messages in flight per connection, refilled as the echoes come back
+	ENetBenchWorkload_Max,
+};
+
+static const uint32_t NET_BENCH_BULK_WINDOW = 16;
+static const int NET_BENCH_MAX_THREAD = 32;
+
+// plain data, so a forked run can write it back through a pipe
+struct NetBenchOpt
+{
+	char impl[16] = "libevent";
+	int worker_num = 2;
+	ENetBenchWorkload workload = ENetBenchWorkload_PingPong;
+	uint32_t conn_num = 100;
+	uint32_t msg_size = 64;
+	double seconds = 5;
+	int loop_span_ms = 1;
+	uint16_t port = 27100;
+};
+
+struct NetBenchThreadCpu
+{
+	char name[16] = { 0 };
+	double cpu_percent = 0; // of one cpu, over the timed run
+};
+
+struct NetBenchResult
+{
+	bool is_ok = false;
+	uint32_t conn_num = 0;
+	double connect_seconds = 0;
+	double seconds = 0;
+	uint64_t msg_num = 0; // received by the server, the echoes carry as many back
+	uint64_t byte_num = 0; // of those messages on the wire, heads included
+	uint64_t p50_us = 0;
+	uint64_t p99_us = 0;
+	uint64_t p999_us = 0;
+	uint32_t close_num = 0; // connections lost before the end
+	int thread_num = 0;
+	NetBenchThreadCpu threads[NET_BENCH_MAX_THREAD];
+};
+
+// param of Init, the module reads opt and fills result
+struct NetBenchRun
+{
+	NetBenchOpt opt;
+	NetBenchResult result;
+};
+
+// takes the game logic slot of the bench server. Awake listens on loopback, Update connects the clients through the same
+// NetworkModule, then drives the workload and times it. the run ends by quitting the server logic
+class NetBenchModule : public IGameLogicModule
+{
+	NewDelOperaDeclaration;
+public:
+	NetBenchModule(ModuleMgr *module_mgr);
+	virtual ~NetBenchModule();
+	virtual EModuleRetCode Init(void *param);
+	virtual EModuleRetCode Awake();
+	virtual EModuleRetCode Update();
+	virtual EModuleRetCode Release();
+	virtual EModuleRetCode Destroy();
+
+	// called by the handlers on the logic thread
+	void OnServerOpen(int err_num, NetBenchServerHandler *handler);
+	void OnServerRecv(char *data, uint32_t len, NetBenchServerHandler *handler);
+	void OnClientRecv(char *data, uint32_t len, NetBenchClientHandler *handler);
+	void OnCnnClose(int err_num);
+	std::shared_ptr<NetBenchServerHandler> NewServerHandler(NetId netid);
+
+protected:
+	enum EBenchPhase
+	{
+		EBenchPhase_Connect,
+		EBenchPhase_Warmup, // every connection echoes once before the clock starts
+		EBenchPhase_Measure,
+		EBenchPhase_Done,
+	};
+	EBenchPhase m_phase = EBenchPhase_Connect;
+	NetBenchRun *m_run = nullptr;
+	uint64_t m_phase_start_ns = 0;
+	uint64_t m_run_start_ns = 0;
+
+	std::shared_ptr<INetListenHander> m_listen_handler;
+	std::unordered_map<NetId, std::shared_ptr<NetBenchServerHandler>> m_server_handlers;
+	std::vector<std::shared_ptr<NetBenchClientHandler>> m_client_handlers;
+	uint32_t m_server_open_num = 0;
+	uint32_t m_warm_client_num = 0;
+	static const uint32_t CONNECT_BATCH = 32; // per tick, so the accepts are handled while connecting
+	static const int CONNECT_TIMEOUT_SEC = 120;
+	void ConnectClients();
+	void SendFromClient(NetBenchClientHandler *handler);
+	void Finish(bool is_ok);
+
+	// counted in the timed run only
+	uint64_t m_msg_num = 0;
+	uint64_t m_byte_num = 0;
+	std::vector<uint32_t> m_rtt_us;
+	std::vector<char> m_send_buf;
+
+	// utime + stime by thread, read from /proc at both ends of the timed run
+	struct ThreadTicks
+	{
+		int tid = 0;
+		std::string name;
+		uint64_t ticks = 0;
+	};
+	std::vector<ThreadTicks> m_start_ticks;
+	static void ReadThreadTicks(std::vector<ThreadTicks> &out);
+};
@@ -0,0 +1,50 @@
+#include "NetBenchServerLogic.h"
+#include "NetBenchModule.h"
+#include "CommonModules/Log/LogModule.h"
+#include "CommonModules/Timer/TimerModule.h"
+#include "CommonModules/Network/Impl/NetworkModule.h"
+#include "Common/Define/ServerLogicDefine.h"
+#include "ServerLogics/ThreadConfig.h"
+
+NetBenchServerLogic::NetBenchServerLogic() : ServerLogic()
+{
+	m_memory_stat_log_span_ms = 0;
+}
+
+NetBenchServerLogic::~NetBenchServerLogic()
+{
+
+}
+
+void NetBenchServerLogic::SetInitParams(void *params)
+{
+	NetBenchServerParam *bench_param = (NetBenchServerParam *)params;
+	const NetBenchOpt &opt = bench_param->run->opt;
+	m_loop_span_ms = opt.loop_span_ms;
+	m_init_params[EMoudleName_Log] = new std::string(bench_param->log_cfg_file);
+	m_init_params[EMoudleName_GameLogic] = bench_param->run;
+
+	// the rows of Server/ThreadConfig.csv, filled from the command line. ServerLogic::Destroy frees the set
+	m_thread_cfg_set = new ThreadConfigSet();
+	m_thread_cfg_set->Add(EThreadCfgId_NetWorker, "net_worker", opt.worker_num, opt.impl);
+	m_thread_cfg_set->Add(EThreadCfgId_CnnTask, "cnn_task", 1, "");
+	m_init_params[EMoudleName_Network] = m_thread_cfg_set;
+}
+
+void NetBenchServerLogic::ClearInitParams()
+{
+	if (nullptr != m_init_params[EMoudleName_Log])
+	{
+		delete (std::string *)m_init_params[EMoudleName_Log];
+		m_init_params[EMoudleName_Log] = nullptr;
+	}
+	m_init_params[EMoudleName_GameLogic] = nullptr;
+}
+
+void NetBenchServerLogic::SetupModules()
+{
+	m_module_mgr->SetModule(new LogModule(m_module_mgr));
+	m_module_mgr->SetModule(new NetBenchModule(m_module_mgr));
+	m_module_mgr->SetModule(new TimerModule(m_module_mgr));
+	m_module_mgr->SetModule(new NetworkModule(m_module_mgr));
+}
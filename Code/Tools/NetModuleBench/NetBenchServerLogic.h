@@ -0,0 +1,25 @@
+#pragma once
+
+#include "ServerLogics/ServerLogic.h"
+
+struct NetBenchRun;
+
+// param of SetInitParams
+struct NetBenchServerParam
+{
+	std::string log_cfg_file;
+	NetBenchRun *run = nullptr;
+};
+
+// the modules of the game server with NetBenchModule in the game logic slot, one instance per run
+class NetBenchServerLogic : public ServerLogic
+{
+public:
+	NetBenchServerLogic();
+	virtual ~NetBenchServerLogic();
+	virtual void SetInitParams(void *params);
+
+protected:
+	virtual void SetupModules();
+	virtual void ClearInitParams();
+};
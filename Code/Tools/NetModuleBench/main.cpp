@@ -0,0 +1,211 @@
+#include "NetBenchServerLogic.h"
+#include "NetBenchModule.h"
+#include "Common/Utils/MemoryUtil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <thread>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <functional>
+#ifndef WIN32
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#endif
+
+// the whole network stack of the server on loopback: NetworkModule, its net workers, LenCtxNetStreamCnnHandler framing and
+// NetworkAgent::Send heads, ticked by a ServerLogic. the listener and the clients live in the same server, on the same logic thread.
+// every impl, workload and connection count runs in a process of its own.
+// usage: NetModuleBench log_cfg_file [impl|all] [worker_num] [seconds] [conn_nums] [loop_span_ms]
+//        defaults all 2 5 100,1000,10000 1
+
+extern ServerLogic *server_logic;
+
+static const char *IMPL_NAMES[] = { "libevent", "epoll", "io_uring" };
+static const char *WORKLOAD_NAMES[ENetBenchWorkload_Max] = { "pingpong", "bulk" };
+static const uint32_t WORKLOAD_MSG_SIZES[ENetBenchWorkload_Max] = { 64, 4000 };
+
+static void RunServer(const std::string &log_cfg_file, NetBenchRun &run)
+{
+	NetBenchServerParam param;
+	param.log_cfg_file = log_cfg_file;
+	param.run = &run;
+	server_logic = new NetBenchServerLogic();
+	server_logic->SetInitParams(&param);
+	server_logic->Loop();
+	delete server_logic;
+	server_logic = nullptr;
+}
+
+#ifndef WIN32
+
+static bool ReadAll(int fd, void *data, size_t len)
+{
+	char *ptr = (char *)data;
+	while (len > 0)
+	{
+		ssize_t ret = read(fd, ptr, len);
+		if (ret <= 0)
+			return false;
+		ptr += ret;
+		len -= ret;
+	}
+	return true;
+}
+
+// every run starts with fresh fds, loggers and memory pools, and the cpu of its threads is its own
+static bool RunIsolated(std::function<void()> run_fn, NetBenchRun &run)
+{
+	// what is buffered would be written again by the child
+	fflush(stdout);
+	int fds[2];
+	if (0 != pipe(fds))
+		return false;
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+	if (0 == pid)
+	{
+		close(fds[0]);
+		run_fn();
+		ssize_t write_len = write(fds[1], &run, sizeof(run));
+		close(fds[1]);
+		_exit(sizeof(run) == write_len ? 0 : 1);
+	}
+	close(fds[1]);
+	bool ret = ReadAll(fds[0], &run, sizeof(run));
+	close(fds[0]);
+	waitpid(pid, nullptr, 0);
+	return ret;
+}
+
+#else
+
+static bool RunIsolated(std::function<void()> run_fn, NetBenchRun &run)
+{
+	run_fn();
+	return true;
+}
+
+#endif
+
+static void PrintResult(const NetBenchRun &run)
+{
+	const NetBenchResult &result = run.result;
+	if (!result.is_ok || result.seconds <= 0)
+	{
+		printf("%-9s %-9s %6u %8s  closed %u\n", run.opt.impl, WORKLOAD_NAMES[run.opt.workload], run.opt.conn_num, "n/a", result.close_num);
+		return;
+	}
+	printf("%-9s %-9s %6u %9.2f %11.0f %9.2f %8llu %8llu %9llu\n", run.opt.impl, WORKLOAD_NAMES[run.opt.workload], result.conn_num,
+		result.connect_seconds, result.msg_num / result.seconds, result.byte_num / result.seconds / 1048576.0,
+		(unsigned long long)result.p50_us, (unsigned long long)result.p99_us, (unsigned long long)result.p999_us);
+	std::string thread_cpus;
+	for (int i = 0; i < result.thread_num; ++i)
+	{
+		// the threads started by the logic thread inherit its name, the idle ones are left out
+		if (result.threads[i].cpu_percent < 0.05)
+			continue;
+		char buf[64];
+		snprintf(buf, sizeof(buf), " %s %.1f%%", result.threads[i].name, result.threads[i].cpu_percent);
+		thread_cpus += buf;
+	}
+	printf("    cpu:%s\n", thread_cpus.c_str());
+}
+
+int main(int argc, char **argv)
+{
+	if (argc <= 1)
+	{
+		printf("usage: %s log_cfg_file [impl|all] [worker_num] [seconds] [conn_nums] [loop_span_ms]\n", argv[0]);
+		return 1;
+	}
+	std::string log_cfg_file = argv[1];
+	std::vector<std::string> impls;
+	std::string impl_arg = argc > 2 ? argv[2] : "all";
+	if ("all" == impl_arg)
+		impls.assign(IMPL_NAMES, IMPL_NAMES + sizeof(IMPL_NAMES) / sizeof(IMPL_NAMES[0]));
+	else
+		impls.push_back(impl_arg);
+	NetBenchOpt base_opt;
+	if (argc > 3)
+		base_opt.worker_num = atoi(argv[3]);
+	if (argc > 4)
+		base_opt.seconds = atof(argv[4]);
+	std::vector<uint32_t> conn_nums;
+	std::stringstream conn_ss(argc > 5 ? argv[5] : "100,1000,10000");
+	std::string conn_str;
+	while (std::getline(conn_ss, conn_str, ','))
+	{
+		if (atoi(conn_str.c_str()) > 0)
+			conn_nums.push_back((uint32_t)atoi(conn_str.c_str()));
+	}
+	if (argc > 6)
+		base_opt.loop_span_ms = atoi(argv[6]);
+	if (base_opt.worker_num <= 0 || base_opt.seconds <= 0 || conn_nums.empty() || base_opt.loop_span_ms < 0)
+	{
+		printf("usage: %s log_cfg_file [impl|all] [worker_num] [seconds] [conn_nums] [loop_span_ms]\n", argv[0]);
+		return 1;
+	}
+
+	MemoryUtil::Init();
+	uint64_t fd_limit_num = 0;
+#ifdef WIN32
+	WSADATA wsa_data;
+	WSAStartup(0x0201, &wsa_data);
+	fd_limit_num = UINT32_MAX;
+#else
+	signal(SIGPIPE, SIG_IGN);
+	// both ends of every connection are in the same process
+	rlimit fd_limit;
+	if (0 == getrlimit(RLIMIT_NOFILE, &fd_limit) && fd_limit.rlim_cur < fd_limit.rlim_max)
+	{
+		fd_limit.rlim_cur = fd_limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &fd_limit);
+	}
+	if (0 == getrlimit(RLIMIT_NOFILE, &fd_limit))
+		fd_limit_num = fd_limit.rlim_cur;
+#endif
+
+	printf("NetworkModule on loopback: %d net workers, %.1f s, loop span %d ms, %u cpus, pingpong %u bytes, bulk %u bytes x %u in flight\n",
+		base_opt.worker_num, base_opt.seconds, base_opt.loop_span_ms, std::thread::hardware_concurrency(),
+		WORKLOAD_MSG_SIZES[ENetBenchWorkload_PingPong], WORKLOAD_MSG_SIZES[ENetBenchWorkload_Bulk], NET_BENCH_BULK_WINDOW);
+	printf("%-9s %-9s %6s %9s %11s %9s %8s %8s %9s\n", "impl", "workload", "conns", "connect s", "msg/s", "MB/s", "p50 us", "p99 us", "p999 us");
+	uint16_t port = base_opt.port;
+	for (const std::string &impl : impls)
+	{
+		for (int workload = 0; workload < ENetBenchWorkload_Max; ++workload)
+		{
+			for (uint32_t conn_num : conn_nums)
+			{
+				NetBenchRun run;
+				run.opt = base_opt;
+				strncpy(run.opt.impl, impl.c_str(), sizeof(run.opt.impl) - 1);
+				run.opt.workload = (ENetBenchWorkload)workload;
+				run.opt.conn_num = conn_num;
+				run.opt.msg_size = WORKLOAD_MSG_SIZES[workload];
+				// a port of its own, the last run may leave sockets in TIME_WAIT
+				run.opt.port = port++;
+				if ((uint64_t)conn_num * 2 + 64 > fd_limit_num)
+				{
+					printf("%-9s %-9s %6u skipped, needs %u fds, the limit is %llu\n", run.opt.impl, WORKLOAD_NAMES[workload], conn_num,
+						conn_num * 2 + 64, (unsigned long long)fd_limit_num);
+					continue;
+				}
+				if (!RunIsolated([&log_cfg_file, &run]() { RunServer(log_cfg_file, run); }, run))
+					run.result = NetBenchResult();
+				PrintResult(run);
+				fflush(stdout);
+			}
+		}
+	}
+	MemoryUtil::Destroy();
+	return 0;
+}